@@ -0,0 +1,24 @@
+#***************************  M a k e f i l e  *******************************
+#
+#    Description: Makefile descriptor file for SMB2_API alert benchmark
+#                 (simulated SMBus, no hardware required)
+#
+#-----------------------------------------------------------------------------
+#   (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+#*****************************************************************************
+
+MAK_NAME=smb2_alert_bench
+
+MAK_LIBS=$(LIB_PREFIX)$(MEN_LIB_DIR)/smb2_api$(LIB_SUFFIX)	\
+         $(LIB_PREFIX)$(MEN_LIB_DIR)/mdis_api$(LIB_SUFFIX)	\
+         $(LIB_PREFIX)$(MEN_LIB_DIR)/usr_oss$(LIB_SUFFIX)
+
+MAK_INCL=$(MEN_INC_DIR)/men_typs.h	\
+         $(MEN_INC_DIR)/mdis_err.h	\
+         $(MEN_INC_DIR)/usr_oss.h	\
+         $(MEN_INC_DIR)/smb2_api.h	\
+         $(MEN_MOD_DIR)/../../../smb2_api_ext.h
+
+MAK_INP1=smb2_alert_bench$(INP_SUFFIX)
+
+MAK_INP=$(MAK_INP1)
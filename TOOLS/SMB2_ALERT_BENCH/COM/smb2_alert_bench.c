@@ -0,0 +1,326 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  smb2_alert_bench.c
+ *
+ *  	 \brief  Alert signal-to-callback latency benchmark of the SMB2_API
+ *
+ *               Installs alert callbacks for devices of a simulated SMBus
+ *               (SMB2API_InitSim), raises alerts round robin with
+ *               SMB2API_SimAlert() (real signals) and measures the time
+ *               from raising an alert to its callback. Dispatch modes:
+ *               - sig:    one signal per alert, callbacks invoked from
+ *                         the signal
+ *               - engine: one signal per alert, alert engine
+ *               - drain:  all alerts on one signal, alert engine with
+ *                         SMB2API_ALERT_ARA_DRAIN
+ *               - poll:   alert engine with SMB2API_ALERT_POLL
+ *
+ *               With one signal per alert, only as many alerts as free
+ *               signals are installed. An alert raised again before the
+ *               callback of the previous one is counted as coalesced, an
+ *               alert without callback within 1s after the last raise as
+ *               dropped.
+ *
+ *               Usage: smb2_alert_bench [-m=<mode>] [-a=<alerts>]
+ *                                       [-r=<rate>] [-n=<count>]
+ *               -m=<mode>    sig, engine, drain or poll (default: all)
+ *               -a=<alerts>  number of alerts (default 64)
+ *               -r=<rate>    alerts per second, 0=max. (default 10000)
+ *               -n=<count>   alerts to raise (default 20000)
+ *
+ *     Required: libraries: smb2_api, mdis_api, usr_oss, pthread
+ *     Switches: -
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_err.h>
+#include <MEN/usr_oss.h>
+#include <MEN/smb2_api.h>
+#include "../../../smb2_api_ext.h"
+
+/*-----------------------------------------+
+|  DEFINES                                 |
++-----------------------------------------*/
+#define MODE_SIG		0		/* dispatch modes */
+#define MODE_ENGINE		1
+#define MODE_DRAIN		2
+#define MODE_POLL		3
+#define MODE_NUM		4
+
+#define ALERT_MAX		112		/* max. alerts */
+#define ALERT_DEV		0x20	/* device of alert n: ALERT_DEV + 2n */
+#define HIST_NUM		24		/* latency buckets, n: < 2^n us */
+#define SETTLE_MS		1000	/* max. wait for outstanding callbacks */
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/** result of a benchmark run (callback fields written by the callbacks
+ *  only) */
+typedef struct
+{
+	u_int32		installed;			/**< installed alerts */
+	u_int32		triggered;			/**< raised alerts */
+	volatile u_int32 delivered;		/**< invoked alert callbacks */
+	u_int32		coalesced;			/**< raised again before the callback */
+	u_int32		dropped;			/**< alerts without callback */
+	u_int32		ratePerSec;			/**< achieved trigger rate [1/s] */
+	u_int64		sumUs;				/**< sum of latencies [us] */
+	u_int32		maxUs;				/**< max. latency [us] */
+	u_int32		hist[HIST_NUM];		/**< latency histogram */
+}RESULT;
+
+/** alert of the benchmark */
+typedef struct
+{
+	RESULT		*res;				/**< result */
+	u_int16		addr;				/**< device address */
+	volatile u_int32 pending;		/**< raised, callback outstanding */
+	u_int32		tTrig;				/**< time of raising [us] */
+}ALERT;
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static int32 Bench( u_int32 mode, u_int32 alerts, u_int32 ratePerSec,
+					u_int32 count, RESULT *res );
+static void BenchCb( void *cbArg );
+static u_int32 UsecGet( void );
+static u_int32 HistPercentile( const u_int32 *hist, u_int32 permille );
+
+/*-----------------------------------------+
+|  GLOBALS                                 |
++-----------------------------------------*/
+static const char *G_modeName[MODE_NUM] = { "sig", "engine", "drain", "poll" };
+
+/********************************* main ************************************/
+/** Program main function
+ *
+ *  \param argc       \IN  argument counter
+ *  \param argv       \IN  argument vector
+ *
+ *  \return	          success (0) or error (1)
+ */
+int main( int argc, char *argv[] )
+{
+	RESULT	res;
+	u_int32	alerts = 64, ratePerSec = 10000, count = 20000;
+	u_int32	first = 0, last = MODE_NUM - 1, mode;
+	int32	a, rv, fails = 0;
+
+	for( a=1; a<argc; a++ ){
+		if( !strncmp( argv[a], "-m=", 3 ) ){
+			for( mode=0; mode<MODE_NUM; mode++ ){
+				if( !strcmp( argv[a] + 3, G_modeName[mode] ) )
+					break;
+			}
+			first = last = mode;
+		}
+		else if( !strncmp( argv[a], "-a=", 3 ) )
+			alerts = (u_int32)strtoul( argv[a] + 3, NULL, 0 );
+		else if( !strncmp( argv[a], "-r=", 3 ) )
+			ratePerSec = (u_int32)strtoul( argv[a] + 3, NULL, 0 );
+		else if( !strncmp( argv[a], "-n=", 3 ) )
+			count = (u_int32)strtoul( argv[a] + 3, NULL, 0 );
+		else
+			first = MODE_NUM;
+
+		if( (first == MODE_NUM) || !alerts || (alerts > ALERT_MAX) ){
+			printf( "usage: smb2_alert_bench [-m=sig|engine|drain|poll] "
+					"[-a=<1..%d>] [-r=<rate>] [-n=<count>]\n", ALERT_MAX );
+			return 1;
+		}
+	}
+
+	printf( "alerts=%u rate=%u/s count=%u\n\n", alerts, ratePerSec, count );
+	printf( "mode    alerts   rate/s  avg[us]  p99[us]  max[us]  "
+			"coalesced  dropped\n" );
+
+	for( mode=first; mode<=last; mode++ ){
+		if( (rv = Bench( mode, alerts, ratePerSec, count, &res )) ){
+			printf( "%-7s %s\n", G_modeName[mode], SMB2API_Errstring(
+						rv, (char*)res.hist ) );
+			fails++;
+			continue;
+		}
+
+		printf( "%-7s %6u %8u %8u %8u %8u %10u %8u\n",
+				G_modeName[mode], res.installed, res.ratePerSec,
+				res.delivered ? (u_int32)(res.sumUs / res.delivered) : 0,
+				HistPercentile( res.hist, 990 ), res.maxUs,
+				res.coalesced, res.dropped );
+		if( res.dropped )
+			fails++;
+	}
+
+	return fails ? 1 : 0;
+}
+
+/********************************* Bench ***********************************/
+/** Run the benchmark with dispatch \a mode
+ *
+ *  \return 0 | error code
+ */
+static int32 Bench(
+	u_int32	mode,
+	u_int32	alerts,
+	u_int32	ratePerSec,
+	u_int32	count,
+	RESULT	*res )
+{
+	static ALERT		al[ALERT_MAX];
+	SMB2API_ALERT_CFG	cfg;
+	ALERT				*a;
+	void				*smb, *cbArg;
+	u_int32				n, i, t0, due, wait;
+	int32				rv;
+
+	memset( res, 0, sizeof(*res) );
+	memset( al, 0, sizeof(al) );
+
+	if( (rv = SMB2API_InitSim( 0, &smb )) )
+		return rv;
+
+	if( mode != MODE_SIG ){
+		memset( &cfg, 0, sizeof(cfg) );
+		if( mode == MODE_DRAIN )
+			cfg.flags = SMB2API_ALERT_ARA_DRAIN;
+		else if( mode == MODE_POLL )
+			cfg.flags = SMB2API_ALERT_POLL;
+		if( (rv = SMB2API_AlertEngineStart( smb, &cfg )) )
+			goto CLEANUP;
+	}
+
+	/* install alerts (until no free signal) */
+	for( n=0; n<alerts; n++ ){
+		al[n].res = res;
+		al[n].addr = (u_int16)(ALERT_DEV + 2 * n);
+
+		if( SMB2API_SimDevSet( smb, al[n].addr, 1, NULL ) )
+			break;
+
+		/* drain: all alerts share one signal, poll: no signal */
+		if( mode == MODE_DRAIN )
+			rv = SMB2API_AlertCbInstallSig( smb, al[n].addr, BenchCb,
+											(void*)&al[n], UOS_SIG_USR1 );
+		else
+			rv = SMB2API_AlertCbInstall( smb, al[n].addr, BenchCb,
+										 (void*)&al[n] );
+		if( rv )
+			break;
+		res->installed++;
+	}
+
+	if( !res->installed )
+		goto CLEANUP;
+	rv = 0;
+
+	/* raise alerts */
+	t0 = UsecGet();
+	for( i=0; i<count; i++ ){
+		a = &al[i % res->installed];
+
+		if( ratePerSec ){
+			due = (u_int32)(((u_int64)i * 1000000) / ratePerSec);
+			while( (int32)(wait = due - (UsecGet() - t0)) > 0 ){
+				if( wait >= 1000 )
+					UOS_Delay( wait / 1000 );
+			}
+		}
+
+		/* callback of the previous raise outstanding? */
+		if( a->pending )
+			res->coalesced++;
+		else {
+			a->tTrig = UsecGet();
+			__sync_synchronize();
+			a->pending = 1;
+		}
+		res->triggered++;
+
+		SMB2API_SimAlert( smb, a->addr );
+	}
+	wait = UsecGet() - t0;
+	res->ratePerSec = wait ?
+		(u_int32)(((u_int64)res->triggered * 1000000) / wait) : 0;
+
+	/* wait for outstanding callbacks */
+	for( i=0; (res->delivered + res->coalesced != res->triggered) &&
+			  (i < SETTLE_MS); i++ )
+		UOS_Delay( 1 );
+
+	/* remove alerts before the (polling) engine stops */
+	for( n=0; n<res->installed; n++ )
+		SMB2API_AlertCbRemove( smb, al[n].addr, &cbArg );
+	SMB2API_AlertEngineStop( smb );
+
+	res->dropped = res->triggered - res->delivered - res->coalesced;
+
+CLEANUP:
+	SMB2API_Exit( &smb );
+	return rv;
+}
+
+/********************************* BenchCb *********************************/
+/** Alert callback: latency of the raised alert
+ *
+ *  Invoked from the signal (sig mode) or the alert engine, so the
+ *  result is updated by one context at a time.
+ */
+static void BenchCb( void *cbArg )
+{
+	ALERT	*a = (ALERT*)cbArg;
+	RESULT	*res = a->res;
+	u_int32	lat = UsecGet() - a->tTrig;
+	u_int32	n;
+
+	/* callbacks without raised alert are not counted */
+	if( !__sync_bool_compare_and_swap( &a->pending, 1, 0 ) )
+		return;
+
+	res->sumUs += lat;
+	if( lat > res->maxUs )
+		res->maxUs = lat;
+	for( n=0; (lat >> n) && (n < HIST_NUM-1); n++ )
+		;
+	res->hist[n]++;
+	res->delivered++;
+}
+
+/********************************* UsecGet *********************************/
+/** Monotonic time [us]
+ */
+static u_int32 UsecGet( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (u_int32)ts.tv_sec * 1000000 + (u_int32)(ts.tv_nsec / 1000);
+}
+
+/********************************* HistPercentile **************************/
+/** Latency percentile from histogram (upper bound of the bucket) [us]
+ */
+static u_int32 HistPercentile( const u_int32 *hist, u_int32 permille )
+{
+	u_int32	b, total = 0, sum = 0;
+
+	for( b=0; b<HIST_NUM; b++ )
+		total += hist[b];
+
+	for( b=0; b<HIST_NUM; b++ ){
+		sum += hist[b];
+		if( (u_int64)sum * 1000 >= (u_int64)total * permille )
+			break;
+	}
+
+	return (u_int32)1 << (b < HIST_NUM ? b : HIST_NUM - 1);
+}
@@ -0,0 +1,2258 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  smb2_api_test.c
+ *
+ *  	 \brief  Behavior tests of the SMB2_API library
+ *
+ *               The tests run against the simulated SMBus of the library
+ *               (SMB2API_InitSim) or a test backend, no hardware is
+ *               required. Usage: smb2_api_test [<test>...]
+ *
+ *     Required: libraries: smb2_api, mdis_api, usr_oss, pthread
+ *     Switches: -
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_err.h>
+#include <MEN/usr_oss.h>
+#include <MEN/smb2_api.h>
+#include <MEN/smb2_drv.h>
+#include "../../../smb2_api_ext.h"
+#include "../../../smb2_pmbus.h"
+#include "../../../smb2_shm.h"
+
+/*-----------------------------------------+
+|  DEFINES                                 |
++-----------------------------------------*/
+/* check condition, count failure */
+#define CHK( cond ) \
+	do { \
+		if( !(cond) ){ \
+			printf( "  FAILED line %d: %s\n", __LINE__, #cond ); \
+			fails++; \
+		} \
+	} while(0)
+
+#define DEV_A		0x40	/* simulated devices */
+#define DEV_B		0x42
+
+#define TB_LOG_MAX	64		/* logged calls of the test backend */
+
+#define MUX_DEV		0x50	/* devices sharing one alert signal */
+#define MUX_NUM		8
+#define SHM_NAME	"/smb2_api_test"		/* shared memory region */
+#define BROKER_SOCK	"smb2_api_test.sock"	/* broker socket */
+#define REC_FILE	"smb2_api_test.rec"	/* temporary record file */
+#define RATE_READS	10		/* reads per rate limit check */
+
+/* little endian 32-bit value (broker messages) */
+#define LE32( p ) \
+	((u_int32)(p)[0] | ((u_int32)(p)[1] << 8) | \
+	 ((u_int32)(p)[2] << 16) | ((u_int32)(p)[3] << 24))
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/** test case */
+typedef struct
+{
+	const char	*name;
+	int32		(*func)( void );	/**< returns number of failures */
+}TEST;
+
+/** test backend: logs the device addresses, delays calls */
+typedef struct
+{
+	u_int16		slowAddr;			/**< address with delay (0=all) */
+	u_int32		delayMs;			/**< delay of the calls [ms] */
+	volatile u_int32 num;			/**< executed calls */
+	u_int16		addr[TB_LOG_MAX];	/**< device address per call */
+}TB;
+
+/** test backend: I2C controller with few native SMBus accesses */
+typedef struct
+{
+	u_int8		reg[0x100];			/**< registers of the device */
+	u_int8		ptr;				/**< register pointer */
+	u_int32		xfers;				/**< I2C transfers */
+	u_int32		msgs;				/**< messages of the last transfer */
+}IC;
+
+/** notifications of an alert engine */
+typedef struct
+{
+	volatile u_int32 num;			/**< notifications */
+	u_int16		addr[TB_LOG_MAX];	/**< address per notification */
+	u_int32		count[TB_LOG_MAX];	/**< coalesced alerts per notification */
+}NOTIFY_LOG;
+
+/** alert information of the last extended callback */
+typedef struct
+{
+	volatile u_int32 num;			/**< invoked callbacks */
+	SMB2API_ALERT_INFO info;		/**< information of the last one */
+}ALERT_LOG;
+
+/** shared memory publisher thread */
+typedef struct
+{
+	void		*smb;
+	void		*pub;
+	volatile u_int32 stop;			/**< stop the thread */
+	int32		rv;					/**< first error */
+}SHM_PUB;
+
+/** broker thread */
+typedef struct
+{
+	void		*smb;				/**< served SMB handle */
+	volatile u_int32 stop;			/**< stop flag */
+	int32		rv;					/**< result of SMB2API_BrokerServe */
+}BROKER;
+
+/** transaction of a test thread */
+typedef struct
+{
+	void		*smb;
+	u_int32		flags;
+	u_int16		addr;
+	u_int32		delayMs;			/**< delay before the transaction [ms] */
+	int32		rv;
+}TRX_THREAD;
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static int32 SimOpen( void **smbHdlP );
+static int32 TbOpen( TB *tb, void **smbHdlP );
+static void* TrxThread( void *arg );
+static int32 TestPrep( void );
+static int32 TestPrio( void );
+static int32 TestDeadline( void );
+static int32 TestUtil( void );
+static int32 TestRecord( void );
+static int32 RecSeq( void *smb, u_int8 *rdData );
+static void* GatherThread( void *arg );
+static int32 TestGather( void );
+static void CbCount( void *cbArg );
+static void NotifyLog( void *notifyArg, u_int16 addr, u_int32 count );
+static int32 TestAlertEng( void );
+static void CbInfo( void *cbArg, const SMB2API_ALERT_INFO *infoP );
+static int32 TestAlertInfo( void );
+static int32 TestAlertMux( void );
+static int32 TestAlertPoll( void );
+static int32 TestPres( void );
+static int32 FloatEq( float a, float b );
+static int32 TestPmbus( void );
+static void* ShmPubThread( void *arg );
+static int32 TestShm( void );
+static void* BrokerThread( void *arg );
+static int32 BrokerStart(
+	BROKER *b, pthread_t *tidP, void **cli, u_int32 num );
+static int32 BrokerRaw( const u_int8 *req, u_int32 len, u_int8 *rsp );
+static int32 TestBroker( void );
+static int32 TestSmbXfer( void );
+static int32 __MAPILIB IcStat(
+	void *beArg, int32 code, u_int32 isGet, void *obj, u_int32 size );
+static int32 TestRoute( void );
+static int32 TestSnap( void );
+static int32 TestMem( void );
+static void* RateThread( void *arg );
+static int32 TestRate( void );
+static int32 TestClone( void );
+static int32 TestXferV( void );
+
+/*-----------------------------------------+
+|  GLOBALS                                 |
++-----------------------------------------*/
+static const TEST G_test[] = {
+	{ "prep",		TestPrep },
+	{ "prio",		TestPrio },
+	{ "deadline",	TestDeadline },
+	{ "util",		TestUtil },
+	{ "record",		TestRecord },
+	{ "gather",		TestGather },
+	{ "alerteng",	TestAlertEng },
+	{ "alertinfo",	TestAlertInfo },
+	{ "alertmux",	TestAlertMux },
+	{ "alertpoll",	TestAlertPoll },
+	{ "pres",		TestPres },
+	{ "pmbus",		TestPmbus },
+	{ "shm",		TestShm },
+	{ "broker",		TestBroker },
+	{ "smbxfer",	TestSmbXfer },
+	{ "route",		TestRoute },
+	{ "snap",		TestSnap },
+	{ "mem",		TestMem },
+	{ "rate",		TestRate },
+	{ "clone",		TestClone },
+	{ "xferv",		TestXferV },
+};
+
+#define TEST_NUM	(sizeof(G_test)/sizeof(TEST))
+
+/********************************* main ************************************/
+/** Program main function
+ *
+ *  \param argc       \IN  argument counter
+ *  \param argv       \IN  argument vector (test names, all if none)
+ *
+ *  \return	          success (0) or error (1)
+ */
+int main( int argc, char *argv[] )
+{
+	u_int32	n, blocks0, blocks;
+	int32	a, run, fails, total = 0;
+
+	SMB2API_MemStatsGet( &blocks0 );
+
+	for( n=0; n<TEST_NUM; n++ ){
+		run = (argc < 2);
+		for( a=1; a<argc; a++ )
+			if( !strcmp( argv[a], G_test[n].name ) )
+				run = 1;
+		if( !run )
+			continue;
+
+		fails = G_test[n].func();
+		printf( "%-10s %s\n", G_test[n].name, fails ? "FAILED" : "ok" );
+		total += fails;
+	}
+
+	/* no library memory must be left over */
+	SMB2API_MemStatsGet( &blocks );
+	if( blocks != blocks0 ){
+		printf( "memory blocks left: %u\n", blocks - blocks0 );
+		total++;
+	}
+
+	printf( "%s\n", total ? "FAILED" : "all tests passed" );
+	return total ? 1 : 0;
+}
+
+/********************************* SimOpen *********************************/
+/** Open simulated SMBus with devices DEV_A and DEV_B
+ */
+static int32 SimOpen( void **smbHdlP )
+{
+	int32	rv;
+
+	if( (rv = SMB2API_InitSim( 0, smbHdlP )) )
+		return rv;
+
+	SMB2API_SimDevSet( *smbHdlP, DEV_A, 1, NULL );
+	SMB2API_SimDevSet( *smbHdlP, DEV_B, 1, NULL );
+	return 0;
+}
+
+/********************************* TbStat **********************************/
+/** Test backend: transaction
+ */
+static int32 __MAPILIB TbStat(
+	void		*beArg,
+	int32		code,
+	u_int32		isGet,
+	void		*obj,
+	u_int32		size )
+{
+	TB		*tb = (TB*)beArg;
+	u_int16	addr = 0;
+
+	if( code != SMB2_BLK_I2C_XFER ){
+		addr = ((SMB2_TRANSFER*)obj)->addr;
+		if( isGet && (size == sizeof(SMB2_TRANSFER)) )
+			((SMB2_TRANSFER*)obj)->u.wordData = 0;
+	}
+
+	if( tb->delayMs && (!tb->slowAddr || (addr == tb->slowAddr)) )
+		UOS_Delay( tb->delayMs );
+
+	if( tb->num < TB_LOG_MAX )
+		tb->addr[tb->num] = addr;
+	tb->num++;
+
+	return 0;
+}
+
+/********************************* TbOpen **********************************/
+/** Open test backend
+ */
+static int32 TbOpen( TB *tb, void **smbHdlP )
+{
+	static const SMB2API_BACKEND be = { TbStat, NULL };
+
+	return SMB2API_InitBackend( &be, (void*)tb, smbHdlP );
+}
+
+/********************************* TrxThread *******************************/
+/** Thread: read byte data of TRX_THREAD
+ */
+static void* TrxThread( void *arg )
+{
+	TRX_THREAD	*t = (TRX_THREAD*)arg;
+	u_int8		val;
+
+	if( t->delayMs )
+		UOS_Delay( t->delayMs );
+	t->rv = SMB2API_ReadByteData( t->smb, t->flags, t->addr, 0, &val );
+	return NULL;
+}
+
+/********************************* TestPrep ********************************/
+/** Prepared transactions and batches
+ */
+static int32 TestPrep( void )
+{
+	void	*smb, *wr, *rd, *rdw, *batch;
+	void	*prep[3];
+	u_int8	val = 0x5a, got = 0;
+	u_int8	word[2] = { 0x34, 0x12 };
+	u_int8	*data[3];
+	u_int32	errIdx;
+	int32	fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	CHK( !SMB2API_Prepare( smb, 0, DEV_A, SMB_WRITE, 0x10,
+						   SMB_ACC_BYTE_DATA, &wr ) );
+	CHK( !SMB2API_Prepare( smb, 0, DEV_A, SMB_READ, 0x10,
+						   SMB_ACC_BYTE_DATA, &rd ) );
+	CHK( !SMB2API_Prepare( smb, 0, DEV_A, SMB_READ, 0x10,
+						   SMB_ACC_WORD_DATA, &rdw ) );
+
+	/* single execution matches the plain functions */
+	CHK( !SMB2API_PrepExec( wr, &val ) );
+	CHK( !SMB2API_PrepExec( rd, &got ) && got == 0x5a );
+	CHK( !SMB2API_WriteWordData( smb, 0, DEV_A, 0x10, 0x1234 ) );
+	memset( word, 0, sizeof(word) );
+	CHK( !SMB2API_PrepExec( rdw, word ) && *(u_int16*)word == 0x1234 );
+
+	/* invalid handles/buffers */
+	CHK( SMB2API_PrepExec( NULL, &val ) == SMB_ERR_PARAM );
+	CHK( SMB2API_PrepExec( rd, NULL ) == SMB_ERR_PARAM );
+	CHK( SMB2API_Prepare( smb, 0, DEV_A, SMB_READ, 0, 0x77, &prep[0] ) ==
+		 SMB_ERR_NOT_SUPPORTED && prep[0] == NULL );
+
+	/* batch in creation order */
+	val = 0xa5;
+	got = 0;
+	prep[0] = wr;
+	prep[1] = rd;
+	prep[2] = rdw;
+	data[0] = &val;
+	data[1] = &got;
+	data[2] = word;
+	CHK( !SMB2API_PrepBatchCreate( prep, 3, &batch ) );
+	CHK( !SMB2API_PrepBatchExec( batch, data, &errIdx ) && errIdx == 3 );
+	CHK( got == 0xa5 );
+	CHK( SMB2API_PrepBatchExec( NULL, data, NULL ) == SMB_ERR_PARAM );
+	CHK( SMB2API_PrepBatchExec( batch, NULL, NULL ) == SMB_ERR_PARAM );
+
+	/* batch stops at the first failing transaction */
+	SMB2API_SimDevSet( smb, DEV_A, 0, NULL );
+	CHK( SMB2API_PrepBatchExec( batch, data, &errIdx ) && errIdx == 0 );
+
+	SMB2API_PrepBatchFree( &batch );
+	SMB2API_PrepFree( &wr );
+	SMB2API_PrepFree( &rd );
+	SMB2API_PrepFree( &rdw );
+	CHK( batch == NULL && wr == NULL );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* CbSigRead *******************************/
+/** Alert callback: read register in signal context
+ */
+static void CbSigRead( void *cbArg )
+{
+	TRX_THREAD	*t = (TRX_THREAD*)cbArg;
+	u_int8		val;
+
+	t->rv = SMB2API_ReadByteData( t->smb, 0, t->addr, 0, &val );
+}
+
+/********************************* TestPrio ********************************/
+/** Priority classes: service order, statistics, signal context
+ */
+static int32 TestPrio( void )
+{
+	TB					tb;
+	TRX_THREAD			t[3];
+	pthread_t			tid[3];
+	SMB2API_PRIO_STATS	ps[SMB2API_PRIO_NUM];
+	void				*smb, *arg;
+	u_int32				n;
+	int32				fails = 0;
+
+	memset( &tb, 0, sizeof(tb) );
+	tb.slowAddr = 0x10;
+	tb.delayMs = 100;
+	if( TbOpen( &tb, &smb ) )
+		return 1;
+
+	/*
+	 * 0x10 holds the bus, then a low and a high priority request
+	 * queue up: the high one must be served first
+	 */
+	memset( t, 0, sizeof(t) );
+	t[0].addr = 0x10;
+	t[1].addr = 0x20;
+	t[1].flags = SMB2API_FLAG_PRIO_LOW;
+	t[2].addr = 0x30;
+	t[2].flags = SMB2API_FLAG_PRIO_HIGH;
+	for( n=0; n<3; n++ ){
+		t[n].smb = smb;
+		pthread_create( &tid[n], NULL, TrxThread, &t[n] );
+		UOS_Delay( 20 );
+	}
+	for( n=0; n<3; n++ )
+		pthread_join( tid[n], NULL );
+
+	CHK( tb.num == 3 );
+	CHK( tb.addr[0] == 0x10 && tb.addr[1] == 0x30 && tb.addr[2] == 0x20 );
+	CHK( !t[0].rv && !t[1].rv && !t[2].rv );
+
+	/* statistics per class */
+	for( n=0; n<SMB2API_PRIO_NUM; n++ )
+		CHK( !SMB2API_PrioStatsGet( smb, n, &ps[n] ) && ps[n].count == 1 );
+	CHK( ps[SMB2API_PRIO_LOW].avgWaitUs > ps[SMB2API_PRIO_HIGH].avgWaitUs );
+	CHK( ps[SMB2API_PRIO_NORMAL].maxUs >= 100000 );
+
+	CHK( !SMB2API_PrioStatsReset( smb ) );
+	CHK( !SMB2API_PrioStatsGet( smb, SMB2API_PRIO_LOW, &ps[0] ) &&
+		 ps[0].count == 0 );
+
+	/* invalid parameters */
+	CHK( SMB2API_PrioSet( SMB2API_PRIO_NUM ) == SMB_ERR_PARAM );
+	CHK( SMB2API_PrioStatsGet( NULL, 0, &ps[0] ) == SMB_ERR_PARAM );
+	CHK( SMB2API_PrioStatsGet( smb, SMB2API_PRIO_NUM, &ps[0] ) ==
+		 SMB_ERR_PARAM );
+	CHK( SMB2API_PrioStatsGet( smb, 0, NULL ) == SMB_ERR_PARAM );
+	CHK( SMB2API_PrioStatsReset( NULL ) == SMB_ERR_PARAM );
+	SMB2API_Exit( &smb );
+
+	/*
+	 * alert callback in signal context: direct driver call, no
+	 * arbitration (and so no statistics)
+	 */
+	if( SimOpen( &smb ) )
+		return fails + 1;
+
+	t[0].smb = smb;
+	t[0].addr = DEV_B;
+	t[0].rv = -1;
+	CHK( !SMB2API_AlertCbInstall( smb, DEV_A, CbSigRead, &t[0] ) );
+	SMB2API_PrioStatsGet( smb, SMB2API_PRIO_NORMAL, &ps[0] );
+	CHK( !SMB2API_SimAlert( smb, DEV_A ) );
+	CHK( t[0].rv == 0 );
+	CHK( !SMB2API_PrioStatsGet( smb, SMB2API_PRIO_NORMAL, &ps[1] ) &&
+		 ps[1].count == ps[0].count );
+	CHK( !SMB2API_AlertCbRemove( smb, DEV_A, &arg ) && arg == &t[0] );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* TestDeadline ****************************/
+/** Deadlines: drop before bus access, overrun, accounting
+ */
+static int32 TestDeadline( void )
+{
+	TB			tb;
+	TRX_THREAD	t;
+	pthread_t	tid;
+	void		*smb;
+	u_int8		val;
+	u_int32		dropped, overrun;
+	int32		fails = 0;
+
+	memset( &tb, 0, sizeof(tb) );
+	tb.slowAddr = 0x10;
+	tb.delayMs = 100;
+	if( TbOpen( &tb, &smb ) )
+		return 1;
+
+	/* bus held by another thread: dropped without bus access */
+	memset( &t, 0, sizeof(t) );
+	t.smb = smb;
+	t.addr = 0x10;
+	pthread_create( &tid, NULL, TrxThread, &t );
+	UOS_Delay( 20 );
+	CHK( !SMB2API_DeadlineSet( smb, 30 ) );
+	CHK( SMB2API_ReadByteData( smb, 0, 0x20, 0, &val ) ==
+		 SMB2API_ERR_DEADLINE );
+	pthread_join( tid, NULL );
+	CHK( !t.rv && tb.num == 1 );
+
+	/* driver call longer than the deadline */
+	CHK( SMB2API_ReadByteData( smb, 0, 0x10, 0, &val ) ==
+		 SMB2API_ERR_OVERRUN );
+	CHK( !SMB2API_ReadByteData( smb, 0, 0x20, 0, &val ) );
+	CHK( !SMB2API_DeadlineStatsGet( smb, &dropped, &overrun ) &&
+		 dropped == 1 && overrun == 1 );
+
+	/* thread deadline, the earlier one applies */
+	CHK( !SMB2API_DeadlineSet( smb, 0 ) );
+	CHK( !SMB2API_DeadlineCallSet( 10 ) );
+	CHK( SMB2API_ReadByteData( smb, 0, 0x10, 0, &val ) ==
+		 SMB2API_ERR_OVERRUN );
+	CHK( !SMB2API_DeadlineCallSet( 0 ) );
+	CHK( !SMB2API_ReadByteData( smb, 0, 0x10, 0, &val ) );
+	CHK( !SMB2API_DeadlineStatsGet( smb, NULL, &overrun ) && overrun == 2 );
+
+	/* reset together with the latency statistics */
+	CHK( !SMB2API_PrioStatsReset( smb ) );
+	CHK( !SMB2API_DeadlineStatsGet( smb, &dropped, &overrun ) &&
+		 !dropped && !overrun );
+
+	/* invalid parameters */
+	CHK( SMB2API_DeadlineSet( NULL, 10 ) == SMB_ERR_PARAM );
+	CHK( SMB2API_DeadlineSet( smb, SMB2API_DEADLINE_MAX + 1 ) ==
+		 SMB_ERR_PARAM );
+	CHK( SMB2API_DeadlineCallSet( SMB2API_DEADLINE_MAX + 1 ) ==
+		 SMB_ERR_PARAM );
+	CHK( SMB2API_DeadlineStatsGet( NULL, &dropped, NULL ) == SMB_ERR_PARAM );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* TestUtil ********************************/
+/** Bus utilization monitor and background throttling
+ */
+static int32 TestUtil( void )
+{
+	SMB2API_UTIL	util;
+	void			*smb;
+	u_int32			t0;
+	u_int8			val;
+	int32			fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	CHK( !SMB2API_UtilGet( smb, &util ) && util.busClk == 100000 );
+
+	/* 10kHz bus: each byte data read occupies it for milliseconds */
+	CHK( !SMB2API_UtilCfg( smb, 10000, 100 ) );
+	t0 = UOS_MsecTimerGet();
+	while( UOS_MsecTimerGet() - t0 < 100 )
+		SMB2API_ReadByteData( smb, 0, DEV_A, 0, &val );
+
+	CHK( !SMB2API_UtilGet( smb, &util ) );
+	CHK( util.busClk == 10000 && util.utilPermille > 100 );
+	CHK( util.trxPerSec > 0 && util.bytesPerSec > util.trxPerSec );
+	CHK( util.throttled == 0 );
+
+	/* background transaction waits until the average dropped */
+	CHK( !SMB2API_ReadByteData( smb, SMB2API_FLAG_PRIO_LOW, DEV_A, 0, &val ) );
+	CHK( !SMB2API_UtilGet( smb, &util ) );
+	CHK( util.throttled > 0 && util.utilPermille <= 100 );
+
+	/* invalid parameters */
+	CHK( SMB2API_UtilCfg( NULL, 0, 0 ) == SMB_ERR_PARAM );
+	CHK( SMB2API_UtilCfg( smb, 0, 1001 ) == SMB_ERR_PARAM );
+	CHK( SMB2API_UtilGet( NULL, &util ) == SMB_ERR_PARAM );
+	CHK( SMB2API_UtilGet( smb, NULL ) == SMB_ERR_PARAM );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* RecSeq **********************************/
+/** Access sequence for record/replay (all transfer object types),
+ *  read data to rdData[0..11], returns number of failed accesses
+ */
+static int32 RecSeq( void *smb, u_int8 *rdData )
+{
+	u_int8			blk[5] = { 1, 2, 3, 4, 5 };
+	u_int8			ptr[2] = { 0x20, 0x77 };
+	u_int8			len;
+	u_int16			word;
+	SMB_I2CMESSAGE	msg[2];
+	int32			err = 0;
+
+	err += !!SMB2API_WriteByteData( smb, 0, DEV_A, 0x01, 0x11 );
+	err += !!SMB2API_ReadByteData( smb, 0, DEV_A, 0x01, &rdData[0] );
+	err += !!SMB2API_WriteWordData( smb, 0, DEV_A, 0x02, 0x2233 );
+	err += !!SMB2API_ReadWordData( smb, 0, DEV_A, 0x02, &word );
+	rdData[1] = (u_int8)word;
+	rdData[2] = (u_int8)(word >> 8);
+	err += !!SMB2API_WriteBlockData( smb, 0, DEV_A, 0x10, 5, blk );
+	err += !!SMB2API_ReadBlockData( smb, 0, DEV_A, 0x10, &len, &rdData[4] );
+	rdData[3] = len;
+	err += !!SMB2API_QuickComm( smb, 0, DEV_B, SMB_WRITE );
+
+	/* write 0x77 to 0x20, read it back */
+	msg[0].addr = DEV_A;
+	msg[0].flags = 0;
+	msg[0].len = 2;
+	msg[0].buf = ptr;
+	err += !!SMB2API_I2CXfer( smb, msg, 1 );
+	msg[0].len = 1;
+	msg[1].addr = DEV_A;
+	msg[1].flags = I2C_M_RD;
+	msg[1].len = 1;
+	msg[1].buf = &rdData[9];
+	err += !!SMB2API_I2CXfer( smb, msg, 2 );
+
+	/* failing access (absent device) */
+	err += !SMB2API_ReadByteData( smb, 0, 0x50, 0, &rdData[10] );
+
+	return err;
+}
+
+/********************************* TestRecord ******************************/
+/** Record and replay: codec round trip, playback, mismatch detection
+ */
+static int32 TestRecord( void )
+{
+	static const u_int16	gAddr[] = { DEV_A, DEV_B };
+	SMB2API_REPLAY_RESULT	res;
+	SMB2API_PRIO_STATS		ps;
+	void					*smb, *sim2, *pb;
+	u_int8					rd[12], rd2[12];
+	u_int8					val, gData[2], gData2[2];
+	int32					fails = 0, status[2];
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	memset( rd, 0, sizeof(rd) );
+	CHK( !SMB2API_RecordStart( smb, REC_FILE ) );
+	CHK( SMB2API_RecordStart( smb, REC_FILE ) == SMB_ERR_BUSY );
+	CHK( !RecSeq( smb, rd ) );
+	CHK( !SMB2API_RecordStop( smb ) );
+	CHK( !SMB2API_RecordStop( smb ) );
+	CHK( rd[0] == 0x11 && rd[1] == 0x33 && rd[2] == 0x22 );
+	CHK( rd[3] == 5 && rd[4] == 1 && rd[8] == 5 && rd[9] == 0x77 );
+
+	/* replay against an identical bus: no mismatch */
+	CHK( !SimOpen( &sim2 ) );
+	CHK( !SMB2API_Replay( sim2, REC_FILE, SMB2API_REPLAY_MAX_SPEED, &res ) );
+	CHK( res.records == 11 && !res.rvMismatch && !res.dataMismatch );
+	CHK( res.firstMismatch == res.records );
+
+	/* device gone: return codes differ from the first access */
+	SMB2API_SimDevSet( sim2, DEV_A, 0, NULL );
+	CHK( !SMB2API_Replay( sim2, REC_FILE, SMB2API_REPLAY_MAX_SPEED, &res ) );
+	CHK( res.rvMismatch > 0 && res.firstMismatch == 0 );
+	SMB2API_Exit( &sim2 );
+
+	/* playback: recorded results without bus */
+	memset( rd2, 0, sizeof(rd2) );
+	CHK( !SMB2API_InitPlayback( REC_FILE, &pb ) );
+	CHK( !RecSeq( pb, rd2 ) );
+	CHK( !memcmp( rd, rd2, sizeof(rd) ) );
+	CHK( SMB2API_ReadByteData( pb, 0, DEV_A, 0, &val ) ==
+		 SMB2API_ERR_RECORD );
+	SMB2API_Exit( &pb );
+
+	/* invalid parameters */
+	CHK( SMB2API_RecordStart( NULL, REC_FILE ) == SMB_ERR_PARAM );
+	CHK( SMB2API_RecordStop( NULL ) == SMB_ERR_PARAM );
+	CHK( SMB2API_InitPlayback( "smb2_api_test.none", &pb ) );
+
+	/*
+	 * transactions of a gather read (bus owned by the list) are
+	 * recorded and counted like single transactions
+	 */
+	CHK( !SMB2API_WriteByteData( smb, 0, DEV_B, 0, 0x44 ) );
+	CHK( !SMB2API_PrioStatsReset( smb ) );
+	CHK( !SMB2API_RecordStart( smb, REC_FILE ) );
+	CHK( !SMB2API_GatherRead( smb, 0, gAddr, 2, 0, SMB_ACC_BYTE_DATA,
+							  gData, status ) );
+	CHK( !SMB2API_ReadByteData( smb, 0, DEV_A, 0, &val ) );
+	CHK( !SMB2API_RecordStop( smb ) );
+	CHK( !SMB2API_PrioStatsGet( smb, SMB2API_PRIO_NORMAL, &ps ) &&
+		 ps.count == 3 );
+
+	CHK( !SimOpen( &sim2 ) );
+	CHK( !SMB2API_WriteByteData( sim2, 0, DEV_A, 0, gData[0] ) );
+	CHK( !SMB2API_WriteByteData( sim2, 0, DEV_B, 0, 0x44 ) );
+	CHK( !SMB2API_Replay( sim2, REC_FILE, SMB2API_REPLAY_MAX_SPEED, &res ) );
+	CHK( res.records == 3 && !res.rvMismatch && !res.dataMismatch );
+	SMB2API_Exit( &sim2 );
+
+	CHK( !SMB2API_InitPlayback( REC_FILE, &pb ) );
+	CHK( !SMB2API_GatherRead( pb, 0, gAddr, 2, 0, SMB_ACC_BYTE_DATA,
+							  gData2, status ) );
+	CHK( !memcmp( gData, gData2, sizeof(gData) ) && gData2[1] == 0x44 );
+	CHK( !SMB2API_ReadByteData( pb, 0, DEV_A, 0, &val ) &&
+		 val == gData[0] );
+	SMB2API_Exit( &pb );
+
+	/* invalid parameters */
+	CHK( SMB2API_Replay( NULL, REC_FILE, SMB2API_REPLAY_MAX_SPEED, &res ) ==
+		 SMB_ERR_PARAM );
+	CHK( SMB2API_Replay( smb, NULL, SMB2API_REPLAY_MAX_SPEED, &res ) ==
+		 SMB_ERR_PARAM );
+	CHK( SMB2API_Replay( smb, REC_FILE, SMB2API_REPLAY_MAX_SPEED, NULL ) ==
+		 SMB_ERR_PARAM );
+
+	SMB2API_Exit( &smb );
+	remove( REC_FILE );
+	return fails;
+}
+
+/********************************* GatherThread ****************************/
+/** Thread: gather read of the devices 0x10, 0x12, 0x14 of TRX_THREAD
+ */
+static void* GatherThread( void *arg )
+{
+	static const u_int16 addr[] = { 0x10, 0x12, 0x14 };
+	TRX_THREAD	*t = (TRX_THREAD*)arg;
+	int32		status[3];
+	u_int8		data[3];
+
+	t->rv = SMB2API_GatherRead( t->smb, t->flags, addr, 3, 0,
+								SMB_ACC_BYTE_DATA, data, status );
+	return NULL;
+}
+
+/********************************* TestGather ******************************/
+/** Gather read: results, presence cache, bus owned for the list
+ */
+static int32 TestGather( void )
+{
+	static const u_int16 addr[] = { DEV_A, 0x50, DEV_B };
+	TB					tb;
+	TRX_THREAD			t[2];
+	pthread_t			tid[2];
+	SMB2API_SIM_STATS	ss0, ss1;
+	SMB2API_PRES_STATS	ps;
+	void				*smb;
+	u_int16				data[3];
+	int32				status[3];
+	int32				fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	CHK( !SMB2API_WriteWordData( smb, 0, DEV_A, 5, 0x1234 ) );
+	CHK( !SMB2API_WriteWordData( smb, 0, DEV_B, 5, 0x5678 ) );
+
+	/* dense results, failed device zeroed */
+	memset( data, 0xff, sizeof(data) );
+	CHK( !SMB2API_GatherRead( smb, 0, addr, 3, 5, SMB_ACC_WORD_DATA,
+							  (u_int8*)data, status ) );
+	CHK( !status[0] && data[0] == 0x1234 );
+	CHK( status[1] == SMB_ERR_ADDR && data[1] == 0 );
+	CHK( !status[2] && data[2] == 0x5678 );
+
+	/* without presence cache the absent device is accessed again */
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( !SMB2API_GatherRead( smb, 0, addr, 3, 5, SMB_ACC_WORD_DATA,
+							  (u_int8*)data, status ) );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( status[1] == SMB_ERR_ADDR && ss1.naks == ss0.naks + 1 );
+
+	/* with presence cache it is skipped, unless rescan */
+	CHK( !SMB2API_PresCacheSet( smb, 10000 ) );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( !SMB2API_GatherRead( smb, 0, addr, 3, 5, SMB_ACC_WORD_DATA,
+							  (u_int8*)data, status ) );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( status[1] == SMB_ERR_ADDR && ss1.naks == ss0.naks );
+	CHK( ss1.trx == ss0.trx + 2 );
+	CHK( !SMB2API_PresStatsGet( smb, &ps ) && ps.avoided == 1 );
+
+	CHK( !SMB2API_GatherRead( smb, SMB2API_FLAG_RESCAN, addr, 3, 5,
+							  SMB_ACC_WORD_DATA, (u_int8*)data, status ) );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( ss0.naks == ss1.naks + 1 );
+
+	/* invalid parameters */
+	CHK( SMB2API_GatherRead( NULL, 0, addr, 3, 5, SMB_ACC_WORD_DATA,
+							 (u_int8*)data, status ) == SMB_ERR_PARAM );
+	CHK( SMB2API_GatherRead( smb, 0, addr, 3, 5, SMB_ACC_WORD_DATA,
+							 (u_int8*)data, NULL ) == SMB_ERR_PARAM );
+	CHK( SMB2API_GatherRead( smb, 0, addr, 3, 5, SMB_ACC_PROC_CALL,
+							 (u_int8*)data, status ) ==
+		 SMB_ERR_NOT_SUPPORTED );
+	SMB2API_Exit( &smb );
+
+	/*
+	 * the bus is owned for the whole list: a high priority request
+	 * queued during the slow first device is served after the list
+	 */
+	memset( &tb, 0, sizeof(tb) );
+	tb.slowAddr = 0x10;
+	tb.delayMs = 100;
+	if( TbOpen( &tb, &smb ) )
+		return fails + 1;
+
+	memset( t, 0, sizeof(t) );
+	t[0].smb = t[1].smb = smb;
+	t[1].addr = 0x30;
+	t[1].flags = SMB2API_FLAG_PRIO_HIGH;
+	pthread_create( &tid[0], NULL, GatherThread, &t[0] );
+	UOS_Delay( 20 );
+	pthread_create( &tid[1], NULL, TrxThread, &t[1] );
+	pthread_join( tid[0], NULL );
+	pthread_join( tid[1], NULL );
+
+	CHK( !t[0].rv && !t[1].rv && tb.num == 4 );
+	CHK( tb.addr[0] == 0x10 && tb.addr[1] == 0x12 && tb.addr[2] == 0x14 &&
+		 tb.addr[3] == 0x30 );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* CbCount *********************************/
+/** Alert callback: count invocations
+ */
+static void CbCount( void *cbArg )
+{
+	(*(volatile u_int32*)cbArg)++;
+}
+
+/********************************* NotifyLog *******************************/
+/** Alert engine notify function: log address and count
+ */
+static void NotifyLog( void *notifyArg, u_int16 addr, u_int32 count )
+{
+	NOTIFY_LOG *log = (NOTIFY_LOG*)notifyArg;
+
+	if( log->num < TB_LOG_MAX ){
+		log->addr[log->num] = addr;
+		log->count[log->num] = count;
+	}
+	log->num++;
+}
+
+/********************************* TestAlertEng ****************************/
+/** Alert engine: ARA drain, coalescing window, notification
+ */
+static int32 TestAlertEng( void )
+{
+	SMB2API_ALERT_CFG	cfg;
+	SMB2API_ALERT_STATS	as0, as1;
+	NOTIFY_LOG			log;
+	void				*smb, *arg;
+	volatile u_int32	called = 0;
+	u_int32				n;
+	int32				fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	memset( &log, 0, sizeof(log) );
+	memset( &cfg, 0, sizeof(cfg) );
+	cfg.flags = SMB2API_ALERT_ARA_DRAIN;
+	cfg.windowMs = 200;
+	cfg.notifyFunc = NotifyLog;
+	cfg.notifyArg = &log;
+
+	CHK( !SMB2API_AlertCbInstall( smb, DEV_A, CbCount, (void*)&called ) );
+	CHK( !SMB2API_AlertEngineStart( smb, &cfg ) );
+	SMB2API_AlertStatsGet( &as0 );
+
+	/*
+	 * DEV_B has no callback (no signal): found by the ARA drain of the
+	 * first DEV_A alert. The alerts of DEV_A within the window are
+	 * coalesced into one callback.
+	 */
+	CHK( !SMB2API_SimAlert( smb, DEV_B ) );
+	for( n=0; n<5; n++ ){
+		CHK( !SMB2API_SimAlert( smb, DEV_A ) );
+		UOS_Delay( 10 );
+	}
+	for( n=0; (log.num < 2) && (n < 1000); n++ )
+		UOS_Delay( 1 );
+
+	CHK( called == 1 );
+	CHK( log.num == 2 );
+	CHK( log.addr[0] == DEV_A && log.count[0] == 5 );
+	CHK( log.addr[1] == DEV_B && log.count[1] == 1 );
+
+	SMB2API_AlertStatsGet( &as1 );
+	CHK( as1.notifies - as0.notifies == 2 );
+	CHK( as1.coalesced - as0.coalesced == 4 );
+	CHK( as1.araReads - as0.araReads == 6 );
+
+	/* engine runs once per handle */
+	CHK( SMB2API_AlertEngineStart( smb, &cfg ) == SMB_ERR_BUSY );
+	CHK( SMB2API_AlertEngineStart( NULL, &cfg ) == SMB_ERR_PARAM );
+
+	CHK( !SMB2API_AlertEngineStop( smb ) );
+	CHK( !SMB2API_AlertCbRemove( smb, DEV_A, &arg ) && arg == &called );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* CbInfo **********************************/
+/** Extended alert callback: save alert information
+ */
+static void CbInfo( void *cbArg, const SMB2API_ALERT_INFO *infoP )
+{
+	ALERT_LOG *log = (ALERT_LOG*)cbArg;
+
+	log->info = *infoP;
+	log->num++;
+}
+
+/********************************* TestAlertInfo ***************************/
+/** Extended alert callbacks: information with and without engine,
+ *  status register pre-read by the engine only
+ */
+static int32 TestAlertInfo( void )
+{
+	SMB2API_ALERT_PREREAD	pre;
+	SMB2API_ALERT_CFG		cfg;
+	ALERT_LOG				log;
+	void					*smb, *arg;
+	u_int32					n;
+	int32					fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	CHK( !SMB2API_WriteWordData( smb, 0, DEV_A, 3, 0xbeef ) );
+	pre.cmdAddr = 3;
+	pre.size = SMB_ACC_WORD_DATA;
+	memset( &log, 0, sizeof(log) );
+
+	/* signal context: no status register */
+	CHK( SMB2API_AlertCbInstallEx( smb, DEV_A, CbInfo, &log, &pre, 0 ) ==
+		 SMB_ERR_NOT_SUPPORTED );
+	CHK( !SMB2API_AlertCbInstallEx( smb, DEV_A, CbInfo, &log, NULL, 0 ) );
+	CHK( !SMB2API_SimAlert( smb, DEV_A ) );
+	CHK( log.num == 1 );
+	CHK( log.info.addr == DEV_A && log.info.count == 1 );
+	CHK( !log.info.araValid && !log.info.statusValid );
+	CHK( !SMB2API_AlertCbRemove( smb, DEV_A, &arg ) && arg == &log );
+
+	/* engine: alert response data and status register */
+	memset( &cfg, 0, sizeof(cfg) );
+	cfg.flags = SMB2API_ALERT_ARA_DRAIN;
+	CHK( !SMB2API_AlertEngineStart( smb, &cfg ) );
+	CHK( !SMB2API_AlertCbInstallEx( smb, DEV_A, CbInfo, &log, &pre, 0 ) );
+
+	memset( &log, 0, sizeof(log) );
+	CHK( !SMB2API_SimAlert( smb, DEV_A ) );
+	for( n=0; !log.num && (n < 1000); n++ )
+		UOS_Delay( 1 );
+
+	CHK( log.num == 1 );
+	CHK( log.info.addr == DEV_A && log.info.count == 1 );
+	CHK( log.info.araValid && (log.info.araData & 0xfe) == DEV_A );
+	CHK( log.info.statusValid && !log.info.statusRv );
+	CHK( log.info.status == 0xbeef );
+
+	/* block reads can not be pre-read */
+	pre.size = SMB_ACC_BLOCK_DATA;
+	CHK( SMB2API_AlertCbInstallEx( smb, DEV_B, CbInfo, &log, &pre, 0 ) ==
+		 SMB_ERR_NOT_SUPPORTED );
+
+	CHK( !SMB2API_AlertEngineStop( smb ) );
+	CHK( !SMB2API_AlertCbRemove( smb, DEV_A, &arg ) && arg == &log );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* TestAlertMux ****************************/
+/** Many alert addresses over one signal
+ */
+static int32 TestAlertMux( void )
+{
+	SMB2API_ALERT_CFG	cfg;
+	volatile u_int32	called[MUX_NUM];
+	void				*smb, *arg;
+	u_int32				n;
+	u_int8				ara;
+	int32				fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	memset( (void*)called, 0, sizeof(called) );
+	for( n=0; n<MUX_NUM; n++ ){
+		SMB2API_SimDevSet( smb, (u_int16)(MUX_DEV + 2 * n), 1, NULL );
+		CHK( !SMB2API_AlertCbInstallSig( smb, (u_int16)(MUX_DEV + 2 * n),
+										 CbCount, (void*)&called[n],
+										 UOS_SIG_USR2 ) );
+	}
+
+	/* without engine: the callback installed first for the signal */
+	CHK( !SMB2API_SimAlert( smb, MUX_DEV + 4 ) );
+	CHK( called[0] == 1 && called[2] == 0 );
+	CHK( !SMB2API_ReadByte( smb, 0, 0x18, &ara ) && ara == MUX_DEV + 4 );
+
+	/* engine: alerting addresses read from the alert response address */
+	memset( (void*)called, 0, sizeof(called) );
+	memset( &cfg, 0, sizeof(cfg) );
+	cfg.flags = SMB2API_ALERT_ARA_DRAIN;
+	CHK( !SMB2API_AlertEngineStart( smb, &cfg ) );
+
+	CHK( !SMB2API_SimAlert( smb, MUX_DEV + 4 ) );
+	CHK( !SMB2API_SimAlert( smb, MUX_DEV + 10 ) );
+	for( n=0; (!called[2] || !called[5]) && (n < 1000); n++ )
+		UOS_Delay( 1 );
+
+	for( n=0; n<MUX_NUM; n++ )
+		CHK( called[n] == ((n == 2 || n == 5) ? 1U : 0U) );
+
+	CHK( !SMB2API_AlertEngineStop( smb ) );
+	for( n=0; n<MUX_NUM; n++ )
+		CHK( !SMB2API_AlertCbRemove( smb, (u_int16)(MUX_DEV + 2 * n),
+									 &arg ) && arg == &called[n] );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* TestAlertPoll ***************************/
+/** Polling alert engine: callbacks without signal, adaptive interval
+ */
+static int32 TestAlertPoll( void )
+{
+	SMB2API_ALERT_CFG	cfg;
+	SMB2API_ALERT_STATS	as0, as1;
+	SMB2API_SIM_STATS	ss;
+	volatile u_int32	called = 0;
+	void				*smb, *arg;
+	u_int32				n;
+	int32				fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	memset( &cfg, 0, sizeof(cfg) );
+	cfg.flags = SMB2API_ALERT_POLL;
+	cfg.pollMinMs = 5;
+	cfg.pollMaxMs = 40;
+	CHK( !SMB2API_AlertEngineStart( smb, &cfg ) );
+	CHK( !SMB2API_AlertCbInstall( smb, DEV_A, CbCount, (void*)&called ) );
+
+	/* idle: the interval backs off to pollMaxMs */
+	SMB2API_AlertStatsGet( &as0 );
+	UOS_Delay( 400 );
+	SMB2API_AlertStatsGet( &as1 );
+	CHK( as1.polls - as0.polls >= 5 && as1.polls - as0.polls <= 20 );
+
+	/* alert found by polling, no signal */
+	CHK( !SMB2API_SimAlert( smb, DEV_A ) );
+	for( n=0; !called && (n < 1000); n++ )
+		UOS_Delay( 1 );
+	CHK( called == 1 );
+	CHK( !SMB2API_SimStatsGet( smb, &ss ) && ss.signals == 0 );
+
+	CHK( !SMB2API_AlertCbRemove( smb, DEV_A, &arg ) && arg == &called );
+	CHK( !SMB2API_AlertEngineStop( smb ) );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* TestPres ********************************/
+/** Presence cache: fail fast, TTL, rescan, invalidate
+ */
+static int32 TestPres( void )
+{
+	SMB2API_SIM_STATS	ss0, ss1;
+	SMB2API_PRES_STATS	ps;
+	void				*smb;
+	u_int8				val;
+	int32				fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	CHK( !SMB2API_PresCacheSet( smb, 50 ) );
+
+	/* absent device: the second access fails without bus access */
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( SMB2API_ReadByteData( smb, 0, 0x50, 0, &val ) == SMB_ERR_ADDR );
+	CHK( SMB2API_ReadByteData( smb, 0, 0x50, 0, &val ) == SMB_ERR_ADDR );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( ss1.naks == ss0.naks + 1 );
+	CHK( !SMB2API_PresStatsGet( smb, &ps ) );
+	CHK( ps.absent == 1 && ps.avoided == 1 && ps.expired == 0 );
+
+	/* TTL expired: bus access again */
+	UOS_Delay( 60 );
+	CHK( SMB2API_ReadByteData( smb, 0, 0x50, 0, &val ) == SMB_ERR_ADDR );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( ss0.naks == ss1.naks + 1 );
+	CHK( !SMB2API_PresStatsGet( smb, &ps ) && ps.expired == 1 );
+
+	/* plugged in: found by rescan only */
+	SMB2API_SimDevSet( smb, 0x50, 1, NULL );
+	CHK( SMB2API_ReadByteData( smb, 0, 0x50, 0, &val ) == SMB_ERR_ADDR );
+	CHK( !SMB2API_ReadByteData( smb, SMB2API_FLAG_RESCAN, 0x50, 0, &val ) );
+	CHK( !SMB2API_ReadByteData( smb, 0, 0x50, 0, &val ) );
+
+	/* removed, then invalidated */
+	SMB2API_SimDevSet( smb, 0x50, 0, NULL );
+	CHK( SMB2API_ReadByteData( smb, 0, 0x50, 0, &val ) == SMB_ERR_ADDR );
+	CHK( !SMB2API_PresInvalidate( smb, SMB2API_PRES_ALL ) );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( SMB2API_ReadByteData( smb, 0, 0x50, 0, &val ) == SMB_ERR_ADDR );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( ss1.naks == ss0.naks + 1 );
+
+	/* found absent: first, after TTL, after removal, after invalidate */
+	CHK( !SMB2API_PresStatsGet( smb, &ps ) );
+	CHK( ps.absent == 4 && ps.invalidated == 1 && ps.avoided == 2 );
+
+	/* cache off: no access is skipped */
+	CHK( !SMB2API_PresCacheSet( smb, 0 ) );
+	CHK( SMB2API_ReadByteData( smb, 0, 0x50, 0, &val ) == SMB_ERR_ADDR );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( ss0.naks == ss1.naks + 1 );
+
+	/* invalid parameters */
+	CHK( SMB2API_PresCacheSet( NULL, 0 ) == SMB_ERR_PARAM );
+	CHK( SMB2API_PresInvalidate( smb, 0x1000 ) == SMB_ERR_PARAM );
+	CHK( SMB2API_PresStatsGet( smb, NULL ) == SMB_ERR_PARAM );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* FloatEq *********************************/
+/** Compare floats with relative tolerance 1e-6
+ */
+static int32 FloatEq( float a, float b )
+{
+	float d = a - b, m = (b < 0) ? -b : b;
+
+	if( d < 0 )
+		d = -d;
+	return d <= m * 1e-6f + 1e-12f;
+}
+
+/********************************* TestPmbus *******************************/
+/** PMBus: page cache, telemetry set, LINEAR11/LINEAR16/DIRECT decoders
+ */
+static int32 TestPmbus( void )
+{
+	static const u_int16 lin11[] = {
+		(0x1e << 11) | 100,		/* 100 * 2^-2 */
+		0x07ff,					/* -1 * 2^0 */
+		(0x0f << 11) | 1,		/* 1 * 2^15 */
+		(0x10 << 11) | 0x400	/* -1024 * 2^-16 */
+	};
+	static const u_int16 lin16[] = { 0x1800, 0xffff, 0 };
+	static const u_int16 direct[] = { 30, 0xfffe, 123 };
+	SMB2API_PMBUS_DEV		dev;
+	SMB2API_PMBUS_TLM		tlm[3];
+	SMB2API_PMBUS_DIRECT	coef;
+	TB						tb;
+	TRX_THREAD				t;
+	pthread_t				tid;
+	void					*smb, *set;
+	u_int16					raw[3];
+	int32					status[3];
+	float					val[4];
+	int32					fails = 0;
+
+	/* decoders */
+	SMB2API_PmbusLinear11( lin11, 4, val );
+	CHK( val[0] == 25.0f && val[1] == -1.0f && val[2] == 32768.0f &&
+		 val[3] == -0.015625f );
+
+	CHK( SMB2API_PMBUS_VOUT_EXP( 0x14 ) == -12 );
+	CHK( SMB2API_PMBUS_VOUT_EXP( 0x03 ) == 3 );
+	SMB2API_PmbusLinear16( lin16, 3, SMB2API_PMBUS_VOUT_EXP( 0x14 ), val );
+	CHK( val[0] == 1.5f && FloatEq( val[1], 65535.0f / 4096 ) &&
+		 val[2] == 0.0f );
+
+	coef.m = 2;
+	coef.b = 10;
+	coef.r = 0;
+	SMB2API_PmbusDirect( direct, 2, &coef, val );
+	CHK( val[0] == 10.0f && val[1] == -6.0f );
+	coef.m = 1;
+	coef.b = 0;
+	coef.r = 1;
+	SMB2API_PmbusDirect( &direct[2], 1, &coef, val );
+	CHK( FloatEq( val[0], 12.3f ) );
+	coef.m = 0;
+	SMB2API_PmbusDirect( direct, 3, &coef, val );
+	CHK( val[0] == 0.0f && val[2] == 0.0f );
+
+	/* page cache */
+	if( SimOpen( &smb ) )
+		return fails + 1;
+
+	CHK( !SMB2API_PmbusDevInit( &dev, smb, 0, DEV_A ) );
+	CHK( !SMB2API_PmbusWriteWord( &dev, 1, SMB2API_PMBUS_READ_VOUT,
+								  0x1800 ) );
+	CHK( !SMB2API_PmbusReadWord( &dev, 1, SMB2API_PMBUS_READ_VOUT,
+								 &raw[0] ) && raw[0] == 0x1800 );
+	CHK( dev.page == 1 && dev.pageWrites == 1 && dev.pageSkips == 1 );
+	CHK( !SMB2API_PmbusReadWord( &dev, SMB2API_PMBUS_NOPAGE,
+								 SMB2API_PMBUS_READ_VOUT, &raw[0] ) );
+	CHK( dev.pageWrites == 1 && dev.pageSkips == 1 );
+	CHK( SMB2API_PmbusPageSet( &dev, 0x100 + 1 ) == SMB_ERR_PARAM );
+
+	/* telemetry set: each page selected once per read */
+	CHK( !SMB2API_PmbusWriteWord( &dev, 0, SMB2API_PMBUS_READ_TEMPERATURE_1,
+								  0xd0c8 ) );
+	tlm[0].dev = tlm[1].dev = tlm[2].dev = &dev;
+	tlm[0].page = 0;
+	tlm[0].cmd = SMB2API_PMBUS_READ_VOUT;
+	tlm[1].page = 1;
+	tlm[1].cmd = SMB2API_PMBUS_READ_VOUT;
+	tlm[2].page = 0;
+	tlm[2].cmd = SMB2API_PMBUS_READ_TEMPERATURE_1;
+	CHK( !SMB2API_PmbusTlmCreate( tlm, 3, &set ) );
+
+	CHK( !SMB2API_PmbusPageSet( &dev, 1 ) );
+	dev.pageWrites = 0;
+	CHK( !SMB2API_PmbusTlmRead( set, raw, status ) );
+	CHK( !status[0] && !status[1] && !status[2] );
+	CHK( raw[0] == 0x1800 && raw[1] == 0x1800 && raw[2] == 0xd0c8 );
+	CHK( dev.pageWrites == 2 );
+
+	SMB2API_PmbusTlmFree( &set );
+	CHK( set == NULL );
+	CHK( SMB2API_PmbusTlmCreate( tlm, 0, &set ) == SMB_ERR_PARAM );
+
+	SMB2API_Exit( &smb );
+
+	/*
+	 * PAGE write and reads of a page in one bus ownership: even a high
+	 * priority access of another thread waits for the group
+	 */
+	memset( &tb, 0, sizeof(tb) );
+	tb.slowAddr = 0x10;
+	tb.delayMs = 30;
+	if( TbOpen( &tb, &smb ) )
+		return fails + 1;
+	CHK( !SMB2API_PmbusDevInit( &dev, smb, 0, 0x10 ) );
+	tlm[0].page = tlm[1].page = 1;
+	CHK( !SMB2API_PmbusTlmCreate( tlm, 2, &set ) );
+
+	memset( &t, 0, sizeof(t) );
+	t.smb = smb;
+	t.flags = SMB2API_FLAG_PRIO_HIGH;
+	t.addr = 0x30;
+	t.delayMs = 10;
+	pthread_create( &tid, NULL, TrxThread, &t );
+	CHK( !SMB2API_PmbusTlmRead( set, raw, status ) );
+	pthread_join( tid, NULL );
+	CHK( !t.rv && !status[0] && !status[1] );
+	CHK( tb.num == 4 );
+	CHK( tb.addr[0] == 0x10 && tb.addr[1] == 0x10 && tb.addr[2] == 0x10 &&
+		 tb.addr[3] == 0x30 );
+
+	SMB2API_PmbusTlmFree( &set );
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* ShmPubThread ****************************/
+/** Thread: change the register of DEV_A (both bytes equal) and publish
+ */
+static void* ShmPubThread( void *arg )
+{
+	SHM_PUB		*p = (SHM_PUB*)arg;
+	u_int32		n;
+
+	for( n=1; !p->stop && !p->rv; n++ ){
+		if( (p->rv = SMB2API_WriteWordData( p->smb, 0, DEV_A, 1,
+											(u_int16)((n & 0xff) * 0x0101) )) )
+			break;
+		p->rv = SMB2API_ShmPubUpdate( p->pub );
+	}
+
+	return NULL;
+}
+
+/********************************* TestShm *********************************/
+/** Shared memory publisher: values, status, consistent reads
+ */
+static int32 TestShm( void )
+{
+	SMB2API_SHM_ENTRY	ent[3];
+	SMB2API_SHM_VALUE	val;
+	SHM_PUB				p;
+	pthread_t			tid;
+	void				*shm;
+	u_int32				num, idx, n, polls, polls0, ok = 0, torn = 0;
+	int32				rv, fails = 0;
+
+	if( SimOpen( &p.smb ) )
+		return 1;
+
+	ent[0].addr = DEV_A;
+	ent[0].cmdAddr = 1;
+	ent[0].size = SMB_ACC_WORD_DATA;
+	ent[1].addr = DEV_B;
+	ent[1].cmdAddr = 2;
+	ent[1].size = SMB_ACC_BYTE_DATA;
+	ent[2].addr = 0x50;
+	ent[2].cmdAddr = 0;
+	ent[2].size = SMB_ACC_BYTE_DATA;
+
+	CHK( !SMB2API_WriteWordData( p.smb, 0, DEV_A, 1, 0x1234 ) );
+	CHK( !SMB2API_WriteByteData( p.smb, 0, DEV_B, 2, 0x56 ) );
+	CHK( !SMB2API_ShmPubCreate( SHM_NAME, p.smb, 0, ent, 3, &p.pub ) );
+	CHK( !SMB2API_ShmOpen( SHM_NAME, &shm, &num ) && num == 3 );
+
+	/* no data before the first poll */
+	CHK( !SMB2API_ShmRead( shm, 0, &val ) &&
+		 val.status == SMB2API_ERR_NO_DATA );
+
+	CHK( !SMB2API_ShmPubUpdate( p.pub ) );
+	CHK( !SMB2API_ShmFind( shm, DEV_A, 1, &idx ) && idx == 0 );
+	CHK( !SMB2API_ShmRead( shm, idx, &val ) && !val.status );
+	CHK( val.polls == 1 && *(u_int16*)val.data == 0x1234 );
+	CHK( !SMB2API_ShmRead( shm, 1, &val ) && !val.status &&
+		 val.data[0] == 0x56 );
+	CHK( !SMB2API_ShmRead( shm, 2, &val ) && val.status == SMB_ERR_ADDR );
+	CHK( SMB2API_ShmFind( shm, DEV_B, 3, &idx ) == SMB_ERR_PARAM );
+	CHK( SMB2API_ShmRead( shm, 3, &val ) == SMB_ERR_PARAM );
+
+	/* reads during updates: never torn */
+	CHK( !SMB2API_WriteWordData( p.smb, 0, DEV_A, 1, 0 ) );
+	CHK( !SMB2API_ShmPubUpdate( p.pub ) );
+	SMB2API_ShmPolls( shm, &polls0 );
+	p.stop = 0;
+	p.rv = 0;
+	pthread_create( &tid, NULL, ShmPubThread, &p );
+	for( n=0; n<200000; n++ ){
+		if( (rv = SMB2API_ShmRead( shm, 0, &val )) ){
+			CHK( rv == SMB_ERR_BUSY );
+			continue;
+		}
+		if( val.data[0] != val.data[1] )
+			torn++;
+		ok++;
+	}
+	p.stop = 1;
+	pthread_join( tid, NULL );
+
+	CHK( !p.rv && !torn && ok > 0 );
+	CHK( !SMB2API_ShmPolls( shm, &polls ) && polls > polls0 );
+
+	CHK( !SMB2API_ShmClose( &shm ) && shm == NULL );
+	CHK( !SMB2API_ShmPubDestroy( &p.pub ) && p.pub == NULL );
+	CHK( SMB2API_ShmOpen( SHM_NAME, &shm, &num ) );
+
+	SMB2API_Exit( &p.smb );
+	return fails;
+}
+
+/********************************* BrokerThread ****************************/
+/** Thread: serve broker clients until stopped
+ */
+static void* BrokerThread( void *arg )
+{
+	BROKER *b = (BROKER*)arg;
+
+	b->rv = SMB2API_BrokerServe( b->smb, BROKER_SOCK, &b->stop );
+	return NULL;
+}
+
+/********************************* BrokerStart *****************************/
+/** Start broker thread and connect \a num clients
+ */
+static int32 BrokerStart(
+	BROKER *b, pthread_t *tidP, void **cli, u_int32 num )
+{
+	u_int32	n, t;
+	int32	rv = 0;
+
+	b->stop = 0;
+	b->rv = -1;
+	pthread_create( tidP, NULL, BrokerThread, b );
+
+	/* socket is created by the thread */
+	for( n=0; n<num; n++ ){
+		for( t=0; t<100; t++ ){
+			if( !(rv = SMB2API_InitBroker( BROKER_SOCK, &cli[n] )) )
+				break;
+			UOS_Delay( 10 );
+		}
+		if( rv )
+			break;
+	}
+
+	return rv;
+}
+
+/********************************* BrokerRaw *******************************/
+/** Send raw request to the broker, returns response length or -1
+ */
+static int32 BrokerRaw( const u_int8 *req, u_int32 len, u_int8 *rsp )
+{
+	struct sockaddr_un	sa;
+	u_int32				got = 0, need = 4;
+	ssize_t				n;
+	int					fd;
+
+	if( (fd = socket( AF_UNIX, SOCK_STREAM, 0 )) < 0 )
+		return -1;
+
+	memset( &sa, 0, sizeof(sa) );
+	sa.sun_family = AF_UNIX;
+	strncpy( sa.sun_path, BROKER_SOCK, sizeof(sa.sun_path) - 1 );
+
+	if( connect( fd, (struct sockaddr*)&sa, sizeof(sa) ) ||
+		(write( fd, req, len ) != (ssize_t)len) ){
+		close( fd );
+		return -1;
+	}
+
+	/* len(4) and the bytes following it */
+	while( got < need ){
+		if( (n = read( fd, rsp + got, need - got )) <= 0 )
+			break;
+		got += (u_int32)n;
+		if( got == 4 )
+			need = 4 + (rsp[0] | (rsp[1] << 8));
+	}
+
+	close( fd );
+	return (got == need) ? (int32)got : -1;
+}
+
+/********************************* TestBroker ******************************/
+/** Broker: access over the socket, permissions, malformed requests,
+ *  priority of concurrent clients
+ */
+static int32 TestBroker( void )
+{
+	/* I2C_XFER: write and read of 0xffff bytes, no write data sent */
+	static const u_int8 rawReq[] = {
+		24, 0, 0, 0,  0, 0, 0, 0,  1, 1,  2, 0,
+		DEV_A, 0, 0, 0, 0xff, 0xff, 0, 0,
+		DEV_A, 0, I2C_M_RD & 0xff, I2C_M_RD >> 8, 0xff, 0xff, 0, 0 };
+	static u_int8	big[2][0xffff];
+	SMB2API_I2C_MSGV msgv[2];
+	SMB2API_I2C_VEC	vec[2];
+	BROKER			b;
+	TB				tb;
+	TRX_THREAD		t[3];
+	pthread_t		tid[3], btid;
+	struct stat		st;
+	void			*cli[3], *arg;
+	u_int8			req[sizeof(rawReq)], rsp[16];
+	u_int32			n;
+	u_int16			word;
+	int32			fails = 0;
+
+	if( SimOpen( &b.smb ) )
+		return 1;
+
+	if( BrokerStart( &b, &btid, cli, 1 ) ){
+		b.stop = 1;
+		pthread_join( btid, NULL );
+		SMB2API_Exit( &b.smb );
+		return 1;
+	}
+
+	/* owner and group only */
+	CHK( !stat( BROKER_SOCK, &st ) && (st.st_mode & 0777) == 0660 );
+
+	CHK( !SMB2API_WriteWordData( cli[0], 0, DEV_A, 4, 0xcafe ) );
+	CHK( !SMB2API_ReadWordData( cli[0], 0, DEV_A, 4, &word ) &&
+		 word == 0xcafe );
+	CHK( SMB2API_ReadWordData( cli[0], 0, 0x50, 4, &word ) == SMB_ERR_ADDR );
+	CHK( SMB2API_AlertCbInstall( cli[0], DEV_A, CbCount, &word ) ==
+		 SMB_ERR_NOT_SUPPORTED );
+
+	/* more I2C data than a request takes: rejected by the client */
+	for( n=0; n<2; n++ ){
+		vec[n].buf = big[n];
+		vec[n].len = 0xffff;
+		msgv[n].addr = DEV_A;
+		msgv[n].flags = I2C_M_RD;
+		msgv[n].vecNum = 1;
+		msgv[n].vec = &vec[n];
+	}
+	CHK( SMB2API_I2CXferV( cli[0], msgv, 2 ) == SMB_ERR_PARAM );
+
+	/* malformed requests: rejected without execution */
+	memcpy( req, rawReq, sizeof(req) );
+	for( n=0; n<4; n++ )
+		req[4 + n] = (u_int8)((u_int32)SMB2_BLK_I2C_XFER >> (8 * n));
+	CHK( BrokerRaw( req, sizeof(req), rsp ) == 8 &&
+		 LE32( rsp + 4 ) == SMB_ERR_PARAM );
+	/* second message truncated */
+	req[0] = 16;
+	CHK( BrokerRaw( req, 4 + 16, rsp ) == 8 &&
+		 LE32( rsp + 4 ) == SMB_ERR_PARAM );
+	CHK( !SMB2API_ReadWordData( cli[0], 0, DEV_A, 4, &word ) &&
+		 word == 0xcafe );
+
+	SMB2API_Exit( &cli[0] );
+	b.stop = 1;
+	pthread_join( btid, NULL );
+	CHK( b.rv == 0 && stat( BROKER_SOCK, &st ) );
+	SMB2API_Exit( &b.smb );
+
+	/*
+	 * clients served concurrently: while 0x10 holds the bus, the high
+	 * priority request of the third client overtakes the second one
+	 */
+	memset( &tb, 0, sizeof(tb) );
+	tb.slowAddr = 0x10;
+	tb.delayMs = 100;
+	if( TbOpen( &tb, &b.smb ) )
+		return fails + 1;
+
+	if( BrokerStart( &b, &btid, cli, 3 ) )
+		fails++;
+	else {
+		memset( t, 0, sizeof(t) );
+		t[0].addr = 0x10;
+		t[1].addr = 0x20;
+		t[1].flags = SMB2API_FLAG_PRIO_LOW;
+		t[2].addr = 0x30;
+		t[2].flags = SMB2API_FLAG_PRIO_HIGH;
+		for( n=0; n<3; n++ ){
+			t[n].smb = cli[n];
+			pthread_create( &tid[n], NULL, TrxThread, &t[n] );
+			UOS_Delay( 20 );
+		}
+		for( n=0; n<3; n++ )
+			pthread_join( tid[n], NULL );
+
+		CHK( !t[0].rv && !t[1].rv && !t[2].rv && tb.num == 3 );
+		CHK( tb.addr[0] == 0x10 && tb.addr[1] == 0x30 &&
+			 tb.addr[2] == 0x20 );
+
+		for( n=0; n<3; n++ )
+			SMB2API_Exit( &cli[n] );
+	}
+
+	b.stop = 1;
+	pthread_join( btid, NULL );
+	CHK( b.rv == 0 );
+
+	/* invalid parameters */
+	CHK( SMB2API_BrokerServe( NULL, BROKER_SOCK, NULL ) == SMB_ERR_PARAM );
+	CHK( SMB2API_InitBroker( NULL, &arg ) == SMB_ERR_PARAM );
+
+	SMB2API_Exit( &b.smb );
+	return fails;
+}
+
+/********************************* TestSmbXfer *****************************/
+/** Generic SMBus access and access lists
+ */
+static int32 TestSmbXfer( void )
+{
+	SMB2API_XFER		xfer[3];
+	SMB2API_SIM_STATS	ss0, ss1;
+	void				*smb;
+	u_int8				d[1 + SMB_BLOCK_MAX_BYTES], blk[4] = { 3, 1, 2, 3 };
+	u_int16				word;
+	u_int32				errIdx;
+	int32				fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	/* each access size with its data buffer layout */
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_WRITE, 0, SMB_ACC_QUICK, d ) );
+
+	d[0] = 0x11;
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_WRITE, 0x20,
+						   SMB_ACC_BYTE_DATA, d ) );
+	d[0] = 0x20;
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_WRITE, 0, SMB_ACC_BYTE, d ) );
+	d[0] = 0;
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_READ, 0, SMB_ACC_BYTE, d ) &&
+		 d[0] == 0x11 );
+	d[0] = 0;
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_READ, 0x20,
+						   SMB_ACC_BYTE_DATA, d ) && d[0] == 0x11 );
+
+	word = 0xa55a;
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_WRITE, 0x22,
+						   SMB_ACC_WORD_DATA, (u_int8*)&word ) );
+	word = 0;
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_READ, 0x22,
+						   SMB_ACC_WORD_DATA, (u_int8*)&word ) &&
+		 word == 0xa55a );
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_WRITE, 0x24,
+						   SMB_ACC_PROC_CALL, (u_int8*)&word ) &&
+		 word == 0xa55a );
+
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_WRITE, 0x30,
+						   SMB_ACC_BLOCK_DATA, blk ) );
+	memset( d, 0, sizeof(d) );
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_READ, 0x30,
+						   SMB_ACC_BLOCK_DATA, d ) );
+	CHK( !memcmp( d, blk, sizeof(blk) ) );
+
+	/* simulated device returns the written block */
+	memset( d, 0, sizeof(d) );
+	memcpy( d, blk, sizeof(blk) );
+	CHK( !SMB2API_SmbXfer( smb, 0, DEV_A, SMB_WRITE, 0x40,
+						   SMB_ACC_BLOCK_PROC_CALL, d ) );
+	CHK( !memcmp( d, blk, sizeof(blk) ) );
+
+	CHK( SMB2API_SmbXfer( smb, 0, DEV_A, SMB_READ, 0,
+						  SMB_ACC_I2C_BLOCK_DATA, d ) ==
+		 SMB_ERR_NOT_SUPPORTED );
+
+	/* list: all descriptors checked before the first bus access */
+	memset( xfer, 0, sizeof(xfer) );
+	xfer[0].addr = DEV_A;
+	xfer[0].readWrite = SMB_READ;
+	xfer[0].cmdAddr = 0x20;
+	xfer[0].size = SMB_ACC_BYTE_DATA;
+	xfer[0].dataP = &d[0];
+	xfer[1] = xfer[0];
+	xfer[1].addr = DEV_B;
+	xfer[1].dataP = &d[1];
+	xfer[2] = xfer[0];
+	xfer[2].size = SMB_ACC_I2C_BLOCK_DATA;
+
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( SMB2API_SmbXferList( smb, xfer, 3, &errIdx ) ==
+		 SMB_ERR_NOT_SUPPORTED && errIdx == 2 );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( ss1.trx == ss0.trx );
+
+	/* list stops at the first failing access */
+	CHK( !SMB2API_SmbXferList( smb, xfer, 2, &errIdx ) && errIdx == 2 );
+	CHK( d[0] == 0x11 );
+	xfer[0].addr = 0x50;
+	CHK( SMB2API_SmbXferList( smb, xfer, 2, &errIdx ) == SMB_ERR_ADDR &&
+		 errIdx == 0 );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( ss0.trx == ss1.trx + 3 );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* IcStat **********************************/
+/** I2C-only controller backend: byte data reads and block reads natively,
+ *  other SMBus accesses through I2C messages
+ */
+static int32 __MAPILIB IcStat(
+	void		*beArg,
+	int32		code,
+	u_int32		isGet,
+	void		*obj,
+	u_int32		size )
+{
+	IC						*ic = (IC*)beArg;
+	SMB_I2CMESSAGE			*msg = (SMB_I2CMESSAGE*)obj;
+	SMB2_TRANSFER_BLOCK		*trxBlk = (SMB2_TRANSFER_BLOCK*)obj;
+	u_int32					m, n;
+
+	switch( code ){
+	case SMB2_BLK_READ_BYTE_DATA:
+		((SMB2_TRANSFER*)obj)->u.byteData =
+			ic->reg[((SMB2_TRANSFER*)obj)->cmdAddr];
+		return 0;
+	case SMB2_BLK_READ_BLOCK_DATA:
+		/* no block process call */
+		if( trxBlk->u.writeLen )
+			return (SMB_ERR_NOT_SUPPORTED);
+		trxBlk->u.length = ic->reg[trxBlk->cmdAddr];
+		memcpy( trxBlk->data, &ic->reg[trxBlk->cmdAddr + 1],
+				trxBlk->u.length );
+		return 0;
+	case SMB2_BLK_I2C_XFER:
+		ic->xfers++;
+		ic->msgs = size / sizeof(SMB_I2CMESSAGE);
+		for( m=0; m<ic->msgs; m++, msg++ ){
+			n = 0;
+			if( !(msg->flags & I2C_M_RD) && msg->len )
+				ic->ptr = msg->buf[n++];
+			for( ; n<msg->len; n++ ){
+				if( msg->flags & I2C_M_RD )
+					msg->buf[n] = ic->reg[ic->ptr++];
+				else
+					ic->reg[ic->ptr++] = msg->buf[n];
+			}
+		}
+		return 0;
+	}
+
+	return (SMB_ERR_NOT_SUPPORTED);
+}
+
+/********************************* TestRoute *******************************/
+/** Routing: native default of backends, emulation in one I2C transfer,
+ *  learned capabilities, emulation on the simulator and over the broker
+ */
+static int32 TestRoute( void )
+{
+	static const SMB2API_BACKEND be = { IcStat, NULL };
+	IC				ic;
+	BROKER			b;
+	SMB2API_CAP		cap;
+	SMB2API_SIM_STATS ss0, ss1;
+	pthread_t		btid;
+	void			*smb, *cli;
+	u_int8			blk[SMB_BLOCK_MAX_BYTES], len, rdLen;
+	u_int16			word;
+	int32			fails = 0;
+
+	memset( &ic, 0, sizeof(ic) );
+	ic.reg[0x10] = 0x34;
+	ic.reg[0x11] = 0x12;
+	ic.reg[0x20] = 2;
+	ic.reg[0x21] = 0xaa;
+	ic.reg[0x22] = 0x55;
+	if( SMB2API_InitBackend( &be, (void*)&ic, &smb ) )
+		return 1;
+
+	/* default of backend handles: operations as requested */
+	CHK( SMB2API_ReadWordData( smb, 0, 0x50, 0x10, &word ) ==
+		 SMB_ERR_NOT_SUPPORTED );
+	CHK( ic.xfers == 0 );
+
+	/* fallback: command write and read in one transfer */
+	CHK( !SMB2API_RouteSet( smb, SMB2API_ROUTE_FALLBACK ) );
+	word = 0;
+	CHK( !SMB2API_ReadWordData( smb, 0, 0x50, 0x10, &word ) );
+	CHK( word == 0x1234 && ic.xfers == 1 && ic.msgs == 2 );
+	CHK( !SMB2API_CapGet( smb, SMB_READ, SMB_ACC_WORD_DATA, &cap ) );
+	CHK( cap.native == SMB2API_CAP_NO && cap.emulated == SMB2API_CAP_YES );
+	CHK( cap.emulatedCnt == 1 );
+
+	CHK( !SMB2API_WriteWordData( smb, 0, 0x50, 0x12, 0xbeef ) );
+	CHK( ic.xfers == 2 && ic.msgs == 1 );
+	CHK( ic.reg[0x12] == 0xef && ic.reg[0x13] == 0xbe );
+
+	/* block accesses are not emulated, own capability per access */
+	CHK( !SMB2API_ReadBlockData( smb, 0, 0x50, 0x20, &len, blk ) );
+	CHK( len == 2 && blk[0] == 0xaa && blk[1] == 0x55 );
+	CHK( SMB2API_BlockProcessCall( smb, 0, 0x50, 0x20, 2, blk,
+								   &rdLen, blk ) == SMB_ERR_NOT_SUPPORTED );
+	CHK( ic.xfers == 2 );
+	CHK( !SMB2API_CapGet( smb, SMB_READ, SMB_ACC_BLOCK_DATA, &cap ) );
+	CHK( cap.native == SMB2API_CAP_YES && cap.emulated == SMB2API_CAP_NO );
+	CHK( !SMB2API_CapGet( smb, SMB_READ, SMB_ACC_BLOCK_PROC_CALL, &cap ) );
+	CHK( cap.native == SMB2API_CAP_NO && cap.emulated == SMB2API_CAP_NO );
+
+	CHK( SMB2API_RouteSet( smb, SMB2API_ROUTE_FASTEST + 1 ) ==
+		 SMB_ERR_PARAM );
+	SMB2API_Exit( &smb );
+
+	/* simulator: the fastest route measures the emulation */
+	if( SimOpen( &smb ) )
+		return fails + 1;
+	CHK( !SMB2API_WriteWordData( smb, 0, DEV_A, 0x30, 0x5678 ) );
+	CHK( !SMB2API_RouteSet( smb, SMB2API_ROUTE_FASTEST ) );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( !SMB2API_ReadWordData( smb, 0, DEV_A, 0x30, &word ) );
+	CHK( word == 0x5678 );
+	word = 0;
+	CHK( !SMB2API_ReadWordData( smb, 0, DEV_A, 0x30, &word ) );
+	CHK( word == 0x5678 );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( ss1.trx == ss0.trx + 2 );
+	CHK( !SMB2API_CapGet( smb, SMB_READ, SMB_ACC_WORD_DATA, &cap ) );
+	CHK( cap.native == SMB2API_CAP_YES && cap.emulated == SMB2API_CAP_YES );
+	CHK( cap.emulatedCnt == 1 );
+
+	/* broker: the messages of the emulation in one request */
+	b.smb = smb;
+	if( BrokerStart( &b, &btid, &cli, 1 ) )
+		fails++;
+	else {
+		CHK( !SMB2API_RouteSet( cli, SMB2API_ROUTE_FASTEST ) );
+		CHK( !SMB2API_ReadWordData( cli, 0, DEV_A, 0x30, &word ) );
+		word = 0;
+		CHK( !SMB2API_ReadWordData( cli, 0, DEV_A, 0x30, &word ) );
+		CHK( word == 0x5678 );
+		CHK( !SMB2API_CapGet( cli, SMB_READ, SMB_ACC_WORD_DATA, &cap ) );
+		CHK( cap.emulated == SMB2API_CAP_YES && cap.emulatedCnt == 1 );
+		SMB2API_SimStatsGet( smb, &ss0 );
+		CHK( ss0.trx == ss1.trx + 2 );
+		SMB2API_Exit( &cli );
+	}
+
+	b.stop = 1;
+	pthread_join( btid, NULL );
+	CHK( b.rv == 0 );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* TestSnap ********************************/
+/** Register snapshots: sequential and bytewise read, restore of the
+ *  differing registers only
+ */
+static int32 TestSnap( void )
+{
+	SMB2API_SIM_STATS ss0, ss1;
+	void		*smb;
+	u_int8		regs[SMB2API_SNAP_REG_NUM], snap[16], snap2[16], cur[16];
+	u_int32		n, written;
+	int32		fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	for( n=0; n<SMB2API_SNAP_REG_NUM; n++ )
+		regs[n] = (u_int8)(n ^ 0xa5);
+	SMB2API_SimDevSet( smb, DEV_A, 1, regs );
+
+	/* sequential read: few transfers, same result as bytewise */
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( !SMB2API_SnapRead( smb, 0, DEV_A, SMB2API_SNAP_SEQ, 0x10, 16,
+							snap ) );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( ss1.trx - ss0.trx <= 2 );
+	CHK( !memcmp( snap, &regs[0x10], 16 ) );
+
+	CHK( !SMB2API_SnapRead( smb, 0, DEV_A, 0, 0x10, 16, snap2 ) );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( ss0.trx == ss1.trx + 16 );
+	CHK( !memcmp( snap, snap2, 16 ) );
+
+	/* nothing changed: no write */
+	CHK( !SMB2API_SnapRestore( smb, 0, DEV_A, SMB2API_SNAP_SEQ, 0x10, 16,
+							   snap, &written ) );
+	CHK( written == 0 );
+
+	/* close differences merged, distant ones written separately */
+	CHK( !SMB2API_WriteByteData( smb, 0, DEV_A, 0x12, 0x00 ) );
+	CHK( !SMB2API_WriteByteData( smb, 0, DEV_A, 0x14, 0x00 ) );
+	CHK( !SMB2API_WriteByteData( smb, 0, DEV_A, 0x1a, 0x00 ) );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( !SMB2API_SnapRestore( smb, 0, DEV_A, SMB2API_SNAP_SEQ, 0x10, 16,
+							   snap, &written ) );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( written == 4 );
+	CHK( ss1.trx - ss0.trx <= 4 );
+	CHK( !SMB2API_SnapRead( smb, 0, DEV_A, 0, 0x10, 16, cur ) );
+	CHK( !memcmp( cur, snap, 16 ) );
+
+	/* bytewise restore writes the differing registers only */
+	CHK( !SMB2API_WriteByteData( smb, 0, DEV_A, 0x12, 0x00 ) );
+	CHK( !SMB2API_WriteByteData( smb, 0, DEV_A, 0x1f, 0x00 ) );
+	CHK( !SMB2API_SnapRestore( smb, 0, DEV_A, 0, 0x10, 16, snap,
+							   &written ) );
+	CHK( written == 2 );
+	CHK( !SMB2API_SnapRead( smb, 0, DEV_A, SMB2API_SNAP_SEQ, 0x10, 16,
+							cur ) );
+	CHK( !memcmp( cur, snap, 16 ) );
+
+	/* last register, empty range */
+	CHK( !SMB2API_SnapRead( smb, 0, DEV_A, SMB2API_SNAP_SEQ, 0xff, 1,
+							cur ) );
+	CHK( cur[0] == regs[0xff] );
+	CHK( !SMB2API_SnapRead( smb, 0, DEV_A, 0, 0x10, 0, cur ) );
+
+	/* absent device, invalid parameters */
+	CHK( SMB2API_SnapRead( smb, 0, 0x50, SMB2API_SNAP_SEQ, 0, 4, cur ) ==
+		 SMB_ERR_ADDR );
+	CHK( SMB2API_SnapRestore( smb, 0, 0x50, 0, 0, 4, snap, &written ) ==
+		 SMB_ERR_ADDR && written == 0 );
+	CHK( SMB2API_SnapRead( smb, 0, DEV_A, 0, 0xff, 2, cur ) ==
+		 SMB_ERR_PARAM );
+	CHK( SMB2API_SnapRead( smb, 0, DEV_A, 0, 0, 1, NULL ) ==
+		 SMB_ERR_PARAM );
+	CHK( SMB2API_SnapRestore( NULL, 0, DEV_A, 0, 0, 1, snap, &written ) ==
+		 SMB_ERR_PARAM );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* TestMem *********************************/
+/** CRC-32, I2C memory write/read/verify, recorded memory reads
+ */
+static int32 TestMem( void )
+{
+	static const u_int8 check[] = "123456789";
+	SMB2API_REPLAY_RESULT	res;
+	SMB2API_SIM_STATS		ss0, ss1;
+	void		*smb, *pb;
+	u_int8		data[200], rd[200];
+	u_int32		n, crc, errOff;
+	int32		fails = 0;
+
+	/* check value of CRC-32/ISO-HDLC, in pieces, slicing vs. bytewise */
+	CHK( SMB2API_Crc32( 0, check, 9 ) == 0xcbf43926 );
+	CHK( SMB2API_Crc32( SMB2API_Crc32( 0, check, 4 ), check + 4, 5 ) ==
+		 0xcbf43926 );
+	CHK( SMB2API_Crc32( 0x1234, check, 0 ) == 0x1234 );
+	for( n=0; n<sizeof(data); n++ )
+		data[n] = (u_int8)(n * 7 + 3);
+	for( crc=0, n=0; n<sizeof(data); n++ )
+		crc = SMB2API_Crc32( crc, &data[n], 1 );
+	CHK( SMB2API_Crc32( 0, data, sizeof(data) ) == crc );
+
+	if( SimOpen( &smb ) )
+		return fails + 1;
+
+	/* page writes, verify by CRC-32 per chunk */
+	CHK( !SMB2API_MemWrite( smb, 0, DEV_A, SMB2API_MEM_VERIFY, 0x20, data,
+							sizeof(data), 16, &errOff ) );
+	CHK( errOff == sizeof(data) );
+
+	/* pointer write and read in one transfer */
+	memset( rd, 0, sizeof(rd) );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( !SMB2API_MemRead( smb, 0, DEV_A, 0, 0x20, rd, sizeof(rd) ) );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( ss1.trx == ss0.trx + 1 );
+	CHK( !memcmp( rd, data, sizeof(rd) ) );
+
+	CHK( !SMB2API_MemVerify( smb, 0, DEV_A, 0, 0x20, data, sizeof(data), 0,
+							 &errOff ) );
+	CHK( errOff == sizeof(data) );
+
+	/* differing byte: offset of its chunk */
+	CHK( !SMB2API_WriteByteData( smb, 0, DEV_A, 0x20 + 70, 0 ) );
+	CHK( SMB2API_MemVerify( smb, 0, DEV_A, 0, 0x20, data, sizeof(data), 32,
+							&errOff ) == SMB2API_ERR_VERIFY );
+	CHK( errOff == 64 );
+
+	/* record and replay/playback the combined transfers */
+	CHK( !SMB2API_RecordStart( smb, REC_FILE ) );
+	CHK( !SMB2API_MemRead( smb, 0, DEV_A, 0, 0x20, rd, 100 ) );
+	CHK( !SMB2API_RecordStop( smb ) );
+	CHK( !SMB2API_Replay( smb, REC_FILE, SMB2API_REPLAY_MAX_SPEED, &res ) );
+	CHK( res.records == 1 && !res.rvMismatch && !res.dataMismatch );
+	memset( data, 0, sizeof(data) );
+	CHK( !SMB2API_InitPlayback( REC_FILE, &pb ) );
+	CHK( !SMB2API_MemRead( pb, 0, DEV_A, 0, 0x20, data, 100 ) );
+	CHK( !memcmp( data, rd, 100 ) );
+	SMB2API_Exit( &pb );
+	remove( REC_FILE );
+
+	/* absent device, invalid parameters */
+	CHK( SMB2API_MemWrite( smb, 0, 0x50, 0, 0, data, 4, 4, &errOff ) ==
+		 SMB_ERR_ADDR && errOff == 0 );
+	CHK( SMB2API_MemRead( smb, 0, DEV_A, 0, 0xf0, rd, 0x20 ) ==
+		 SMB_ERR_PARAM );
+	CHK( SMB2API_MemVerify( smb, 0, DEV_A, 0, 0, data, 4, 257, NULL ) ==
+		 SMB_ERR_PARAM );
+	CHK( SMB2API_MemWrite( smb, 0, DEV_A, 0, 0, data, 4, 0, NULL ) ==
+		 SMB_ERR_PARAM );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* RateThread ******************************/
+/** Thread: RATE_READS reads of byte data of TRX_THREAD
+ */
+static void* RateThread( void *arg )
+{
+	TRX_THREAD	*t = (TRX_THREAD*)arg;
+	u_int32		n;
+	u_int8		val;
+
+	for( n=0; (n < RATE_READS) && !t->rv; n++ )
+		t->rv = SMB2API_ReadByteData( t->smb, t->flags, t->addr, 0, &val );
+	return NULL;
+}
+
+/********************************* TestRate ********************************/
+/** Rate limits: burst, average rate, other devices served meanwhile,
+ *  deadline, removal
+ */
+static int32 TestRate( void )
+{
+	SMB2API_RATE_STATS	rs;
+	SMB2API_SIM_STATS	ss0, ss1;
+	TRX_THREAD			t;
+	pthread_t			tid;
+	void				*smb;
+	u_int32				n, t0, ms;
+	u_int8				val;
+	int32				fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	/* 100 per second, burst of 5: the burst passes without delay */
+	CHK( !SMB2API_RateSet( smb, DEV_A, 100, 5 ) );
+	for( n=0; n<5; n++ )
+		CHK( !SMB2API_ReadByteData( smb, 0, DEV_A, 0, &val ) );
+	CHK( !SMB2API_RateStatsGet( smb, &rs ) );
+	CHK( rs.deferred == 0 );
+
+	/* then one transaction per period */
+	t0 = UOS_MsecTimerGet();
+	for( n=0; n<RATE_READS; n++ )
+		CHK( !SMB2API_ReadByteData( smb, 0, DEV_A, 0, &val ) );
+	ms = UOS_MsecTimerGet() - t0;
+	CHK( ms >= RATE_READS * 10 - 10 && ms < RATE_READS * 10 * 3 );
+	CHK( !SMB2API_RateStatsGet( smb, &rs ) );
+	CHK( rs.deferred == RATE_READS && rs.waitUs > 0 );
+
+	/* other devices are served while the limited one waits */
+	memset( &t, 0, sizeof(t) );
+	t.smb = smb;
+	t.addr = DEV_A;
+	pthread_create( &tid, NULL, RateThread, &t );
+	UOS_Delay( 15 );
+	t0 = UOS_MsecTimerGet();
+	for( n=0; n<RATE_READS; n++ )
+		CHK( !SMB2API_ReadByteData( smb, 0, DEV_B, 0, &val ) );
+	CHK( UOS_MsecTimerGet() - t0 < RATE_READS * 10 / 2 );
+	pthread_join( tid, NULL );
+	CHK( !t.rv );
+	/* the first read of the thread may find a refilled token */
+	CHK( !SMB2API_RateStatsGet( smb, &rs ) );
+	CHK( rs.deferred >= 2 * RATE_READS - 1 && rs.deferred <= 2 * RATE_READS );
+
+	/* wait beyond the deadline: dropped without bus access */
+	CHK( !SMB2API_DeadlineSet( smb, 2 ) );
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( SMB2API_ReadByteData( smb, 0, DEV_A, 0, &val ) ==
+		 SMB2API_ERR_DEADLINE );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( ss1.trx == ss0.trx );
+	CHK( !SMB2API_DeadlineSet( smb, 0 ) );
+
+	/* limit removed */
+	CHK( !SMB2API_RateSet( smb, DEV_A, 0, 0 ) );
+	t0 = UOS_MsecTimerGet();
+	for( n=0; n<RATE_READS; n++ )
+		CHK( !SMB2API_ReadByteData( smb, 0, DEV_A, 0, &val ) );
+	CHK( UOS_MsecTimerGet() - t0 < RATE_READS * 10 / 2 );
+
+	/* invalid parameters */
+	CHK( SMB2API_RateSet( smb, 0x400, 100, 1 ) == SMB_ERR_PARAM );
+	CHK( SMB2API_RateSet( smb, DEV_A, 1000001, 1 ) == SMB_ERR_PARAM );
+	CHK( SMB2API_RateSet( NULL, DEV_A, 100, 1 ) == SMB_ERR_PARAM );
+	CHK( SMB2API_RateStatsGet( smb, NULL ) == SMB_ERR_PARAM );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
+
+/********************************* TestClone *******************************/
+/** Cloned handles: own arbitration, shared alerts and rate limits
+ */
+static int32 TestClone( void )
+{
+	SMB2API_RATE_STATS	rs;
+	SMB2API_PRIO_STATS	ps;
+	TB					tb;
+	TRX_THREAD			t;
+	pthread_t			tid;
+	void				*smb, *clone, *clone2, *arg;
+	volatile u_int32	called = 0;
+	u_int32				n, t0;
+	u_int8				val;
+	int32				fails = 0;
+
+	memset( &tb, 0, sizeof(tb) );
+	tb.slowAddr = 0x10;
+	tb.delayMs = 100;
+	if( TbOpen( &tb, &smb ) )
+		return 1;
+	CHK( !SMB2API_Clone( smb, &clone ) && clone && clone != smb );
+
+	/*
+	 * 0x10 holds the bus of the parent: the clone is not serialized
+	 * with it, a further access through the parent waits
+	 */
+	memset( &t, 0, sizeof(t) );
+	t.smb = smb;
+	t.addr = 0x10;
+	pthread_create( &tid, NULL, TrxThread, &t );
+	UOS_Delay( 20 );
+	t0 = UOS_MsecTimerGet();
+	CHK( !SMB2API_ReadByteData( clone, 0, 0x20, 0, &val ) );
+	CHK( UOS_MsecTimerGet() - t0 < 50 );
+	CHK( !SMB2API_ReadByteData( smb, 0, 0x30, 0, &val ) );
+	CHK( UOS_MsecTimerGet() - t0 >= 50 );
+	pthread_join( tid, NULL );
+	CHK( !t.rv );
+	CHK( tb.num == 3 );
+	CHK( tb.addr[0] == 0x20 && tb.addr[1] == 0x10 && tb.addr[2] == 0x30 );
+
+	/* clone of a clone, the parent is freed with the last clone */
+	CHK( !SMB2API_Clone( clone, &clone2 ) );
+	CHK( !SMB2API_Exit( &smb ) && !smb );
+	CHK( !SMB2API_ReadByteData( clone, 0, 0x20, 0, &val ) );
+	CHK( !SMB2API_Exit( &clone ) && !clone );
+	CHK( !SMB2API_ReadByteData( clone2, 0, 0x30, 0, &val ) );
+	CHK( !SMB2API_PrioStatsGet( clone2, SMB2API_PRIO_NORMAL, &ps ) );
+	CHK( ps.count == 5 );
+	CHK( !SMB2API_Exit( &clone2 ) && !clone2 );
+	CHK( tb.num == 5 );
+
+	if( SimOpen( &smb ) )
+		return fails + 1;
+	CHK( !SMB2API_Clone( smb, &clone ) );
+
+	/* alert installed through the clone, removed through the parent */
+	CHK( !SMB2API_AlertCbInstall( clone, DEV_A, CbCount, (void*)&called ) );
+	CHK( !SMB2API_SimAlert( smb, DEV_A ) );
+	for( n=0; (n < 100) && !called; n++ )
+		UOS_Delay( 1 );
+	CHK( called == 1 );
+	CHK( !SMB2API_AlertCbRemove( smb, DEV_A, &arg ) && arg == &called );
+
+	/* rate limit and statistics of the parent apply to the clone */
+	CHK( !SMB2API_RateSet( smb, DEV_B, 100, 1 ) );
+	for( n=0; n<2; n++ )
+		CHK( !SMB2API_ReadByteData( clone, 0, DEV_B, 0, &val ) );
+	CHK( !SMB2API_RateStatsGet( smb, &rs ) );
+	CHK( rs.deferred == 1 );
+	CHK( !SMB2API_RateSet( smb, DEV_B, 0, 0 ) );
+
+	/* concurrent workers with a clone each */
+	memset( &t, 0, sizeof(t) );
+	t.smb = clone;
+	t.addr = DEV_A;
+	pthread_create( &tid, NULL, RateThread, &t );
+	for( n=0; n<RATE_READS; n++ )
+		CHK( !SMB2API_ReadByteData( smb, 0, DEV_B, 0, &val ) );
+	pthread_join( tid, NULL );
+	CHK( !t.rv );
+
+	/* invalid parameters */
+	CHK( SMB2API_Clone( NULL, &clone2 ) == SMB_ERR_PARAM );
+	CHK( SMB2API_Clone( smb, NULL ) == SMB_ERR_PARAM );
+
+	/* parent exited first: alerts stay installed until the last clone */
+	CHK( !SMB2API_AlertCbInstall( clone, DEV_A, CbCount, (void*)&called ) );
+	CHK( !SMB2API_Exit( &smb ) );
+	CHK( !SMB2API_SimAlert( clone, DEV_A ) );
+	for( n=0; (n < 100) && (called < 2); n++ )
+		UOS_Delay( 1 );
+	CHK( called == 2 );
+	CHK( !SMB2API_ReadByteData( clone, 0, DEV_A, 0, &val ) );
+	CHK( !SMB2API_Exit( &clone ) );
+
+	return fails;
+}
+
+/********************************* TestXferV *******************************/
+/** Scatter-gather I2C messages: one transfer per pair, gather buffer
+ *  on the stack and on the heap
+ */
+static int32 TestXferV( void )
+{
+	SMB2API_SIM_STATS	ss0, ss1;
+	SMB2API_I2C_MSGV	msg[3];
+	SMB2API_I2C_VEC		wv[3], rv[2], bv[2];
+	void		*smb;
+	u_int8		ptr = 0x10, hdr[2] = { 0xa5, 0x5a }, data[8];
+	u_int8		rdHdr[2], rdData[8], big[300], page[256], rdPage[256];
+	u_int32		n, blocks0, blocks;
+	int32		fails = 0;
+
+	if( SimOpen( &smb ) )
+		return 1;
+
+	for( n=0; n<sizeof(data); n++ )
+		data[n] = (u_int8)(n + 1);
+
+	/* register pointer, header and data gathered into one message */
+	wv[0].buf = &ptr;
+	wv[0].len = 1;
+	wv[1].buf = hdr;
+	wv[1].len = sizeof(hdr);
+	wv[2].buf = data;
+	wv[2].len = sizeof(data);
+	msg[0].addr = DEV_A;
+	msg[0].flags = 0;
+	msg[0].vecNum = 3;
+	msg[0].vec = wv;
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( !SMB2API_I2CXferV( smb, msg, 1 ) );
+
+	/* pointer write and scattered read in one transfer */
+	memset( rdHdr, 0, sizeof(rdHdr) );
+	memset( rdData, 0, sizeof(rdData) );
+	msg[0].vecNum = 1;
+	rv[0].buf = rdHdr;
+	rv[0].len = sizeof(rdHdr);
+	rv[1].buf = rdData;
+	rv[1].len = sizeof(rdData);
+	msg[1].addr = DEV_A;
+	msg[1].flags = I2C_M_RD;
+	msg[1].vecNum = 2;
+	msg[1].vec = rv;
+	CHK( !SMB2API_I2CXferV( smb, msg, 2 ) );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( ss1.trx == ss0.trx + 2 );
+	CHK( !memcmp( rdHdr, hdr, sizeof(hdr) ) );
+	CHK( !memcmp( rdData, data, sizeof(data) ) );
+
+	/* three messages: two transfers, the bus is owned for both */
+	memset( rdHdr, 0, sizeof(rdHdr) );
+	memset( rdData, 0, sizeof(rdData) );
+	msg[1].vecNum = 1;
+	msg[2].addr = DEV_A;
+	msg[2].flags = I2C_M_RD;
+	msg[2].vecNum = 1;
+	msg[2].vec = &rv[1];
+	SMB2API_SimStatsGet( smb, &ss0 );
+	CHK( !SMB2API_I2CXferV( smb, msg, 3 ) );
+	SMB2API_SimStatsGet( smb, &ss1 );
+	CHK( ss1.trx == ss0.trx + 2 );
+	CHK( !memcmp( rdHdr, hdr, sizeof(hdr) ) );
+	CHK( !memcmp( rdData, data, sizeof(data) ) );
+
+	/* a single buffer is not gathered: no size limit */
+	bv[0].buf = big;
+	bv[0].len = sizeof(big);
+	msg[1].vecNum = 1;
+	msg[1].vec = bv;
+	CHK( !SMB2API_I2CXferV( smb, msg, 2 ) );
+
+	/* pointer and 256 byte page: gathered beyond the stack buffer */
+	for( n=0; n<sizeof(page); n++ )
+		page[n] = (u_int8)(n ^ 0x5a);
+	ptr = 0;
+	wv[1].buf = page;
+	wv[1].len = sizeof(page);
+	msg[0].vecNum = 2;
+	SMB2API_MemStatsGet( &blocks0 );
+	CHK( !SMB2API_I2CXferV( smb, msg, 1 ) );
+	SMB2API_MemStatsGet( &blocks );
+	CHK( blocks == blocks0 );
+
+	/* read back scattered, three messages with gathered data each */
+	memset( rdPage, 0, sizeof(rdPage) );
+	bv[0].buf = rdPage;
+	bv[0].len = 100;
+	bv[1].buf = rdPage + 100;
+	bv[1].len = 100;
+	msg[0].vecNum = 1;
+	msg[1].vecNum = 2;
+	msg[1].vec = bv;
+	rv[0].buf = rdPage + 200;
+	rv[0].len = 6;
+	rv[1].buf = rdPage + 206;
+	rv[1].len = 50;
+	msg[2].vecNum = 2;
+	msg[2].vec = rv;
+	CHK( !SMB2API_I2CXferV( smb, msg, 3 ) );
+	CHK( !memcmp( rdPage, page, sizeof(page) ) );
+
+	/* invalid parameters */
+	CHK( !SMB2API_I2CXferV( smb, NULL, 0 ) );
+	CHK( SMB2API_I2CXferV( NULL, msg, 1 ) == SMB_ERR_PARAM );
+	CHK( SMB2API_I2CXferV( smb, NULL, 1 ) == SMB_ERR_PARAM );
+	msg[0].vec = NULL;
+	CHK( SMB2API_I2CXferV( smb, msg, 1 ) == SMB_ERR_PARAM );
+
+	SMB2API_Exit( &smb );
+	return fails;
+}
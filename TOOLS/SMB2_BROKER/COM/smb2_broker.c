@@ -0,0 +1,101 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  smb2_broker.c
+ *
+ *  	 \brief  SMBus broker daemon of the SMB2_API
+ *
+ *               Owns an SMB2 device and serves the processes that open it
+ *               with SMB2API_InitBroker() over a Unix domain socket (see
+ *               SMB2API_BrokerServe). Terminates on SIGINT or SIGTERM and
+ *               removes the socket.
+ *
+ *               Usage: smb2_broker [-s] <device> <socket>
+ *               -s          serve a simulated SMBus (SMB2API_InitSim),
+ *                           <device> is ignored
+ *               <device>    SMB2 device, e.g. smb2_1
+ *               <socket>    path of the Unix domain socket to create
+ *
+ *     Required: libraries: smb2_api, mdis_api, usr_oss, pthread
+ *     Switches: -
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_err.h>
+#include <MEN/smb2_api.h>
+#include "../../../smb2_api_ext.h"
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static void SigHandler( int sig );
+
+/*-----------------------------------------+
+|  GLOBALS                                 |
++-----------------------------------------*/
+static volatile u_int32 G_stop;		/* set by SIGINT/SIGTERM */
+
+/********************************* main ************************************/
+/** Program main function
+ *
+ *  \param argc       \IN  argument counter
+ *  \param argv       \IN  argument vector
+ *
+ *  \return	          success (0) or error (1)
+ */
+int main( int argc, char *argv[] )
+{
+	char	errBuf[512];
+	void	*smb;
+	int32	a = 1, sim = 0, rv;
+
+	if( (argc > 1) && !strcmp( argv[1], "-s" ) ){
+		sim = 1;
+		a++;
+	}
+
+	if( argc - a != 2 ){
+		printf( "usage: smb2_broker [-s] <device> <socket>\n" );
+		return 1;
+	}
+
+	if( sim )
+		rv = SMB2API_InitSim( 0, &smb );
+	else
+		rv = SMB2API_Init( argv[a], &smb );
+
+	if( rv ){
+		printf( "*** can't open %s: %s\n", sim ? "simulated SMBus" : argv[a],
+				SMB2API_Errstring( rv, errBuf ) );
+		return 1;
+	}
+
+	signal( SIGINT, SigHandler );
+	signal( SIGTERM, SigHandler );
+
+	/* returns within 100ms after a signal */
+	if( (rv = SMB2API_BrokerServe( smb, argv[a + 1], &G_stop )) )
+		printf( "*** can't serve %s: %s\n", argv[a + 1],
+				SMB2API_Errstring( rv, errBuf ) );
+
+	if( SMB2API_Exit( &smb ) )
+		rv = 1;
+
+	return rv ? 1 : 0;
+}
+
+/****************************** SigHandler *********************************/
+/** Request termination of the broker
+ *
+ *  \param sig        \IN  received signal
+ */
+static void SigHandler( int sig )
+{
+	G_stop = 1;
+}
@@ -0,0 +1,402 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  smb2_stress.c
+ *
+ *  	 \brief  Multithreaded stress and scaling harness of the SMB2_API
+ *
+ *               Runs rounds with 1, 4, 16 and 64 threads against a fresh
+ *               simulated SMBus (SMB2API_InitSim). The worker threads
+ *               write and read back registers of their own device, while
+ *               another thread raises alerts (real signals, see
+ *               SMB2API_SimAlert) and a third one installs and removes
+ *               alert callbacks.
+ *
+ *               Each round reports the throughput, the scaling relative
+ *               to one thread and the latency distribution, and checks:
+ *               - no data errors
+ *               - each raised alert invoked its callback exactly once
+ *               - no library memory left after SMB2API_Exit
+ *
+ *               Usage: smb2_stress [-n=<ops>] [-c=<busClk>] [-k]
+ *               -n=<ops>     transactions per thread (default 20000)
+ *               -c=<busClk>  simulated bus clock [Hz] (default 0: no bus
+ *                            time)
+ *               -k           worker threads use cloned handles
+ *
+ *     Required: libraries: smb2_api, mdis_api, usr_oss, pthread
+ *     Switches: -
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <time.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_err.h>
+#include <MEN/usr_oss.h>
+#include <MEN/smb2_api.h>
+#include "../../../smb2_api_ext.h"
+
+/*-----------------------------------------+
+|  DEFINES                                 |
++-----------------------------------------*/
+#define THREADS_MAX		64		/* threads of the last round */
+#define DEV_FIRST		0x20	/* device of worker n: DEV_FIRST + 2n */
+#define ALERT_DEV		0xb0	/* alerting device */
+#define CHURN_DEV		0xc0	/* devices of the install/remove thread */
+#define CHURN_NUM		4
+#define HIST_NUM		24		/* latency buckets, n: < 2^n us */
+#define SETTLE_MS		1000	/* max. wait for outstanding callbacks */
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/** worker thread */
+typedef struct
+{
+	void		*smb;				/**< SMB handle (or clone) */
+	u_int16		addr;				/**< own device */
+	u_int32		ops;				/**< transactions to execute */
+	u_int32		errors;				/**< failed or wrong transactions */
+	u_int32		maxUs;				/**< max. latency [us] */
+	u_int32		hist[HIST_NUM];		/**< latency histogram */
+}WORKER;
+
+/** round with n threads */
+typedef struct
+{
+	void				*smb;		/**< simulated SMBus */
+	volatile u_int32	stop;		/**< stop alert/churn threads */
+	volatile u_int32	raised;		/**< raised alerts */
+	volatile u_int32	called;		/**< invoked alert callbacks */
+	u_int32				churns;		/**< install/remove cycles */
+	u_int32				errors;		/**< alert/churn errors */
+	WORKER				w[THREADS_MAX];
+}ROUND;
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static int32 Round( u_int32 threads, u_int32 ops, u_int32 busClk,
+					u_int32 clone, double *opsPerSecP, double opsPerSec1 );
+static void* WorkerThread( void *arg );
+static void* AlertThread( void *arg );
+static void* ChurnThread( void *arg );
+static void AlertCb( void *cbArg );
+static void ChurnCb( void *cbArg );
+static u_int32 UsecGet( void );
+static u_int32 HistPercentile( const u_int32 *hist, u_int32 permille );
+
+/********************************* main ************************************/
+/** Program main function
+ *
+ *  \param argc       \IN  argument counter
+ *  \param argv       \IN  argument vector
+ *
+ *  \return	          success (0) or error (1)
+ */
+int main( int argc, char *argv[] )
+{
+	static const u_int32 threads[] = { 1, 4, 16, THREADS_MAX };
+	u_int32	ops = 20000, busClk = 0, clone = 0, n;
+	int32	a, fails = 0;
+	double	opsPerSec, opsPerSec1 = 0;
+
+	for( a=1; a<argc; a++ ){
+		if( !strncmp( argv[a], "-n=", 3 ) )
+			ops = (u_int32)strtoul( argv[a] + 3, NULL, 0 );
+		else if( !strncmp( argv[a], "-c=", 3 ) )
+			busClk = (u_int32)strtoul( argv[a] + 3, NULL, 0 );
+		else if( !strcmp( argv[a], "-k" ) )
+			clone = 1;
+		else {
+			printf( "usage: smb2_stress [-n=<ops>] [-c=<busClk>] [-k]\n" );
+			return 1;
+		}
+	}
+
+	printf( "ops/thread=%u busClk=%u%s\n\n", ops, busClk,
+			clone ? " (cloned handles)" : "" );
+	printf( "threads     ops/s  scaling  p50[us]  p99[us] p999[us]  "
+			"max[us]  alerts  result\n" );
+
+	for( n=0; n<sizeof(threads)/sizeof(u_int32); n++ ){
+		fails += Round( threads[n], ops, busClk, clone, &opsPerSec,
+						opsPerSec1 );
+		if( n == 0 )
+			opsPerSec1 = opsPerSec;
+	}
+
+	printf( "\n%s\n", fails ? "FAILED" : "all rounds passed" );
+	return fails ? 1 : 0;
+}
+
+/********************************* Round ***********************************/
+/** Run one round with \a threads worker threads
+ *
+ *  \return number of failed checks
+ */
+static int32 Round(
+	u_int32	threads,
+	u_int32	ops,
+	u_int32	busClk,
+	u_int32	clone,
+	double	*opsPerSecP,
+	double	opsPerSec1 )
+{
+	static ROUND		r;
+	pthread_t			tid[THREADS_MAX], alertTid, churnTid;
+	SMB2API_ALERT_STATS	as0, as1;
+	SMB2API_SIM_STATS	ss;
+	u_int32				blocks0, blocks, n, b, t0, us, maxUs = 0;
+	u_int32				hist[HIST_NUM], errors = 0;
+	int32				fails = 0;
+	void				*arg;
+
+	memset( &r, 0, sizeof(r) );
+	memset( hist, 0, sizeof(hist) );
+	SMB2API_MemStatsGet( &blocks0 );
+	SMB2API_AlertStatsGet( &as0 );
+
+	if( SMB2API_InitSim( busClk, &r.smb ) )
+		return 1;
+
+	for( n=0; n<threads; n++ ){
+		r.w[n].addr = (u_int16)(DEV_FIRST + 2 * n);
+		r.w[n].ops = ops;
+		r.w[n].smb = r.smb;
+		SMB2API_SimDevSet( r.smb, r.w[n].addr, 1, NULL );
+		if( clone && SMB2API_Clone( r.smb, &r.w[n].smb ) )
+			fails++;
+	}
+	SMB2API_SimDevSet( r.smb, ALERT_DEV, 1, NULL );
+	for( n=0; n<CHURN_NUM; n++ )
+		SMB2API_SimDevSet( r.smb, (u_int16)(CHURN_DEV + 2 * n), 1, NULL );
+
+	/* installed first: invoked for the signal shared with the churn */
+	if( SMB2API_AlertCbInstallSig( r.smb, ALERT_DEV, AlertCb, &r,
+								   UOS_SIG_USR1 ) ){
+		SMB2API_Exit( &r.smb );
+		return 1;
+	}
+
+	pthread_create( &alertTid, NULL, AlertThread, &r );
+	pthread_create( &churnTid, NULL, ChurnThread, &r );
+
+	t0 = UsecGet();
+	for( n=0; n<threads; n++ )
+		pthread_create( &tid[n], NULL, WorkerThread, &r.w[n] );
+	for( n=0; n<threads; n++ )
+		pthread_join( tid[n], NULL );
+	us = UsecGet() - t0;
+
+	r.stop = 1;
+	pthread_join( alertTid, NULL );
+	pthread_join( churnTid, NULL );
+
+	/* callbacks of the last alerts */
+	for( n=0; (r.called != r.raised) && (n < SETTLE_MS); n++ )
+		UOS_Delay( 1 );
+
+	SMB2API_SimStatsGet( r.smb, &ss );
+	SMB2API_AlertCbRemove( r.smb, ALERT_DEV, &arg );
+
+	for( n=0; n<threads; n++ ){
+		if( clone )
+			SMB2API_Exit( &r.w[n].smb );
+		errors += r.w[n].errors;
+		if( r.w[n].maxUs > maxUs )
+			maxUs = r.w[n].maxUs;
+		for( b=0; b<HIST_NUM; b++ )
+			hist[b] += r.w[n].hist[b];
+	}
+	SMB2API_Exit( &r.smb );
+
+	SMB2API_MemStatsGet( &blocks );
+	SMB2API_AlertStatsGet( &as1 );
+
+	*opsPerSecP = (double)threads * ops * 1000000.0 / (us ? us : 1);
+
+	printf( "%7u %9.0f %7.2fx %8u %8u %8u %8u %7u  ",
+			threads, *opsPerSecP,
+			opsPerSec1 ? *opsPerSecP / opsPerSec1 : 1.0,
+			HistPercentile( hist, 500 ), HistPercentile( hist, 990 ),
+			HistPercentile( hist, 999 ), maxUs, r.raised );
+
+	/* checks */
+	if( errors || r.errors ){
+		printf( "%u data errors, %u alert errors ", errors, r.errors );
+		fails++;
+	}
+	if( (r.called != r.raised) || (ss.signals != r.raised) ){
+		printf( "%u callbacks for %u alerts (%u signals) ",
+				r.called, r.raised, ss.signals );
+		fails++;
+	}
+	if( as1.lost != as0.lost ){
+		printf( "%u lost signals ", as1.lost - as0.lost );
+		fails++;
+	}
+	if( blocks != blocks0 ){
+		printf( "%u memory blocks left ", blocks - blocks0 );
+		fails++;
+	}
+	printf( "%s\n", fails ? "FAILED" : "ok" );
+
+	return fails;
+}
+
+/********************************* WorkerThread ****************************/
+/** Write and read back registers of the own device
+ */
+static void* WorkerThread( void *arg )
+{
+	WORKER	*w = (WORKER*)arg;
+	u_int32	n, b, t0, us;
+	u_int16	word;
+	u_int8	val, reg;
+	int32	rv;
+
+	for( n=0; n<w->ops; n++ ){
+		reg = (u_int8)(n & 0xfe);
+		t0 = UsecGet();
+
+		switch( n & 3 ){
+		case 0:
+			rv = SMB2API_WriteByteData( w->smb, 0, w->addr, reg, (u_int8)n );
+			break;
+		case 1:
+			rv = SMB2API_ReadByteData( w->smb, 0, w->addr, reg, &val );
+			if( !rv && (val != (u_int8)(n - 1)) )
+				w->errors++;
+			break;
+		case 2:
+			rv = SMB2API_WriteWordData( w->smb, 0, w->addr, reg,
+										(u_int16)(n * 257) );
+			break;
+		default:
+			rv = SMB2API_ReadWordData( w->smb, 0, w->addr, reg, &word );
+			if( !rv && (word != (u_int16)((n - 1) * 257)) )
+				w->errors++;
+		}
+
+		us = UsecGet() - t0;
+		if( rv )
+			w->errors++;
+		if( us > w->maxUs )
+			w->maxUs = us;
+		for( b=0; (us >> b) && (b < HIST_NUM-1); b++ )
+			;
+		w->hist[b]++;
+	}
+
+	return NULL;
+}
+
+/********************************* AlertThread *****************************/
+/** Raise alerts until the workers are done
+ *
+ *  Pending signals of the same number are not queued: the next alert is
+ *  raised after the callback of the previous one was invoked.
+ */
+static void* AlertThread( void *arg )
+{
+	ROUND	*r = (ROUND*)arg;
+	u_int32	n;
+	u_int8	araData;
+
+	while( !r->stop ){
+		for( n=0; (r->called != r->raised) && (n < SETTLE_MS); n++ )
+			UOS_Delay( 1 );
+
+		if( SMB2API_SimAlert( r->smb, ALERT_DEV ) ){
+			r->errors++;
+			break;
+		}
+		r->raised++;
+
+		/* release SMBALERT# of the device */
+		SMB2API_ReadByte( r->smb, 0, 0x18, &araData );
+		UOS_Delay( 1 );
+	}
+
+	return NULL;
+}
+
+/********************************* ChurnThread *****************************/
+/** Install and remove alert callbacks on the shared signal
+ */
+static void* ChurnThread( void *arg )
+{
+	ROUND	*r = (ROUND*)arg;
+	u_int16	addr;
+	void	*cbArg;
+
+	while( !r->stop ){
+		addr = (u_int16)(CHURN_DEV + 2 * (r->churns % CHURN_NUM));
+
+		if( SMB2API_AlertCbInstallSig( r->smb, addr, ChurnCb, r,
+									   UOS_SIG_USR1 ) ||
+			SMB2API_AlertCbRemove( r->smb, addr, &cbArg ) ||
+			(cbArg != (void*)r) )
+			r->errors++;
+		r->churns++;
+	}
+
+	return NULL;
+}
+
+/********************************* AlertCb *********************************/
+/** Alert callback: count
+ */
+static void AlertCb( void *cbArg )
+{
+	ROUND *r = (ROUND*)cbArg;
+
+	r->called++;
+}
+
+/********************************* ChurnCb *********************************/
+/** Alert callback of the churn: must not be called
+ */
+static void ChurnCb( void *cbArg )
+{
+	ROUND *r = (ROUND*)cbArg;
+
+	r->errors++;
+}
+
+/********************************* UsecGet *********************************/
+/** Monotonic time [us]
+ */
+static u_int32 UsecGet( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (u_int32)ts.tv_sec * 1000000 + (u_int32)(ts.tv_nsec / 1000);
+}
+
+/********************************* HistPercentile **************************/
+/** Latency percentile from histogram (upper bound of the bucket) [us]
+ */
+static u_int32 HistPercentile( const u_int32 *hist, u_int32 permille )
+{
+	u_int32	b, total = 0, sum = 0;
+
+	for( b=0; b<HIST_NUM; b++ )
+		total += hist[b];
+
+	for( b=0; b<HIST_NUM; b++ ){
+		sum += hist[b];
+		if( (u_int64)sum * 1000 >= (u_int64)total * permille )
+			break;
+	}
+
+	return (u_int32)1 << (b < HIST_NUM ? b : HIST_NUM - 1);
+}
@@ -37,8 +37,16 @@ MAK_INCL=$(MEN_INC_DIR)/men_typs.h    	\
 		 $(MEN_INC_DIR)/smb2_api.h		\
 		 $(MEN_INC_DIR)/smb2_drv.h		\
 		 $(MEN_INC_DIR)/smb2.h	\
+		 $(MEN_MOD_DIR)/smb2_api_ext.h	\
+		 $(MEN_MOD_DIR)/smb2_api_int.h	\
+		 $(MEN_MOD_DIR)/smb2_pmbus.h	\
+		 $(MEN_MOD_DIR)/smb2_shm.h	\
 
 MAK_INP1 = smb2_api$(INP_SUFFIX)
+MAK_INP2 = smb2_pmbus$(INP_SUFFIX)
+MAK_INP3 = smb2_shm$(INP_SUFFIX)
 
-MAK_INP  = $(MAK_INP1)
+MAK_INP  = $(MAK_INP1) \
+		   $(MAK_INP2) \
+		   $(MAK_INP3)
 
@@ -8,7 +8,10 @@
  *
  *  	 \brief  API functions to access the SMB2 MDIS driver
  *
- *     Switches: -
+ *     Switches: SMB2API_NO_THREADS - no thread synchronisation
+ *               (single threaded applications only)
+ *               SMB2API_NO_USDT - no static tracepoints (USDT probes
+ *               are built on Linux if <sys/sdt.h> is available)
  */
 /*-------------------------------[ History ]---------------------------------
  *
@@ -54,6 +57,35 @@
 #include <string.h>
 #include <stdlib.h>
 
+#if !defined(SMB2API_NO_THREADS)
+#	if defined(WINNT)
+#		include <windows.h>
+#	else
+#		include <pthread.h>
+#		include <semaphore.h>
+#		include <time.h>
+#		include <errno.h>
+#	endif
+#endif
+
+#if !defined(WINNT)
+#	include <sys/socket.h>
+#	include <sys/stat.h>
+#	include <sys/un.h>
+#	include <poll.h>
+#	include <unistd.h>
+#	include <signal.h>
+#	include <errno.h>
+#endif
+
+/* static tracepoints (see TRC4/TRC5) */
+#if !defined(SMB2API_NO_USDT) && defined(__linux__) && defined(__has_include)
+#	if __has_include(<sys/sdt.h>)
+#		include <sys/sdt.h>
+#		define SMB2API_USDT
+#	endif
+#endif
+
 #include <MEN/men_typs.h>
 #include <MEN/mdis_err.h>
 #include <MEN/mdis_api.h>
@@ -62,33 +94,60 @@
 #define SMB2_API_COMPILE
 #include <MEN/smb2_api.h>
 #include <MEN/smb2_drv.h>
+#include "smb2_api_ext.h"
+#include "smb2_api_int.h"
 
 /*-----------------------------------------+
 |  DEFINES                                 |
 +-----------------------------------------*/
+/*
+ * USDT probes of provider smb2api (a NOP when not traced):
+ * - api__entry/api__return: SMB2 library functions, once per call
+ *   (function name, handle, 0, 0 resp. return value)
+ * - trx__entry/trx__return: transaction incl. arbitration
+ * - drv__entry/drv__return: driver (or backend) call
+ */
+#if defined(SMB2API_USDT)
+#	define TRC4( n, a, b, c, d )	DTRACE_PROBE4( smb2api, n, a, b, c, d )
+#	define TRC5( n, a, b, c, d, e )	DTRACE_PROBE5( smb2api, n, a, b, c, d, e )
+#else
+#	define TRC4( n, a, b, c, d )
+#	define TRC5( n, a, b, c, d, e )
+#endif
+
 #define DO_BLK_SETSTAT( obj, code ) \
-{\
-	M_SG_BLOCK blk;\
-	blk.size = sizeof(obj);\
-	blk.data = (void *)&obj;\
-	rv = M_setstat( ((SMB_HANDLE*)smbHdl)->path, code, (INT32_OR_64)&blk );\
-	if( rv )\
-		rv = UOS_ErrnoGet();\
-}
+	rv = BlkStat( (SMB_HANDLE*)smbHdl, code, 0, (void*)&obj, sizeof(obj) )
 
 #define DO_BLK_GETSTAT( obj, code ) \
-{\
-	M_SG_BLOCK blk;\
-	blk.size = sizeof(obj);\
-	blk.data = (void *)&obj;\
-	rv = M_getstat( ((SMB_HANDLE*)smbHdl)->path, code, (int32 *)&blk );\
-	if( rv )\
-		rv = UOS_ErrnoGet();\
-}
+	rv = BlkStat( (SMB_HANDLE*)smbHdl, code, 1, (void*)&obj, sizeof(obj) )
+
+/*
+ * probes of the library functions (hdl: first handle argument), once
+ * per call, also on early return
+ */
+#define API_ENTRY( hdl ) \
+	TRC4( api__entry, __func__, hdl, 0, 0 )
+
+#define API_RETURN( hdl, rv ) \
+	do { \
+		int32 _apiRv = (rv); \
+		TRC4( api__return, __func__, hdl, 0, _apiRv ); \
+		return _apiRv; \
+	} while(0)
 
 #define SIG_FREE	0
 #define SIG_USED	1
 
+/* data mapping of an SMBus access (see OP_DESC) */
+#define OP_DATA_NONE	0	/**< no data (quick command) */
+#define OP_DATA_BYTE	1	/**< SMB2_TRANSFER.u.byteData */
+#define OP_DATA_WORD	2	/**< SMB2_TRANSFER.u.wordData */
+#define OP_DATA_BLOCK	3	/**< SMB2_TRANSFER_BLOCK */
+
+/* data direction of an SMBus access (see OP_DESC) */
+#define OP_DIR_IN		0x01	/**< data passed to the device */
+#define OP_DIR_OUT		0x02	/**< data returned from the device */
+
 /* MDIS implementations should define at least UOS_SIG_USR1 and UOS_SIG_USR2 */
 #if defined (UOS_SIG_USR1) && (UOS_SIG_USR2)
 #	define LAST_SIG UOS_SIG_USR2
@@ -108,6 +167,104 @@
 #	define LAST_SIG UOS_SIG_MAX
 #endif
 
+/* thread local storage */
+#if defined(SMB2API_NO_THREADS)
+#	define TLS_VAR
+#elif defined(_MSC_VER)
+#	define TLS_VAR	__declspec(thread)
+#else
+#	define TLS_VAR	__thread
+#endif
+
+/* atomic counters (updated from signal handlers), ATOMIC_DEC returns the
+   new value */
+#if defined(SMB2API_NO_THREADS)
+#	define ATOMIC_ADD( v, n )	((v) += (n))
+#	define ATOMIC_OR( v, n )	((v) |= (n))
+#	define ATOMIC_DEC( v )		(--(v))
+#elif defined(WINNT)
+#	define ATOMIC_ADD( v, n )	InterlockedExchangeAdd( (LONG volatile*)&(v), (n) )
+#	define ATOMIC_OR( v, n )	InterlockedOr( (LONG volatile*)&(v), (n) )
+#	define ATOMIC_DEC( v )		InterlockedDecrement( (LONG volatile*)&(v) )
+#else
+#	define ATOMIC_ADD( v, n )	__sync_fetch_and_add( &(v), (n) )
+#	define ATOMIC_OR( v, n )	__sync_fetch_and_or( &(v), (n) )
+#	define ATOMIC_DEC( v )		__sync_sub_and_fetch( &(v), 1 )
+#endif
+
+/* alerts */
+#define ARA_ADDR		0x18	/* SMBus alert response address */
+#define ALERT_ADDR_NUM	0x400	/* 10-bit addresses */
+#define ALERT_DRAIN_DEF	16		/* default max. ARA reads per wakeup */
+#define ALERT_IDLE_US	1000000	/* engine wakeup without alerts [us] */
+#define ALERT_POLL_MIN_DEF	1	/* default poll interval while alerting [ms] */
+#define ALERT_POLL_MAX_DEF	100	/* default poll interval while idle [ms] */
+
+/* presence of devices (see PresUpdate) */
+#define PRES_ADDR_NUM	0x400	/* 10-bit addresses */
+
+/* per device rate limits (see RateWait) */
+#define RATE_ADDR_NUM	0x400	/* 10-bit addresses */
+
+/* capabilities and routing (see CapStat) */
+#define CAP_OP_NUM		(SMB2_BLK_PROCESS_CALL - SMB2_BLK_QUICK_COMM + 1)
+#define CAP_BLK_PROC	CAP_OP_NUM	/* block process call (same code as
+									   the block read) */
+#define CAP_NUM			(CAP_OP_NUM + 1)
+#define CAP_EXPLORE		64		/* transactions until the slower path
+								   is measured again */
+#define CAP_AVG_SHIFT	3		/* moving average over 2^n transactions */
+
+/* register snapshots (see SMB2API_SnapRestore) */
+#define SNAP_GAP_MAX	2		/* equal registers merged into a write */
+
+/* I2C memories (see SMB2API_MemWrite) */
+#define MEM_SEQ_MAX		256		/* max. data bytes per I2C message */
+#define MEM_WRITE_TMO_US 20000	/* max. write cycle time [us] */
+
+/* scatter-gather I2C messages (see SMB2API_I2CXferV) */
+#define XFERV_STACK_MAX	256		/* gather buffer on the stack [bytes],
+								   per message pair */
+
+/* CRC-32 (IEEE 802.3, reflected) */
+#define CRC_POLY		0xedb88320
+
+/* simulated SMBus (see SMB2API_InitSim) */
+#define SIM_DEV_NUM		0x100	/* devices (8-bit addresses) */
+#define SIM_REG_NUM		0x100	/* registers per device */
+
+
+/* number of buckets of the latency histogram */
+#define LAT_HIST_NUM	SMB2API_LAT_HIST_NUM
+
+/* record files (see RecWrite for the format) */
+#define REC_MAGIC		"SMB2REC"	/* incl. '\0' */
+#define REC_MAGIC_LEN	8
+#define REC_VERSION		2
+#define REC_HDR_LEN		25			/* record header length */
+#define REC_I2C_MAX		0x10000		/* I2C data of one object */
+#define REC_OBJ_MAX		(2 + 8*I2C_XFER_MSG_MAX + REC_I2C_MAX)
+									/* max. encoded object length */
+
+/* I2C messages of one SMB2_BLK_I2C_XFER built by the library */
+#define I2C_XFER_MSG_MAX	2
+
+/* broker (see SMB2API_BrokerServe) */
+#define BROKER_CLI_MAX	64			/* max. clients */
+#define BROKER_REQ_HDR	10			/* len(4) code(4) isGet(1) prio(1) */
+#define BROKER_RSP_HDR	8			/* len(4) rv(4) */
+#define BROKER_MSG_MAX	(BROKER_REQ_HDR + REC_OBJ_MAX)	/* max. message */
+#define BROKER_POLL_MS	100			/* check of stop flag [ms] */
+#if !defined(MSG_NOSIGNAL)
+#	define MSG_NOSIGNAL	0
+#endif
+
+/* bus utilization monitor */
+#define UTIL_BUSCLK_DEF	100000	/* default bus clock [Hz] */
+#define UTIL_WIN_US		10000	/* averaging window [us] */
+#define UTIL_AVG_SHIFT	4		/* moving average over 2^n windows */
+#define UTIL_GAP_MAX	64		/* idle windows until average is zero */
+
 #define FIRST_SIG	UOS_SIG_USR1
 #define NBR_OF_SIG	(LAST_SIG - FIRST_SIG)
 
@@ -127,22 +284,275 @@ typedef struct
 	u_int8		condition;	/**< signal condition (see SIG_XXX above) */
 }SIGNAL;
 
-/** Local structure for SMB_HANDLE */
+/* OS specific synchronisation objects and threads */
+#if defined(SMB2API_NO_THREADS)
+typedef int					MTX;
+typedef int					COND;
+typedef int					SEM;
+typedef int					THREAD;
+typedef void* (*THREAD_FUNC)( void *arg );
+#	define THREAD_RET		void*
+#elif defined(WINNT)
+typedef CRITICAL_SECTION	MTX;
+typedef CONDITION_VARIABLE	COND;
+typedef HANDLE				SEM;
+typedef HANDLE				THREAD;
+typedef DWORD (WINAPI *THREAD_FUNC)( void *arg );
+#	define THREAD_RET		DWORD WINAPI
+#else
+typedef pthread_mutex_t		MTX;
+typedef pthread_cond_t		COND;
+typedef sem_t				SEM;
+typedef pthread_t			THREAD;
+typedef void* (*THREAD_FUNC)( void *arg );
+#	define THREAD_RET		void*
+#endif
+
+/** Latency statistics of one priority class */
+typedef struct
+{
+	u_int32		count;			/**< number of transactions */
+	u_int64		sumUs;			/**< sum of latencies [us] */
+	u_int32		maxUs;			/**< maximum latency [us] */
+	u_int64		sumWaitUs;		/**< sum of bus wait times [us] */
+	u_int32		maxWaitUs;		/**< maximum bus wait time [us] */
+	u_int32		hist[LAT_HIST_NUM];	/**< latency histogram */
+}PRIO_STATS;
+
+/** Bus utilization monitor (averages are scaled by 256) */
 typedef struct
+{
+	u_int32		busClk;			/**< bus clock [Hz] */
+	u_int32		target;			/**< throttle #SMB2API_PRIO_LOW above
+									 this utilization [permille] (0=off) */
+	u_int32		winStart;		/**< start of current window [us] */
+	u_int32		winBusyUs;		/**< estimated bus time in window [us] */
+	u_int32		winBytes;		/**< bytes transferred in window */
+	u_int32		winTrx;			/**< transactions in window */
+	u_int32		avgUtil;		/**< moving average [permille] */
+	u_int32		avgBytes;		/**< moving average [bytes/s] */
+	u_int32		avgTrx;			/**< moving average [transactions/s] */
+	u_int32		throttled;		/**< throttle delays */
+}UTIL;
+
+/** Bus arbiter: serializes the transactions of an SMB handle by priority */
+typedef struct
+{
+	MTX			mtx;						/**< protects the arbiter */
+	COND		cond[SMB2API_PRIO_NUM];		/**< wakeup per class */
+	u_int32		busy;						/**< bus owned by a transaction */
+	u_int32		waiting[SMB2API_PRIO_NUM];	/**< waiting transactions */
+	PRIO_STATS	stats[SMB2API_PRIO_NUM];	/**< statistics per class */
+	u_int32		dlDropped;					/**< dropped (deadline passed) */
+	u_int32		dlOverrun;					/**< in-flight deadline overruns */
+	UTIL		util;						/**< bus utilization */
+}ARBITER;
+
+/** Transaction recorder */
+typedef struct
+{
+	FILE		*fp;				/**< record file */
+	u_int32		tStart;				/**< start of recording [us] */
+	u_int8		buf[REC_HDR_LEN + 2*REC_OBJ_MAX];	/**< record buffer */
+}RECORDER;
+
+/** Presence of a device (see PresUpdate) */
+typedef struct
+{
+	int32		err;		/**< error of last access if absent, else 0 */
+	u_int32		t;			/**< time device found absent [us] */
+}PRES;
+
+/** Capabilities of an operation (SMB2_BLK_XXX code) */
+typedef struct
+{
+	u_int8		native;		/**< native support (SMB2API_CAP_XXX) */
+	u_int8		emul;		/**< I2C emulation support (SMB2API_CAP_XXX) */
+	u_int32		nativeUs;	/**< avg. time of native operation [us] */
+	u_int32		emulUs;		/**< avg. time of emulation [us] */
+	u_int32		emulCnt;	/**< operations executed by emulation */
+	u_int32		count;		/**< operations since slower path measured */
+}CAP;
+
+/** Rate limit of a device (token bucket as virtual scheduling time) */
+typedef struct
+{
+	u_int32		periodUs;	/**< time per token [us] (0=no limit) */
+	u_int32		burstUs;	/**< (burst - 1) * periodUs */
+	u_int32		tat;		/**< theoretical arrival time of the next
+								 transaction [us] */
+}RATE;
+
+struct ALERT_ENG;
+
+/** Local structure for SMB_HANDLE */
+typedef struct SMB_HANDLE
 {
 	SMB_ENTRIES entries; 	/**< function entries */
 	MDIS_PATH	path;		/**< path returned from M_open */
 	SIGNAL		signal[NBR_OF_SIG];	/**< signal array */
+	ARBITER		arb;		/**< bus arbiter */
+	u_int32		dlUs;		/**< deadline per transaction [us] (0=none) */
+	const SMB2API_BACKEND *be;	/**< backend instead of MDIS path or NULL */
+	void		*beArg;		/**< argument for backend functions */
+	RECORDER	*rec;		/**< transaction recorder or NULL */
+	PRES		pres[PRES_ADDR_NUM];	/**< presence of devices */
+	u_int32		presTtlUs;	/**< presence cache TTL [us] (0=off) */
+	SMB2API_PRES_STATS presStats;	/**< presence cache statistics */
+	u_int32		route;		/**< routing mode (SMB2API_ROUTE_XXX) */
+	CAP			cap[CAP_NUM];	/**< capabilities (protected by
+										 bus ownership) */
+	RATE		*rate;		/**< RATE_ADDR_NUM rate limits or NULL
+								 (protected by arb.mtx) */
+	SMB2API_RATE_STATS rateStats;	/**< rate limit statistics */
+	struct ALERT_ENG *alertEng;	/**< alert engine or NULL */
+	struct SMB_HANDLE *root;	/**< handle that keeps alerts and shared
+								 statistics (parent of a clone, else
+								 the handle itself) */
+	u_int32		refs;		/**< references: the handle itself until its
+								 SMB2API_Exit() and its clones */
+	char		*device;	/**< MDIS device name (for clones) or NULL */
 }SMB_HANDLE;
 
+/** SMBus access descriptor */
+typedef struct
+{
+	int32		code;		/**< SMB2_BLK_xxx code (0 = not supported) */
+	u_int8		isGet;		/**< M_getstat (1) or M_setstat (0) */
+	u_int8		dataKind;	/**< data mapping (see OP_DATA_XXX above) */
+	u_int8		dir;		/**< data direction (see OP_DIR_XXX above) */
+}OP_DESC;
+
+/** SMBus access descriptors for one access size */
+typedef struct
+{
+	u_int8		size;		/**< SMB_ACC_XXX access size */
+	OP_DESC		op[2];		/**< [0]=#SMB_WRITE, [1]=#SMB_READ */
+}OP_ROW;
+
+/** Transfer object of an SMBus access */
+typedef union
+{
+	SMB2_TRANSFER		trx;	/**< byte/word transfer */
+	SMB2_TRANSFER_BLOCK	trxBlk;	/**< block transfer */
+}OP_TRX;
+
+/** Prepared transaction */
+typedef struct
+{
+	SMB_HANDLE		*h;			/**< SMB handle */
+	const OP_DESC	*op;		/**< access descriptor */
+	u_int32			flags;		/**< flags incl. SMB2API_FLAG_XXX */
+	M_SG_BLOCK		blk;		/**< pre-built getstat/setstat block */
+	OP_TRX			t;			/**< pre-filled transfer object */
+}PREP_TRX;
+
+/** Prepared batch */
+typedef struct
+{
+	u_int32		num;		/**< number of prepared transactions */
+	PREP_TRX	*prep[1];	/**< prepared transactions (num entries) */
+}PREP_BATCH;
+
+/** Playback backend (see SMB2API_InitPlayback) */
+typedef struct
+{
+	FILE		*fp;				/**< record file */
+	u_int8		buf[2*REC_OBJ_MAX];	/**< record objects */
+}PLAYBACK;
+
+/** Broker backend of a client (see SMB2API_InitBroker) */
+typedef struct
+{
+	int			fd;					/**< connection to the broker */
+	MTX			mtx;				/**< one request at a time */
+	u_int8		buf[BROKER_MSG_MAX];	/**< request/response */
+}BROKER_CLI;
+
+/** Client connection of the broker (see SMB2API_BrokerServe) */
+typedef struct
+{
+	int			fd;					/**< client socket */
+	u_int32		rxLen;				/**< received bytes of request */
+	u_int32		seq;				/**< arrival of complete request
+										 (SMB2API_NO_THREADS) */
+	SMB_HANDLE	*h;					/**< SMB handle of the device */
+	THREAD		thread;				/**< worker thread */
+	volatile u_int32 *stopP;		/**< stop flag of the worker */
+	volatile u_int32 done;			/**< worker terminated */
+	u_int8		buf[BROKER_MSG_MAX];	/**< request/response */
+	u_int8		i2cBuf[REC_I2C_MAX];	/**< I2C message data */
+}BROKER_CONN;
+
+/** Alert state of an address (alert engine) */
+typedef struct
+{
+	u_int32		count;			/**< coalesced alerts of current window */
+	u_int32		tFirst;			/**< first alert of window [us] */
+	u_int32		tLast;			/**< last alert of window [us] */
+	u_int16		sig;			/**< alerts of current round by signal */
+	u_int16		ara;			/**< alerts of current round by ARA */
+	u_int8		inRound;		/**< in round list */
+	u_int8		araValid;		/**< araData valid */
+	u_int8		araData;		/**< last alert response data */
+	u_int8		statusValid;	/**< status/statusRv valid */
+	u_int16		status;			/**< last pre-read status register */
+	int32		statusRv;		/**< result of last status pre-read */
+}ALERT_ADDR;
+
+/** Alert engine of an SMB handle (see SMB2API_AlertEngineStart) */
+typedef struct ALERT_ENG
+{
+	SMB_HANDLE			*h;			/**< SMB handle */
+	SMB2API_ALERT_CFG	cfg;		/**< configuration */
+	THREAD				thread;		/**< engine thread */
+	SEM					sem;		/**< posted by signal handler */
+	volatile u_int32	stop;		/**< terminate engine thread */
+	u_int32		sigPend[ALERT_ADDR_NUM/32];	/**< signalled addresses */
+	u_int32		sigCnt[ALERT_ADDR_NUM];		/**< signals per address */
+	ALERT_ADDR	addr[ALERT_ADDR_NUM];		/**< alert state per address */
+	u_int16		active[ALERT_ADDR_NUM];		/**< addresses with open window */
+	u_int32		activeNum;					/**< entries of active[] */
+	u_int16		round[ALERT_ADDR_NUM];		/**< addresses of current round */
+	u_int32		roundNum;					/**< entries of round[] */
+	u_int32		busOwned;					/**< bus owned by engine thread */
+	u_int32		pollUs;						/**< current poll interval [us] */
+	u_int32		pollNext;					/**< time of next poll [us] */
+}ALERT_ENG;
+
+/** Simulated SMBus device */
+typedef struct
+{
+	u_int8		present;				/**< device answers */
+	u_int8		alert;					/**< alert pending (SMBALERT#) */
+	u_int8		ptr;					/**< register pointer */
+	u_int32		sigCode;				/**< installed alert signal (0=none) */
+	u_int8		reg[SIM_REG_NUM];		/**< register file */
+}SIM_DEV;
+
+/** Simulated SMBus (see SMB2API_InitSim) */
+typedef struct
+{
+	MTX					mtx;			/**< protects the simulation */
+	u_int32				busClk;			/**< emulated bus clock [Hz] (0=none) */
+	SMB2API_SIM_STATS	stats;			/**< statistics */
+	SIM_DEV				dev[SIM_DEV_NUM];	/**< devices by address */
+}SIM;
+
 /** Double linked List for alerts */
 typedef struct
 {
 	UOS_DL_NODE n;							/**< list node */
+	SMB_HANDLE	*h;							/**< SMB handle */
 	u_int16		addr;						/**< SMBus address */
 	void		(*cbFunc)( void *cbArg );	/**< callback function */
+	void		(*cbFuncEx)( void *cbArg, const SMB2API_ALERT_INFO *infoP );
+											/**< extended callback function */
 	void		*cbArg;						/**< argument for callback function */
 	u_int32		sigCode; 					/**< UOS_SIG signal code */
+	u_int8		preCmd;						/**< status register to pre-read */
+	u_int8		preSize;					/**< its access size (0=none) */
+	u_int8		muxed;						/**< signal shared with other alerts */
 }ALERT_NODE;
 
 /*-----------------------------------------+
@@ -150,14 +560,204 @@ typedef struct
 +-----------------------------------------*/
 UOS_DL_LIST G_alertList;	/**< list for alert callbacks */
 
+/** protects G_alertList, G_sigUsers and the signal arrays */
+static MTX G_alertMtx;
+static u_int32 G_alertInit;		/**< G_alertList/G_alertMtx initialized */
+static u_int32 G_alertInitBusy;	/**< initialization claimed by a thread */
+static u_int32 G_sigUsers;		/**< installed alert signals */
+static SMB2API_ALERT_STATS G_alertStats;	/**< alert statistics */
+static u_int32 G_memBlocks;		/**< memory blocks allocated by the library */
+
+/** slicing-by-8 CRC-32 tables (see CrcInit) */
+static u_int32 G_crcTbl[8][256];
+static u_int32 G_crcInit;		/**< G_crcTbl filled */
+
+/** G_alertMtx taken by the calling thread */
+static TLS_VAR u_int32 G_tlsAlertLock;
+
+/** default priority class of the calling thread */
+static TLS_VAR u_int32 G_tlsPrio = SMB2API_PRIO_NORMAL;
+
+/** nesting level of bus arbitration of the calling thread */
+static TLS_VAR u_int32 G_tlsArbDepth;
+
+/** calling thread executes the signal handler (see SigHandler) */
+static TLS_VAR u_int32 G_tlsInSig;
+
+/** priority class of the transaction in the backend call (broker) */
+static TLS_VAR u_int32 G_tlsTrxPrio;
+
+/** absolute deadline of the calling thread [us] (if G_tlsDlSet) */
+static TLS_VAR u_int32 G_tlsDl;
+static TLS_VAR u_int32 G_tlsDlSet;
+
+/**
+ * SMBus access descriptors indexed by SMB_ACC_XXX access size
+ * (each row repeats its size for a consistency check)
+ */
+static const OP_ROW G_opTbl[] =
+{
+	/* SMB_ACC_QUICK */
+	{ SMB_ACC_QUICK,
+	  {{ SMB2_BLK_QUICK_COMM,		0, OP_DATA_NONE,  0 },
+	   { SMB2_BLK_QUICK_COMM,		0, OP_DATA_NONE,  0 }} },
+	/* SMB_ACC_BYTE */
+	{ SMB_ACC_BYTE,
+	  {{ SMB2_BLK_WRITE_BYTE,		0, OP_DATA_BYTE,  OP_DIR_IN },
+	   { SMB2_BLK_READ_BYTE,		1, OP_DATA_BYTE,  OP_DIR_OUT }} },
+	/* SMB_ACC_BYTE_DATA */
+	{ SMB_ACC_BYTE_DATA,
+	  {{ SMB2_BLK_WRITE_BYTE_DATA,	0, OP_DATA_BYTE,  OP_DIR_IN },
+	   { SMB2_BLK_READ_BYTE_DATA,	1, OP_DATA_BYTE,  OP_DIR_OUT }} },
+	/* SMB_ACC_WORD_DATA */
+	{ SMB_ACC_WORD_DATA,
+	  {{ SMB2_BLK_WRITE_WORD_DATA,	0, OP_DATA_WORD,  OP_DIR_IN },
+	   { SMB2_BLK_READ_WORD_DATA,	1, OP_DATA_WORD,  OP_DIR_OUT }} },
+	/* SMB_ACC_PROC_CALL */
+	{ SMB_ACC_PROC_CALL,
+	  {{ SMB2_BLK_PROCESS_CALL,		1, OP_DATA_WORD,  OP_DIR_IN|OP_DIR_OUT },
+	   { SMB2_BLK_PROCESS_CALL,		1, OP_DATA_WORD,  OP_DIR_IN|OP_DIR_OUT }} },
+	/* SMB_ACC_BLOCK_DATA */
+	{ SMB_ACC_BLOCK_DATA,
+	  {{ SMB2_BLK_WRITE_BLOCK_DATA,	0, OP_DATA_BLOCK, OP_DIR_IN },
+	   { SMB2_BLK_READ_BLOCK_DATA,	1, OP_DATA_BLOCK, OP_DIR_OUT }} },
+	/* SMB_ACC_I2C_BLOCK_DATA (no driver support) */
+	{ SMB_ACC_I2C_BLOCK_DATA,
+	  {{ 0,							0, OP_DATA_NONE,  0 },
+	   { 0,							0, OP_DATA_NONE,  0 }} },
+	/* SMB_ACC_BLOCK_PROC_CALL (same as SMB2API_BlockProcessCall) */
+	{ SMB_ACC_BLOCK_PROC_CALL,
+	  {{ SMB2_BLK_READ_BLOCK_DATA,	1, OP_DATA_BLOCK, OP_DIR_IN|OP_DIR_OUT },
+	   { SMB2_BLK_READ_BLOCK_DATA,	1, OP_DATA_BLOCK, OP_DIR_IN|OP_DIR_OUT }} },
+};
+
+#define OP_TBL_SIZE		(sizeof(G_opTbl)/sizeof(OP_ROW))
+
 /*-----------------------------------------+
 |  PROTOTYPES                              |
 +-----------------------------------------*/
 static void zeroOut( int8 *p, int32 size );
 static int32 AlertRemove( void *smbHdl, ALERT_NODE *alertNode );
-static ALERT_NODE* AlertFindByAddr( u_int16 addr );
-static ALERT_NODE* AlertFindBySig( u_int32 sigCode );
+static void AlertLock( void );
+static void AlertUnlock( void );
+static int32 AlertNodeInstall( void *smbHdl, ALERT_NODE *alertNode );
+static int32 AlertSigAlloc( SMB_HANDLE *h, u_int32 *sigCodeP );
+static void AlertSigFree( SMB_HANDLE *h, u_int32 sigCode );
+static int32 AlertPreRead(
+	SMB_HANDLE *h, u_int16 addr, u_int8 cmdAddr, u_int8 size, u_int16 *statusP );
+static int32 AlertEngBus( ALERT_ENG *e, u_int32 own );
+static void AlertEngSignal( ALERT_ENG *e, u_int16 addr );
+static THREAD_RET AlertEngThread( void *arg );
+static u_int32 AlertEngCollect( ALERT_ENG *e, u_int32 now );
+static ALERT_ADDR* AlertEngTouch( ALERT_ENG *e, u_int16 addr );
+static u_int32 AlertEngDeliver( ALERT_ENG *e, u_int32 now, u_int32 flush );
+static void AlertEngNotify( ALERT_ENG *e, u_int16 addr, u_int32 count );
+static ALERT_NODE* AlertFindByAddr( SMB_HANDLE *h, u_int16 addr );
+static u_int32 AlertSigNodes( u_int32 sigCode, u_int32 mux );
 static void __MAPILIB SigHandler(u_int32 sigCode);
+static const OP_DESC* OpFind( u_int8 readWrite, u_int8 size );
+static void OpInit(
+	const OP_DESC *op, u_int32 flags, u_int16 addr, u_int8 readWrite,
+	u_int8 cmdAddr, OP_TRX *t, M_SG_BLOCK *blk );
+static int32 BlkStat(
+	SMB_HANDLE *h, int32 code, u_int32 isGet, void *obj, u_int32 size );
+static int32 TrxExec(
+	SMB_HANDLE *h, int32 code, u_int32 isGet, M_SG_BLOCK *blk, u_int32 flags );
+static int32 TrxArb(
+	SMB_HANDLE *h, int32 code, u_int32 isGet, M_SG_BLOCK *blk, u_int32 flags );
+#if defined(SMB2API_USDT)
+static u_int16 TrcAddr( int32 code, void *obj, u_int8 *cmdAddrP );
+#endif
+static int32 ArbAcquire( SMB_HANDLE *h, u_int32 prio, const u_int32 *dlP );
+static void ArbRelease(
+	SMB_HANDLE *h, u_int32 prio, u_int32 tReq, u_int32 tBus, u_int32 overrun,
+	u_int32 bytes, u_int32 busUs );
+static void ArbStat(
+	SMB_HANDLE *root, u_int32 prio, u_int32 tReq, u_int32 tBus,
+	u_int32 overrun, u_int32 bytes, u_int32 busUs );
+static void ArbWakeup( ARBITER *a );
+static void ArbDrop( SMB_HANDLE *h );
+static int32 ArbHold( SMB_HANDLE *h, u_int32 prio );
+static void ArbUnhold( SMB_HANDLE *h );
+static int32 TrxCall( SMB_HANDLE *h, int32 code, u_int32 isGet, M_SG_BLOCK *blk );
+static int32 CapStat(
+	SMB_HANDLE *h, int32 code, u_int32 isGet, M_SG_BLOCK *blk, u_int32 flags );
+static u_int32 CapEmulOk( int32 code, u_int32 flags );
+static int32 CapEmulate( SMB_HANDLE *h, int32 code, void *obj );
+static int32 MemSeq(
+	SMB_HANDLE *h, u_int32 flags, u_int16 addr, u_int32 memAddr,
+	u_int32 addrLen, u_int8 *dataP, u_int32 num, u_int32 isRead );
+static int32 MemCheck( u_int32 mode, u_int32 memAddr, u_int32 len );
+static void CrcInit( void );
+static int32 UtilThrottle( SMB_HANDLE *h, const u_int32 *dlP );
+static int32 RateWait( SMB_HANDLE *h, u_int16 addr, const u_int32 *dlP );
+static void UtilUpdate( UTIL *u, u_int32 now );
+static u_int32 TrxBusBytes(
+	int32 code, void *obj, u_int32 size, u_int32 *bitsP );
+static SMB_HANDLE* HdlRoot( void *smbHdl );
+static int32 HdlFree( SMB_HANDLE *h );
+static int32 HdlCreate(
+	MDIS_PATH path, const SMB2API_BACKEND *be, void *beArg, void **smbHdlP );
+static int32 RecEncode(
+	int32 code, void *obj, u_int32 size, u_int8 *buf, u_int32 bufLen,
+	u_int32 isOut, u_int32 *lenP );
+static int32 RecDecode(
+	int32 code, const u_int8 *buf, u_int32 bufLen, void *obj, u_int32 size,
+	u_int8 *i2cBuf, u_int32 *sizeP );
+static void RecWrite(
+	RECORDER *rec, int32 code, u_int32 isGet, u_int32 flags, int32 rv,
+	u_int32 tBus, u_int32 tEnd, u_int32 inLen, void *obj, u_int32 size );
+static int32 RecRead(
+	FILE *fp, u_int8 *hdr, u_int8 *objBuf, u_int32 *inLenP, u_int32 *outLenP );
+static int32 RecOpen( const char *fileName, FILE **fpP );
+static void PutLe( u_int8 *p, u_int32 val, u_int32 n );
+static u_int32 GetLe( const u_int8 *p, u_int32 n );
+static int32 __MAPILIB PlaybackStat(
+	void *beArg, int32 code, u_int32 isGet, void *obj, u_int32 size );
+static int32 __MAPILIB PlaybackExit( void *beArg );
+static int32 __MAPILIB BrokerStat(
+	void *beArg, int32 code, u_int32 isGet, void *obj, u_int32 size );
+static int32 __MAPILIB BrokerExit( void *beArg );
+#if defined(SMB2API_NO_THREADS)
+static int32 BrokerRounds( SMB_HANDLE *h, int lfd, volatile u_int32 *stopP );
+#else
+static int32 BrokerWorkers( SMB_HANDLE *h, int lfd, volatile u_int32 *stopP );
+static THREAD_RET BrokerConnThread( void *arg );
+#endif
+static int32 BrokerRecv( BROKER_CONN *c );
+static int32 BrokerExec( SMB_HANDLE *h, BROKER_CONN *c );
+static int32 BrokerXfer( int fd, u_int8 *buf, u_int32 len, u_int32 isSend );
+static int32 PresCached( SMB_HANDLE *h, u_int16 addr, u_int32 now );
+static void PresUpdate( SMB_HANDLE *h, u_int16 addr, int32 rv, u_int32 now );
+static u_int16 PresAddr( int32 code, void *obj );
+static SIM* SimGet( void *smbHdl );
+static int32 __MAPILIB SimStat(
+	void *beArg, int32 code, u_int32 isGet, void *obj, u_int32 size );
+static int32 __MAPILIB SimExit( void *beArg );
+static int32 SimAccess( SIM *sim, int32 code, void *obj, u_int32 size );
+static int32 SimI2cMsg( SIM *sim, SMB_I2CMESSAGE *msg );
+static void* MemAlloc( u_int32 size );
+static void MemFree( void *p );
+static void MtxInit( MTX *m );
+static void MtxExit( MTX *m );
+static void MtxLock( MTX *m );
+static void MtxUnlock( MTX *m );
+static void CondInit( COND *c );
+static void CondExit( COND *c );
+static void CondWait( COND *c, MTX *m );
+static void CondTimedWait( COND *c, MTX *m, u_int32 us );
+static void CondBroadcast( COND *c );
+static void SemInit( SEM *s );
+static void SemExit( SEM *s );
+static void SemPost( SEM *s );
+static int32 SemTimedWait( SEM *s, u_int32 us );
+static int32 ThreadCreate( THREAD *t, THREAD_FUNC func, void *arg );
+static void ThreadJoin( THREAD *t );
+static u_int32 AtomicXchg( u_int32 *p, u_int32 val );
+static u_int32 TimeUsec( void );
+static void SleepUsec( u_int32 us );
+static int32 OpDataIn( const OP_DESC *op, void *trxP, u_int8 *dataP );
+static void OpDataOut( const OP_DESC *op, void *trxP, u_int8 *dataP );
 
 /**
  * \defgroup _SMB2_API SMB2_API
@@ -172,6 +772,8 @@ static void __MAPILIB SigHandler(u_int32 sigCode);
  */
 char* __MAPILIB SMB2API_Ident(	void )
 {
+	API_ENTRY( NULL );
+	TRC4( api__return, __func__, NULL, 0, 0 );
     return( "SMB2_API: $Id: smb2_api.c,v 1.9 2010/04/19 13:42:16 dpfeuffer Exp $" );
 }
 
@@ -188,20 +790,166 @@ char* __MAPILIB SMB2API_Ident(	void )
  */
 int32 __MAPILIB SMB2API_Init( char *device, void **smbHdlP )
 {
+	SMB_HANDLE	*h;
 	MDIS_PATH	path;
-	int32		size, ret;
-	u_int32		si;
-	SMB_HANDLE	*smbHdl=NULL;
+	int32		ret;
+
+	API_ENTRY( NULL );
 
 	/* open device */
-	if( (path = M_open(device)) < 0 )
-		goto ERR_EXIT;
+	if( (path = M_open(device)) < 0 ){
+		ret = UOS_ErrnoGet();
+		*smbHdlP = NULL;
+		API_RETURN( NULL, ret );
+	}
+
+	if( (ret = HdlCreate( path, NULL, NULL, smbHdlP )) ){
+		M_close( path );
+		API_RETURN( NULL, ret );
+	}
+
+	/* keep device name for clones */
+	h = (SMB_HANDLE*)*smbHdlP;
+	if( !(h->device = (char*)MemAlloc( (u_int32)strlen( device ) + 1 )) ){
+		SMB2API_Exit( smbHdlP );
+		API_RETURN( NULL, SMB_ERR_NO_MEM );
+	}
+	strcpy( h->device, device );
+
+	API_RETURN( NULL, 0 );
+}
+
+/**********************************************************************/
+/** Initialize library with a backend instead of an MDIS device
+ *
+ *  The transactions of the returned SMB handle are passed to the
+ *  backend functions instead of the SMB2 driver, e.g. to run an
+ *  application against a simulated SMBus. The backend Stat function
+ *  gets the same SMB2_BLK_XXX code and transfer object as the driver
+ *  and returns 0 or an error code.
+ *
+ *  \param 	be			\IN  backend functions (must stay valid)
+ *  \param 	beArg		\IN  argument for backend functions
+ *  \param	smbHdlP		\INOUT pointer to variable for SMB handle
+ *  \return 	0 on success or error code
+ *
+ *  \sa SMB2API_Exit
+ */
+int32 __MAPILIB SMB2API_InitBackend(
+	const SMB2API_BACKEND	*be,
+	void					*beArg,
+	void					**smbHdlP )
+{
+	API_ENTRY( beArg );
+
+	if( !be || !be->Stat ){
+		*smbHdlP = NULL;
+		API_RETURN( beArg, SMB_ERR_PARAM );
+	}
+
+	API_RETURN( beArg, HdlCreate( -1, be, beArg, smbHdlP ) );
+}
+
+/**********************************************************************/
+/** Create a clone of an SMB handle
+ *
+ *  The clone opens an additional MDIS path to the device of \a smbHdl
+ *  and has an own bus arbiter. Transactions of different clones are not
+ *  serialized by the library but by the SMB2 driver, so each worker
+ *  thread can own a clone and access independent devices without
+ *  waiting for the other threads.
+ *
+ *  Shared with the parent handle (the one created by SMB2API_Init):
+ *  - alert callbacks and alert engine (installed via the MDIS path of
+ *    the parent, also if installed through a clone)
+ *  - latency, deadline and bus utilization statistics, throttling of
+ *    #SMB2API_PRIO_LOW transactions
+ *  - presence cache, rate limits and their statistics
+ *
+ *  Own per clone are the arbitration by priority class (between the
+ *  threads using the clone), the deadline and routing mode (copied from
+ *  \a smbHdl), the learned capabilities and the recording.
+ *
+ *  A clone of a backend handle (e.g. SMB2API_InitSim) calls the backend
+ *  of the parent, the backend must allow concurrent calls.
+ *
+ *  Each clone keeps a reference to the parent: SMB2API_Exit() of a
+ *  parent with clones invalidates the parent handle for the caller, but
+ *  frees it (with its alert callbacks, alert engine and MDIS path or
+ *  backend) with the last clone.
+ *
+ *  \param 	smbHdl		\IN  SMB handle (parent or clone)
+ *  \param	cloneHdlP	\INOUT pointer to variable for SMB handle
+ *  \return 	0 on success or error code
+ *
+ *  \sa SMB2API_Exit
+ */
+int32 __MAPILIB SMB2API_Clone( void *smbHdl, void **cloneHdlP )
+{
+	SMB_HANDLE	*h = (SMB_HANDLE*)smbHdl;
+	SMB_HANDLE	*root = HdlRoot( smbHdl );
+	SMB_HANDLE	*c;
+	MDIS_PATH	path = -1;
+	int32		ret;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || !cloneHdlP )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	/* open device again */
+	if( !root->be && ((path = M_open( root->device )) < 0) ){
+		ret = UOS_ErrnoGet();
+		*cloneHdlP = NULL;
+		API_RETURN( smbHdl, ret );
+	}
+
+	if( (ret = HdlCreate( path, root->be, root->beArg, cloneHdlP )) ){
+		if( !root->be )
+			M_close( path );
+		API_RETURN( smbHdl, ret );
+	}
+
+	c = (SMB_HANDLE*)*cloneHdlP;
+	c->root = root;
+	c->route = h->route;
+	c->dlUs = h->dlUs;
+	ATOMIC_ADD( root->refs, 1 );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return handle that keeps alerts and shared statistics (see
+ * SMB2API_Clone) or NULL
+ */
+static SMB_HANDLE* HdlRoot( void *smbHdl )
+{
+	return smbHdl ? ((SMB_HANDLE*)smbHdl)->root : NULL;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Create SMB handle for MDIS path or backend
+ */
+static int32 HdlCreate(
+	MDIS_PATH				path,
+	const SMB2API_BACKEND	*be,
+	void					*beArg,
+	void					**smbHdlP )
+{
+	int32		size;
+	u_int32		si, prio;
+	SMB_HANDLE	*smbHdl=NULL;
 
 	/* alloc struct */
 	size = sizeof(SMB_HANDLE);
-	smbHdl = (SMB_HANDLE*)malloc( size );
-	if( !smbHdl )
-		goto ERR_EXIT;
+	smbHdl = (SMB_HANDLE*)MemAlloc( size );
+	if( !smbHdl ){
+		*smbHdlP = NULL;
+		return (SMB_ERR_NO_MEM);
+	}
 
 	zeroOut( (int8*)smbHdl, size );
 
@@ -225,27 +973,42 @@ int32 __MAPILIB SMB2API_Init( char *device, void **smbHdlP )
 	smbHdl->entries.I2CXfer				= SMB2API_I2CXfer;
 
 	/* fill private params */
+	smbHdl->root = smbHdl;
+	smbHdl->refs = 1;
 	smbHdl->path = path;
+	smbHdl->be = be;
+	smbHdl->beArg = beArg;
+
+	/* emulate what the controller does not support (see SMB2API_RouteSet) */
+	smbHdl->route = be ? SMB2API_ROUTE_NATIVE : SMB2API_ROUTE_FALLBACK;
 
 	for( si=0; si<NBR_OF_SIG; si++ ){
 		smbHdl->signal[si].sigCode = FIRST_SIG + si;
 		smbHdl->signal[si].condition = SIG_FREE;
 	}
 
-	/* init list */
-	UOS_DL_NewList( &G_alertList );
+	/* init bus arbiter */
+	MtxInit( &smbHdl->arb.mtx );
+	for( prio=0; prio<SMB2API_PRIO_NUM; prio++ )
+		CondInit( &smbHdl->arb.cond[prio] );
+	smbHdl->arb.util.busClk = UTIL_BUSCLK_DEF;
+	smbHdl->arb.util.winStart = TimeUsec();
+
+	/* init alert list (once, shared by all handles) */
+	if( !ATOMIC_OR( G_alertInit, 0 ) ){
+		if( !AtomicXchg( &G_alertInitBusy, 1 ) ){
+			MtxInit( &G_alertMtx );
+			UOS_DL_NewList( &G_alertList );
+			ATOMIC_OR( G_alertInit, 1 );
+		}
+		/* initialized by a concurrent call */
+		while( !ATOMIC_OR( G_alertInit, 0 ) )
+			UOS_Delay( 1 );
+	}
 
 	/* retrun the handle */
 	*smbHdlP = (void*)smbHdl;
 	return 0;
-
-/* error handling */
-ERR_EXIT:
-	ret = UOS_ErrnoGet();
-	if( smbHdl )
-		free( (void*)smbHdl );
-	*smbHdlP = NULL;
-	return ret;
 }
 
 /**********************************************************************/
@@ -254,6 +1017,10 @@ ERR_EXIT:
  *  The open device will be closed and the SMB handle freed.
  *  *smbHdlP will be set to NULL.
  *
+ *  A parent with clones is freed with its last clone (see
+ *  SMB2API_Clone), the error of closing the device is returned by the
+ *  SMB2API_Exit() of that clone then.
+ *
  *  \param	smbHdlP	\INOUT pointer to variable for SMB handle
  *  \return 	0 on success or error code
  *
@@ -261,24 +1028,84 @@ ERR_EXIT:
  */
 int32 __MAPILIB SMB2API_Exit( void **smbHdlP )
 {
-	SMB_HANDLE *smbHdl = (SMB_HANDLE*)*smbHdlP;
-	MDIS_PATH path = smbHdl->path;
-	ALERT_NODE	*alertNode, *alertNodeNext;
+	SMB_HANDLE	*smbHdl = (SMB_HANDLE*)*smbHdlP;
+	SMB_HANDLE	*root = smbHdl->root;
+	ALERT_NODE	*alertNode;
+	int32		rv = 0, ret;
 
-	/* remove all installed alerts */
-	alertNode = (ALERT_NODE*)G_alertList.head;
-	alertNodeNext = (ALERT_NODE*)alertNode->n.next;
-	while( alertNodeNext ){
-		AlertRemove( smbHdl, alertNode );
-		alertNodeNext = (ALERT_NODE*)alertNode->n.next;
-	}
+	API_ENTRY( NULL );
 
-	free( (void*)smbHdl );
 	*smbHdlP = NULL;
 
+	/* stop recording */
+	SMB2API_RecordStop( smbHdl );
+
+	/* free clone, drop its reference to the parent */
+	if( smbHdl != root )
+		rv = HdlFree( smbHdl );
+
+	/* parent in use by clones */
+	if( ATOMIC_DEC( root->refs ) )
+		API_RETURN( NULL, rv );
+
+	/* stop alert engine */
+	SMB2API_AlertEngineStop( root );
+
+	/* remove all alerts installed for this handle (and its clones) */
+	do {
+		AlertLock();
+		for( alertNode=(ALERT_NODE*)G_alertList.head;
+			 alertNode->n.next;
+			 alertNode = (ALERT_NODE*)alertNode->n.next ){
+			if( alertNode->h == root )
+				break;
+		}
+		if( alertNode->n.next )
+			UOS_DL_Remove( &alertNode->n );
+		else
+			alertNode = NULL;
+		AlertUnlock();
+
+		if( alertNode )
+			AlertRemove( root, alertNode );
+	} while( alertNode );
+
+	if( (ret = HdlFree( root )) && !rv )
+		rv = ret;
+
+	API_RETURN( NULL, rv );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Free SMB handle, close its MDIS path or terminate the backend (shared
+ * by clones with the parent)
+ */
+static int32 HdlFree( SMB_HANDLE *h )
+{
+	MDIS_PATH				path = h->path;
+	const SMB2API_BACKEND	*be = h->be;
+	void					*beArg = h->beArg;
+	u_int32					clone = (h->root != h);
+	u_int32					prio;
+
+	MemFree( (void*)h->rate );
+
+	/* terminate bus arbiter */
+	for( prio=0; prio<SMB2API_PRIO_NUM; prio++ )
+		CondExit( &h->arb.cond[prio] );
+	MtxExit( &h->arb.mtx );
+
+	MemFree( (void*)h->device );
+	MemFree( (void*)h );
+
+	/* terminate backend */
+	if( be )
+		return ((be->Exit && !clone) ? be->Exit( beArg ) : 0);
+
 	/* close device */
 	if( M_close( path ) < 0 )
-		return UOS_ErrnoGet();
+		return (UOS_ErrnoGet());
 
 	return 0;
 }
@@ -307,6 +1134,8 @@ int32 __MAPILIB SMB2API_QuickComm(
 	SMB2_TRANSFER trx;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	zeroOut( (int8*)&trx, sizeof(SMB2_TRANSFER) );
 	trx.flags = flags;
 	trx.addr = addr;
@@ -314,7 +1143,7 @@ int32 __MAPILIB SMB2API_QuickComm(
 
 	DO_BLK_SETSTAT( trx, SMB2_BLK_QUICK_COMM );
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -340,6 +1169,8 @@ int32 __MAPILIB SMB2API_WriteByte(
 	SMB2_TRANSFER trx;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	zeroOut( (int8*)&trx, sizeof(SMB2_TRANSFER) );
 	trx.flags = flags;
 	trx.addr = addr;
@@ -347,7 +1178,7 @@ int32 __MAPILIB SMB2API_WriteByte(
 
 	DO_BLK_SETSTAT( trx, SMB2_BLK_WRITE_BYTE );
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -373,17 +1204,19 @@ int32 __MAPILIB SMB2API_ReadByte(
 	SMB2_TRANSFER trx;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	zeroOut( (int8*)&trx, sizeof(SMB2_TRANSFER) );
 	trx.flags = flags;
 	trx.addr = addr;
 
 	DO_BLK_GETSTAT( trx, SMB2_BLK_READ_BYTE );
 	if( rv )
-		return rv;
+		API_RETURN( smbHdl, rv );
 
 	*dataP = trx.u.byteData;
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -411,6 +1244,8 @@ int32 __MAPILIB SMB2API_WriteByteData(
 	SMB2_TRANSFER trx;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	zeroOut( (int8*)&trx, sizeof(SMB2_TRANSFER) );
 	trx.flags = flags;
 	trx.addr = addr;
@@ -419,7 +1254,7 @@ int32 __MAPILIB SMB2API_WriteByteData(
 
 	DO_BLK_SETSTAT( trx, SMB2_BLK_WRITE_BYTE_DATA );
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -447,6 +1282,8 @@ int32 __MAPILIB SMB2API_ReadByteData(
 	SMB2_TRANSFER trx;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	zeroOut( (int8*)&trx, sizeof(SMB2_TRANSFER) );
 	trx.flags = flags;
 	trx.addr = addr;
@@ -454,11 +1291,11 @@ int32 __MAPILIB SMB2API_ReadByteData(
 
 	DO_BLK_GETSTAT( trx, SMB2_BLK_READ_BYTE_DATA );
 	if( rv )
-		return rv;
+		API_RETURN( smbHdl, rv );
 
 	*dataP = trx.u.byteData;
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -486,6 +1323,8 @@ int32 __MAPILIB SMB2API_WriteWordData(
 	SMB2_TRANSFER trx;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	zeroOut( (int8*)&trx, sizeof(SMB2_TRANSFER) );
 	trx.flags = flags;
 	trx.addr = addr;
@@ -494,7 +1333,7 @@ int32 __MAPILIB SMB2API_WriteWordData(
 
 	DO_BLK_SETSTAT( trx, SMB2_BLK_WRITE_WORD_DATA );
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -522,6 +1361,8 @@ int32 __MAPILIB SMB2API_ReadWordData(
 	SMB2_TRANSFER trx;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	zeroOut( (int8*)&trx, sizeof(SMB2_TRANSFER) );
 	trx.flags = flags;
 	trx.addr = addr;
@@ -529,11 +1370,11 @@ int32 __MAPILIB SMB2API_ReadWordData(
 
 	DO_BLK_GETSTAT( trx, SMB2_BLK_READ_WORD_DATA );
 	if( rv )
-		return rv;
+		API_RETURN( smbHdl, rv );
 
 	*dataP = trx.u.wordData;
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -563,9 +1404,11 @@ int32 __MAPILIB SMB2API_WriteBlockData(
 	SMB2_TRANSFER_BLOCK trxBlk;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	/* check length */
 	if( (length < 1) || (length > SMB_BLOCK_MAX_BYTES) )
-		return (SMB_ERR_PARAM);
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
 
 	zeroOut( (int8*)&trxBlk, sizeof(SMB2_TRANSFER_BLOCK) );
 	trxBlk.flags = flags;
@@ -576,7 +1419,7 @@ int32 __MAPILIB SMB2API_WriteBlockData(
 
 	DO_BLK_SETSTAT( trxBlk, SMB2_BLK_WRITE_BLOCK_DATA );
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -606,6 +1449,8 @@ int32 __MAPILIB SMB2API_ReadBlockData(
 	SMB2_TRANSFER_BLOCK trxBlk;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	zeroOut( (int8*)&trxBlk, sizeof(SMB2_TRANSFER_BLOCK) );
 	trxBlk.flags = flags;
 	trxBlk.addr = addr;
@@ -615,12 +1460,12 @@ int32 __MAPILIB SMB2API_ReadBlockData(
 
 	DO_BLK_GETSTAT( trxBlk, SMB2_BLK_READ_BLOCK_DATA );
 	if( rv )
-		return rv;
+		API_RETURN( smbHdl, rv );
 
 	*lengthP = trxBlk.u.length;
 	memcpy( (void*)dataP, (void*)trxBlk.data, *lengthP );
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -648,6 +1493,8 @@ int32 __MAPILIB SMB2API_ProcessCall(
 	SMB2_TRANSFER trx;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	zeroOut( (int8*)&trx, sizeof(SMB2_TRANSFER) );
 	trx.flags = flags;
 	trx.addr = addr;
@@ -656,11 +1503,11 @@ int32 __MAPILIB SMB2API_ProcessCall(
 
 	DO_BLK_GETSTAT( trx, SMB2_BLK_PROCESS_CALL );
 	if( rv )
-		return rv;
+		API_RETURN( smbHdl, rv );
 
 	*dataP = trx.u.wordData;
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -696,9 +1543,11 @@ int32 __MAPILIB SMB2API_BlockProcessCall(
 	SMB2_TRANSFER_BLOCK trxBlk;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	/* check length */
 	if( (writeLen < 1) || (writeLen > SMB_BLOCK_MAX_BYTES) )
-		return (SMB_ERR_PARAM);
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
 
 	zeroOut( (int8*)&trxBlk, sizeof(SMB2_TRANSFER_BLOCK) );
 	trxBlk.flags = flags;
@@ -711,18 +1560,27 @@ int32 __MAPILIB SMB2API_BlockProcessCall(
 
 	DO_BLK_GETSTAT( trxBlk, SMB2_BLK_READ_BLOCK_DATA );
 	if( rv )
-		return rv;
+		API_RETURN( smbHdl, rv );
 
 	*readLenP = trxBlk.readLen;
 	memcpy( (void*)readDataP, (void*)(trxBlk.data + writeLen), *readLenP );
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
 /** Read from / write to a SMB device using the SMBus protocol
  *
- *   Not supported by SMB2_API!
+ *  The access is looked up by \a readWrite and \a size in the table of
+ *  SMBus access descriptors and executed with the matching SMB2_BLK_XXX
+ *  code. Layout of the data buffer:
+ *  - #SMB_ACC_QUICK: not used (the quick command bit is \a readWrite)
+ *  - byte accesses: dataP[0]
+ *  - word accesses and #SMB_ACC_PROC_CALL: *(u_int16*)dataP
+ *  - block accesses: dataP[0] = length, dataP[1..] = data\n
+ *    #SMB_ACC_BLOCK_PROC_CALL: write data on entry, read data on return
+ *
+ *  #SMB_ACC_I2C_BLOCK_DATA is not supported by the SMB2 driver.
  *
  *---------------------------------------------------------------------------
  *  \param     smbHdl		\IN SMB handle
@@ -731,10 +1589,12 @@ int32 __MAPILIB SMB2API_BlockProcessCall(
  *	\param     readWrite	\IN access to perform ( #SMB_READ or #SMB_WRITE )
  *	\param     cmdAddr		\IN device command or index value
  *	\param     size			\IN size of data access (Quick/Byte/Word/Block/(Blk-)Proc
- *	\param     *dataP		\IN data to write / read data (1..32 bytes)
+ *	\param     *dataP		\INOUT data to write / read data (see above)
  *
  *  \return    0 | error code
  *
+ *  \sa SMB2API_SmbXferList
+ *
  ****************************************************************************/
 int32 __MAPILIB SMB2API_SmbXfer(
 	void		*smbHdl,
@@ -745,7 +1605,83 @@ int32 __MAPILIB SMB2API_SmbXfer(
 	u_int8		size,
 	u_int8		*dataP )
 {
-	return -1;
+	const OP_DESC	*op;
+	OP_TRX			t;
+	M_SG_BLOCK		blk;
+	int32			rv;
+
+	API_ENTRY( smbHdl );
+
+	if( !(op = OpFind( readWrite, size )) )
+		API_RETURN( smbHdl, SMB_ERR_NOT_SUPPORTED );
+
+	OpInit( op, flags, addr, readWrite, cmdAddr, &t, &blk );
+
+	if( (rv = OpDataIn( op, (void*)&t, dataP )) )
+		API_RETURN( smbHdl, rv );
+
+	if( (rv = TrxExec( (SMB_HANDLE*)smbHdl, op->code, op->isGet, &blk,
+					   flags )) )
+		API_RETURN( smbHdl, rv );
+
+	OpDataOut( op, (void*)&t, dataP );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Execute a sequence of SMBus accesses
+ *
+ *  The accesses are executed in array order as by SMB2API_SmbXfer().
+ *  All descriptors are checked before the first bus access. Execution
+ *  stops at the first failing access.
+ *
+ *  Other transactions may be served between the accesses (see
+ *  SMB2API_PrioSet()).
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     xfer			\INOUT access descriptors (dataP see
+ *							SMB2API_SmbXfer)
+ *	\param     num			\IN number of accesses
+ *	\param     errIdxP		\OUT index of failed access or number of
+ *							accesses if all succeeded (may be NULL)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_SmbXfer
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_SmbXferList(
+	void			*smbHdl,
+	SMB2API_XFER	xfer[],
+	u_int32			num,
+	u_int32			*errIdxP )
+{
+	int32	rv = 0;
+	u_int32	n;
+
+	API_ENTRY( smbHdl );
+
+	for( n=0; n<num; n++ ){
+		if( !OpFind( xfer[n].readWrite, xfer[n].size ) ){
+			rv = SMB_ERR_NOT_SUPPORTED;
+			goto DONE;
+		}
+	}
+
+	for( n=0; n<num; n++ ){
+		if( (rv = SMB2API_SmbXfer( smbHdl, xfer[n].flags, xfer[n].addr,
+								   xfer[n].readWrite, xfer[n].cmdAddr,
+								   xfer[n].size, xfer[n].dataP )) )
+			break;
+	}
+
+DONE:
+	if( errIdxP )
+		*errIdxP = n;
+
+	API_RETURN( smbHdl, rv );
 }
 
 
@@ -768,17 +1704,156 @@ int32 __MAPILIB SMB2API_I2CXfer(
 	int32	rv = 0;
 	u_int32	n;
 
+	API_ENTRY( smbHdl );
+
 	for( n=0; n<num; n++ ){
 		DO_BLK_GETSTAT( msg[n], SMB2_BLK_I2C_XFER );
 		if( rv )
-			return rv;
+			API_RETURN( smbHdl, rv );
 	}
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
-/**********************************************************************/
-/** Convert SMB2 and MDIS error code to string
+/****************************************************************************/
+/** Read from / write to SMB devices using I2C messages with several buffers
+ *
+ *  Like SMB2API_I2CXfer(), but the data of each message is a list of
+ *  buffers (scatter-gather), e.g. memory address and page data of an
+ *  EEPROM write or header and data of a firmware upload from different
+ *  places. Each message is one I2C message on the bus, without
+ *  start condition between its buffers.
+ *
+ *  The messages are executed while the bus is owned, so no other
+ *  transaction of the SMB handle comes between them. They are passed to
+ *  the driver in pairs, each pair in one transfer (e.g. write, then
+ *  read with repeated start).
+ *
+ *  Messages with one buffer are passed to the driver as they are. The
+ *  driver takes one buffer per message, so the buffers of other
+ *  messages are gathered (write) / scattered (read) by the library: on
+ *  the stack up to 256 bytes per pair, otherwise in a heap buffer.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	\IN SMB handle
+ *	\param     msg		\IN array of I2C messages to transfer
+ *	\param     num      \IN number of messages in msg to transfer
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_I2CXfer
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_I2CXferV(
+	void				*smbHdl,
+	SMB2API_I2C_MSGV	msg[],
+	u_int32				num )
+{
+	SMB_HANDLE		*h = (SMB_HANDLE*)smbHdl;
+	SMB_I2CMESSAGE	m[I2C_XFER_MSG_MAX];
+	M_SG_BLOCK		blk;
+	SMB2API_I2C_VEC	*vec;
+	u_int8			stkBuf[XFERV_STACK_MAX];
+	u_int8			*gather, *p, *q;
+	u_int32			n, i, cnt, v, len, gatherLen;
+	u_int32			own = !G_tlsArbDepth && (num > I2C_XFER_MSG_MAX);
+	int32			rv = 0;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || (num && !msg) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	/* check messages (max. 64KB each) */
+	for( n=0; n<num; n++ ){
+		if( msg[n].vecNum && !msg[n].vec )
+			API_RETURN( smbHdl, SMB_ERR_PARAM );
+		for( len=0, v=0; v<msg[n].vecNum; v++ ){
+			if( msg[n].vec[v].len > 0xffff - len )
+				API_RETURN( smbHdl, SMB_ERR_PARAM );
+			len += msg[n].vec[v].len;
+		}
+	}
+
+	/*
+	 * more messages than one transfer takes: own the bus for all
+	 * transfers (rate limited devices: wait before)
+	 */
+	if( own ){
+		for( n=0; h->root->rate && (n < num); n++ ){
+			if( (rv = RateWait( h->root, msg[n].addr, NULL )) )
+				API_RETURN( smbHdl, rv );
+		}
+
+		G_tlsArbDepth++;
+		if( (rv = ArbAcquire( h, G_tlsPrio, NULL )) ){
+			G_tlsArbDepth--;
+			API_RETURN( smbHdl, rv );
+		}
+	}
+
+	for( n=0; (n < num) && !rv; n += cnt ){
+		cnt = (num - n < I2C_XFER_MSG_MAX) ? num - n : I2C_XFER_MSG_MAX;
+
+		for( gatherLen=0, i=0; i<cnt; i++ ){
+			m[i].addr = msg[n+i].addr;
+			m[i].flags = msg[n+i].flags;
+			m[i].buf = msg[n+i].vecNum ? msg[n+i].vec[0].buf : NULL;
+			for( len=0, v=0; v<msg[n+i].vecNum; v++ )
+				len += msg[n+i].vec[v].len;
+			m[i].len = (u_int16)len;
+			if( msg[n+i].vecNum > 1 )
+				gatherLen += len;
+		}
+
+		/* gather buffer of the pair: on the stack if it fits */
+		gather = stkBuf;
+		if( (gatherLen > XFERV_STACK_MAX) &&
+			!(gather = (u_int8*)MemAlloc( gatherLen )) ){
+			rv = SMB_ERR_NO_MEM;
+			break;
+		}
+
+		/* gather write data */
+		for( p=gather, i=0; i<cnt; i++ ){
+			if( msg[n+i].vecNum < 2 )
+				continue;
+			m[i].buf = p;
+			for( vec=msg[n+i].vec, v=0; v<msg[n+i].vecNum; v++ ){
+				if( !(m[i].flags & I2C_M_RD) )
+					memcpy( (void*)p, (void*)vec[v].buf, vec[v].len );
+				p += vec[v].len;
+			}
+		}
+
+		blk.size = cnt * sizeof(SMB_I2CMESSAGE);
+		blk.data = (void*)m;
+		rv = TrxExec( h, SMB2_BLK_I2C_XFER, 1, &blk, 0 );
+
+		/* scatter read data */
+		for( i=0; (i < cnt) && !rv; i++ ){
+			if( (msg[n+i].vecNum < 2) || !(m[i].flags & I2C_M_RD) )
+				continue;
+			for( q=m[i].buf, vec=msg[n+i].vec, v=0; v<msg[n+i].vecNum; v++ ){
+				memcpy( (void*)vec[v].buf, (void*)q, vec[v].len );
+				q += vec[v].len;
+			}
+		}
+
+		if( gather != stkBuf )
+			MemFree( (void*)gather );
+	}
+
+	if( own ){
+		ArbDrop( h );
+		G_tlsArbDepth--;
+	}
+
+	API_RETURN( smbHdl, rv );
+}
+
+/**********************************************************************/
+/** Convert SMB2 and MDIS error code to string
  *
  * SMB2API_Errstring() creates an error message for error \a errCode and
  * returns a pointer to the generated string with the following
@@ -837,11 +1912,21 @@ char* __MAPILIB SMB2API_Errstring(
 		{ SMB_ERR_ADDR_EXCLUDED		,"Address is excluded" },
 		{ SMB_ERR_NO_IDLE			,"Bus did not get idle after STOP" },
 		{ SMB_ERR_CTRL_BUSY			,"Controller is busy" },
+		/* SMB2_API library errors */
+		{ SMB2API_ERR_DEADLINE		,"Deadline passed before bus access" },
+		{ SMB2API_ERR_OVERRUN		,"Deadline passed during bus access" },
+		{ SMB2API_ERR_RECORD		,"Record file corrupt or mismatch" },
+		{ SMB2API_ERR_SHM			,"Shared memory region not available" },
+		{ SMB2API_ERR_NO_DATA		,"No value published yet" },
+		{ SMB2API_ERR_BROKER		,"Broker connection failed" },
+		{ SMB2API_ERR_VERIFY		,"Verify after write failed" },
 		/* max string size indicator  |1---------------------------------------------50| */
 	};
 
 	#define NBR_OF_ERR sizeof(errStrTable)/sizeof(struct _ERR_STR)
 
+	API_ENTRY( NULL );
+
 	/*----------------------+
     |  SMB2 error?          |
     +----------------------*/
@@ -870,6 +1955,7 @@ char* __MAPILIB SMB2API_Errstring(
 		M_errstringTs( errCode, strBuf );
 	}
 
+	TRC4( api__return, __func__, NULL, 0, errCode );
     return(strBuf);
 }
 
@@ -901,6 +1987,8 @@ int32 __MAPILIB SMB2API_AlertResponse(
 	SMB2_TRANSFER trx;
 	int32 rv;
 
+	API_ENTRY( smbHdl );
+
 	zeroOut( (int8*)&trx, sizeof(SMB2_TRANSFER) );
 	trx.flags = flags;
 	trx.addr = addr;
@@ -909,11 +1997,11 @@ int32 __MAPILIB SMB2API_AlertResponse(
 
 	DO_BLK_GETSTAT( trx, SMB2_BLK_ALERT_RESPONSE );
 	if( rv )
-		return rv;
+		API_RETURN( smbHdl, rv );
 
 	*alertCntP = trx.u.alertCnt;
 
-	return rv;
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -927,6 +2015,15 @@ int32 __MAPILIB SMB2API_AlertResponse(
  *  SMB2API_AlertCbInstallSig function should be used to specify an individual
  *  UOS library conform signal code.
  *
+ *  If the alert engine of the handle drains the alert response address
+ *  (see SMB2API_AlertEngineStart), a signal is shared instead, so any
+ *  number of alert callbacks can be installed.
+ *
+ *  Without alert engine the callback is called in signal context. The
+ *  interrupted thread may own the bus, so SMB2_API calls of the callback
+ *  are passed directly to the driver, without bus arbitration,
+ *  priority classes, deadlines and statistics.
+ *
  *---------------------------------------------------------------------------
  *  \param     smbHdl	  \IN SMB handle
  *	\param     addr		  \IN device address
@@ -945,21 +2042,25 @@ int32 __MAPILIB SMB2API_AlertCbInstall(
 	void (*cbFuncP)( void *cbArg ),
 	void		*cbArgP )
 {
-	u_int32		sigCode = 0, si;
-	SMB_HANDLE	*h = (SMB_HANDLE*)smbHdl;
+	u_int32		sigCode;
+	int32		rv;
+
+	API_ENTRY( smbHdl );
+
+	/* alerts of clones are installed by the parent */
+	smbHdl = (void*)HdlRoot( smbHdl );
 
 	/* get a free signal to use */
-	for( si=0; si<NBR_OF_SIG; si++ ){
-		if( h->signal[si].condition == SIG_FREE ){
-			h->signal[si].condition = SIG_USED;
-			sigCode = h->signal[si].sigCode;
-			break;
-		}
-	}
-	if( si == NBR_OF_SIG )
-		return (SMB_ERR_ALERT_NOSIG);
+	if( (rv = AlertSigAlloc( (SMB_HANDLE*)smbHdl, &sigCode )) )
+		API_RETURN( smbHdl, rv );
+
+	rv = SMB2API_AlertCbInstallSig( smbHdl, addr, cbFuncP, cbArgP, sigCode );
+
+	/* release the signal on failure */
+	if( rv )
+		AlertSigFree( (SMB_HANDLE*)smbHdl, sigCode );
 
-	return SMB2API_AlertCbInstallSig( smbHdl, addr, cbFuncP, cbArgP, sigCode );
+	API_RETURN( smbHdl, rv );
 }
 
 /****************************************************************************/
@@ -968,6 +2069,13 @@ int32 __MAPILIB SMB2API_AlertCbInstall(
  *  The alert callback function will be invoked if the specified SMBus device
  *  reports an alert.
  *
+ *  Several addresses may use the same \a sigCode. The alert engine
+ *  (see SMB2API_AlertEngineStart) then demultiplexes the shared signal:
+ *  with #SMB2API_ALERT_ARA_DRAIN by the addresses read from the alert
+ *  response address, otherwise all addresses of the signal are treated
+ *  as alerting. Without alert engine, only the callback installed first
+ *  for the signal is invoked.
+ *
  *---------------------------------------------------------------------------
  *  \param     smbHdl	  \IN SMB handle
  *	\param     addr		  \IN device address
@@ -989,212 +2097,5314 @@ int32 __MAPILIB SMB2API_AlertCbInstallSig(
 	u_int32		sigCode )
 {
 	ALERT_NODE	*alertNode;
-	SMB2_ALERT	alertCtrl;
-	int32 rv;
 
-	/* list empty (first alert)? */
-	alertNode = (ALERT_NODE*)G_alertList.head;
-	if( !alertNode->n.next ){
+	API_ENTRY( smbHdl );
 
-		/* install signal handler */
-		if( UOS_SigInit(SigHandler) ){
-			return (SMB_ERR_ALERT_INSTALL);
-		}
-	}
-
-	/* install signal */
-	if( (rv = UOS_SigInstall(sigCode)) ){
-		printf("rv=0x%x\n", rv);
-		if( !alertNode->n.next )
-			UOS_SigExit();
-		return (SMB_ERR_ALERT_INSTALL);
-	}
-
-	/* install alert callback */
-	alertCtrl.addr = addr;
-	alertCtrl.sigCode = sigCode;
-	DO_BLK_SETSTAT( alertCtrl, SMB2_BLK_ALERT_CB_INSTALL );
-	if( rv ){
-		UOS_SigRemove( sigCode );
-		if( !alertNode->n.next )
-			UOS_SigExit();
-		return rv;
-	}
+	/* alerts of clones are installed by the parent */
+	smbHdl = (void*)HdlRoot( smbHdl );
 
 	/* create new alert node */
-	if( !(alertNode = (ALERT_NODE*)malloc( sizeof(ALERT_NODE) )) ){
-		DO_BLK_SETSTAT( alertCtrl, SMB2_BLK_ALERT_CB_REMOVE );
-		UOS_SigRemove( sigCode );
-		if( !alertNode->n.next )
-			UOS_SigExit();
-		return (SMB_ERR_NO_MEM);
-	}
+	if( !(alertNode = (ALERT_NODE*)MemAlloc( sizeof(ALERT_NODE) )) )
+		API_RETURN( smbHdl, SMB_ERR_NO_MEM );
 
 	/* init node */
+	zeroOut( (int8*)alertNode, sizeof(ALERT_NODE) );
+	alertNode->h = (SMB_HANDLE*)smbHdl;
 	alertNode->addr = addr;
 	alertNode->cbFunc = cbFuncP;
 	alertNode->cbArg = cbArgP;
 	alertNode->sigCode = sigCode;
 
-	/* add node to the list */
-	UOS_DL_AddTail( &G_alertList, &alertNode->n );
-
-	return 0;
+	API_RETURN( smbHdl, AlertNodeInstall( smbHdl, alertNode ) );
 }
 
 /****************************************************************************/
-/** Remove alert callback function
+/** Install extended alert callback function
+ *
+ *  The extended alert callback function gets the alert information
+ *  (see #SMB2API_ALERT_INFO): address, number of coalesced alerts,
+ *  timestamps, the data returned by the alert response address and
+ *  optionally the content of a status register of the device.
+ *
+ *  The status register (\a preReadP) is read by the alert engine (see
+ *  SMB2API_AlertEngineStart) when the alert is detected. The reads of
+ *  the alert response address and the status registers of a wakeup are
+ *  done within one bus ownership, so no other transaction comes between
+ *  alert detection and status read. A status register can only be
+ *  installed while the engine of the handle runs (else
+ *  #SMB_ERR_NOT_SUPPORTED).
+ *
+ *  Without alert engine, the callback is invoked in the context of the
+ *  signal (count=1, no alert response data, no status register: the
+ *  bus may be owned by the interrupted thread).
  *
  *---------------------------------------------------------------------------
  *  \param     smbHdl	  \IN SMB handle
  *	\param     addr		  \IN device address
- *	\param     cbArgP	  \OUT argument for alert callback function
+ *	\param     cbFuncExP  \IN extended alert callback function to install
+ *	\param     cbArgP	  \IN argument for alert callback function
+ *	\param     preReadP	  \IN status register to read on alert or NULL,
+ *						   size #SMB_ACC_BYTE, #SMB_ACC_BYTE_DATA or
+ *						   #SMB_ACC_WORD_DATA
+ *	\param     sigCode	  \IN UOS library conform signal code or
+ *						   0 (use a free UOS_SIG_USRx signal)
  *
  *  \return    0 | error code
  *
- *  \sa SMB2API_AlertCbInstall
- *  \sa SMB2API_AlertCbInstallSig
+ *  \sa SMB2API_AlertCbRemove
  *
  ****************************************************************************/
-int32 __MAPILIB SMB2API_AlertCbRemove(
+int32 __MAPILIB SMB2API_AlertCbInstallEx(
 	void		*smbHdl,
 	u_int16		addr,
-	void		**cbArgP )
+	void (*cbFuncExP)( void *cbArg, const SMB2API_ALERT_INFO *infoP ),
+	void		*cbArgP,
+	const SMB2API_ALERT_PREREAD *preReadP,
+	u_int32		sigCode )
 {
-	ALERT_NODE	*alertNode;
+	ALERT_NODE		*alertNode;
+	const OP_DESC	*op;
+	u_int32			sigAlloc = 0;
+	int32			rv;
 
-	if( (alertNode = AlertFindByAddr( addr )) ){
-		*cbArgP = alertNode->cbArg;
-		return AlertRemove( smbHdl, alertNode );
+	API_ENTRY( smbHdl );
+
+	if( !smbHdl || !cbFuncExP )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	/* alerts of clones are installed by the parent */
+	smbHdl = (void*)HdlRoot( smbHdl );
+
+	/* status register: byte/word reads without input data only */
+	if( preReadP && preReadP->size &&
+		(!(op = OpFind( SMB_READ, preReadP->size )) ||
+		 (op->dir & OP_DIR_IN) || (op->dataKind == OP_DATA_BLOCK)) )
+		API_RETURN( smbHdl, SMB_ERR_NOT_SUPPORTED );
+
+	/* status register is read by the engine thread only */
+	if( preReadP && preReadP->size && !((SMB_HANDLE*)smbHdl)->alertEng )
+		API_RETURN( smbHdl, SMB_ERR_NOT_SUPPORTED );
+
+	/* get a free signal to use */
+	if( !sigCode ){
+		if( (rv = AlertSigAlloc( (SMB_HANDLE*)smbHdl, &sigCode )) )
+			API_RETURN( smbHdl, rv );
+		sigAlloc = 1;
 	}
 
-	/* alert node not found */
-	return (SMB_ERR_PARAM);
-}
+	/* create new alert node */
+	if( !(alertNode = (ALERT_NODE*)MemAlloc( sizeof(ALERT_NODE) )) ){
+		rv = SMB_ERR_NO_MEM;
+	}
+	else {
+		zeroOut( (int8*)alertNode, sizeof(ALERT_NODE) );
+		alertNode->h = (SMB_HANDLE*)smbHdl;
+		alertNode->addr = addr;
+		alertNode->cbFuncEx = cbFuncExP;
+		alertNode->cbArg = cbArgP;
+		alertNode->sigCode = sigCode;
+		if( preReadP ){
+			alertNode->preCmd = preReadP->cmdAddr;
+			alertNode->preSize = preReadP->size;
+		}
 
-/*! @} */
+		rv = AlertNodeInstall( smbHdl, alertNode );
+	}
 
-/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
- *
- * Zero out data storage
- */
-static void zeroOut( int8 *p, int32 size ){
-	while( size-- )
-		*p++ = 0;
+	/* release the signal on failure */
+	if( rv && sigAlloc )
+		AlertSigFree( (SMB_HANDLE*)smbHdl, sigCode );
+
+	API_RETURN( smbHdl, rv );
 }
 
 /* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
  *
- * Remove specified alert node
+ * Install signal and alert callback of alert node (freed on failure)
  */
-static int32 AlertRemove(
-	void		*smbHdl,
-	ALERT_NODE	*alertNode )
+static int32 AlertNodeInstall( void *smbHdl, ALERT_NODE *alertNode )
 {
-	SMB_HANDLE	*h = (SMB_HANDLE*)smbHdl;
 	SMB2_ALERT	alertCtrl;
+	u_int32		sigCode = alertNode->sigCode, sigNodes;
 	int32		rv;
-	u_int32		si;
-
-	/* remove alert callback */
-	alertCtrl.addr = alertNode->addr;
-	alertCtrl.sigCode = alertNode->sigCode;
-	DO_BLK_SETSTAT( alertCtrl, SMB2_BLK_ALERT_CB_REMOVE );
-	if( rv )
-		return rv;
 
-	/* remove signal */
-	if( UOS_SigRemove( alertNode->sigCode ) ){
-		return (SMB_ERR_ALERT_INSTALL);
+	/* no signal: alerts polled by the alert engine */
+	if( !sigCode ){
+		AlertLock();
+		UOS_DL_AddTail( &G_alertList, &alertNode->n );
+		AlertUnlock();
+		return 0;
 	}
 
-	/* scan the list */
-	for( si=0; si<NBR_OF_SIG; si++ ){
-		/* signal from array? */
-		if( h->signal[si].sigCode == alertNode->sigCode ){
-			h->signal[si].condition = SIG_FREE;
-			break;
-		}
+	/* first alert: install signal handler */
+	AlertLock();
+	if( !G_sigUsers && UOS_SigInit(SigHandler) ){
+		AlertUnlock();
+		MemFree( alertNode );
+		return (SMB_ERR_ALERT_INSTALL);
 	}
+	G_sigUsers++;
 
-	/* remove node from the list */
-	UOS_DL_Remove( &alertNode->n );
-
-	/* free the node */
-	free( alertNode );
+	/* signal shared with other alerts: demultiplexed by the alert engine */
+	if( (sigNodes = AlertSigNodes( sigCode, 1 )) )
+		alertNode->muxed = 1;
 
-	/* list empty (last alert)? */
-	alertNode = (ALERT_NODE*)G_alertList.head;
-	if( !alertNode->n.next ){
+	/* add node to the list (signals may arrive as soon as installed) */
+	UOS_DL_AddTail( &G_alertList, &alertNode->n );
+	AlertUnlock();
+
+	/* first alert of the signal: install signal */
+	if( !sigNodes && UOS_SigInstall(sigCode) ){
+		AlertLock();
+		UOS_DL_Remove( &alertNode->n );
+		AlertUnlock();
+		rv = SMB_ERR_ALERT_INSTALL;
+		goto ERR_EXIT;
+	}
 
-		/* terminate signal handling */
-		if( UOS_SigExit() ){
-			return (SMB_ERR_ALERT_INSTALL);
-		}
+	/* install alert callback */
+	alertCtrl.addr = alertNode->addr;
+	alertCtrl.sigCode = sigCode;
+	DO_BLK_SETSTAT( alertCtrl, SMB2_BLK_ALERT_CB_INSTALL );
+	if( rv ){
+		AlertLock();
+		UOS_DL_Remove( &alertNode->n );
+		sigNodes = AlertSigNodes( sigCode, 0 );
+		AlertUnlock();
+		if( !sigNodes )
+			UOS_SigRemove( sigCode );
+		goto ERR_EXIT;
 	}
 
 	return 0;
+
+ERR_EXIT:
+	/* last alert: terminate signal handling */
+	AlertLock();
+	if( !--G_sigUsers )
+		UOS_SigExit();
+	AlertUnlock();
+	MemFree( alertNode );
+	return rv;
 }
 
-/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+/****************************************************************************/
+/** Remove alert callback function
  *
- * Return alert node for address or NULL if not found
- */
-static ALERT_NODE* AlertFindByAddr( u_int16 addr )
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	  \IN SMB handle
+ *	\param     addr		  \IN device address
+ *	\param     cbArgP	  \OUT argument for alert callback function
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_AlertCbInstall
+ *  \sa SMB2API_AlertCbInstallSig
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_AlertCbRemove(
+	void		*smbHdl,
+	u_int16		addr,
+	void		**cbArgP )
 {
 	ALERT_NODE	*alertNode;
 
-	/* scan the list */
-	for( alertNode=(ALERT_NODE*)G_alertList.head;
-         alertNode->n.next;
-         alertNode = (ALERT_NODE*)alertNode->n.next ){
+	API_ENTRY( smbHdl );
 
-		/* alert node for specified addr? */
-		if( alertNode->addr == addr )
-			return alertNode;
+	/* alerts of clones are installed by the parent */
+	smbHdl = (void*)HdlRoot( smbHdl );
+
+	/* take the node from the list (no further callbacks) */
+	AlertLock();
+	if( (alertNode = AlertFindByAddr( (SMB_HANDLE*)smbHdl, addr )) )
+		UOS_DL_Remove( &alertNode->n );
+	AlertUnlock();
+
+	if( alertNode ){
+		*cbArgP = alertNode->cbArg;
+		API_RETURN( smbHdl, AlertRemove( smbHdl, alertNode ) );
 	}
 
 	/* alert node not found */
-	return NULL;
+	API_RETURN( smbHdl, SMB_ERR_PARAM );
 }
 
-/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+/****************************************************************************/
+/** Prepare a transaction for repeated execution
  *
- * Return alert node for signal code or NULL if not found
- */
-static ALERT_NODE* AlertFindBySig( u_int32 sigCode )
+ *  The access is validated and the transfer object is pre-filled once.
+ *  SMB2API_PrepExec() then only copies the data and executes the
+ *  transaction. Note that the execution is not a bare driver call: it
+ *  takes the same path as the single read/write functions (bus
+ *  arbitration, statistics and, if enabled on the handle, presence
+ *  cache, rate limits, recording and routing). The saving is the
+ *  validation and the setup of the transfer object.
+ *
+ *  The data buffer layout is the one of SMB2API_SmbXfer():
+ *  - byte accesses: dataP[0]
+ *  - word accesses: *(u_int16*)dataP
+ *  - block accesses: dataP[0] = length, dataP[1..] = data
+ *
+ *  A prepared transaction must not be executed by several threads at
+ *  the same time.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     flags		\IN flags, see \ref _SMB2_FLAG
+ *	\param     addr			\IN device address
+ *	\param     readWrite	\IN access to perform ( #SMB_READ or #SMB_WRITE )
+ *	\param     cmdAddr		\IN device command or index value
+ *	\param     size			\IN size of data access (SMB_ACC_XXX)
+ *	\param     prepHdlP		\OUT prepared transaction handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PrepExec, SMB2API_PrepFree
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_Prepare(
+	void		*smbHdl,
+	u_int32		flags,
+	u_int16		addr,
+	u_int8		readWrite,
+	u_int8		cmdAddr,
+	u_int8		size,
+	void		**prepHdlP )
 {
-	ALERT_NODE	*alertNode;
+	const OP_DESC	*op;
+	PREP_TRX		*p;
 
-	/* scan the list */
-	for( alertNode=(ALERT_NODE*)G_alertList.head;
-         alertNode->n.next;
-         alertNode = (ALERT_NODE*)alertNode->n.next ){
+	API_ENTRY( smbHdl );
 
-		/* alert node for specified addr? */
-		if( alertNode->sigCode == sigCode )
-			return alertNode;
-	}
+	*prepHdlP = NULL;
 
-	/* alert node not found */
-	return NULL;
+	if( !smbHdl )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	if( !(op = OpFind( readWrite, size )) )
+		API_RETURN( smbHdl, SMB_ERR_NOT_SUPPORTED );
+
+	if( !(p = (PREP_TRX*)MemAlloc( sizeof(PREP_TRX) )) )
+		API_RETURN( smbHdl, SMB_ERR_NO_MEM );
+
+	p->h = (SMB_HANDLE*)smbHdl;
+	p->op = op;
+	p->flags = flags;
+	OpInit( op, flags, addr, readWrite, cmdAddr, &p->t, &p->blk );
+
+	*prepHdlP = (void*)p;
+	API_RETURN( smbHdl, 0 );
 }
 
-/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+/****************************************************************************/
+/** Execute a prepared transaction
  *
- * Call alert callback function for signal code
- */
-static void __MAPILIB SigHandler(u_int32 sigCode)
+ *---------------------------------------------------------------------------
+ *  \param     prepHdl		\IN prepared transaction handle
+ *	\param     dataP		\INOUT data to write / read data
+ *							(see SMB2API_Prepare for the layout)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_Prepare
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PrepExec( void *prepHdl, u_int8 *dataP )
 {
-	ALERT_NODE	*alertNode;
+	PREP_TRX	*p = (PREP_TRX*)prepHdl;
+	int32		rv;
 
-	alertNode = AlertFindBySig( sigCode );
+	API_ENTRY( prepHdl );
 
-	if( alertNode ){
-		alertNode->cbFunc( alertNode->cbArg );
+	if( !p || !dataP )
+		API_RETURN( prepHdl, SMB_ERR_PARAM );
+
+	if( (rv = OpDataIn( p->op, (void*)&p->t, dataP )) )
+		API_RETURN( prepHdl, rv );
+
+	if( (rv = TrxExec( p->h, p->op->code, p->op->isGet, &p->blk, p->flags )) )
+		API_RETURN( prepHdl, rv );
+
+	OpDataOut( p->op, (void*)&p->t, dataP );
+
+	API_RETURN( prepHdl, 0 );
+}
+
+/****************************************************************************/
+/** Free a prepared transaction
+ *
+ *  *prepHdlP will be set to NULL.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     prepHdlP		\INOUT pointer to prepared transaction handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_Prepare
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PrepFree( void **prepHdlP )
+{
+	API_ENTRY( NULL );
+
+	if( *prepHdlP ){
+		MemFree( *prepHdlP );
+		*prepHdlP = NULL;
 	}
+
+	API_RETURN( NULL, 0 );
 }
 
+/****************************************************************************/
+/** Group prepared transactions into a prepared batch
+ *
+ *  All transactions must belong to the same SMB handle. The batch refers
+ *  to the prepared transactions, they must not be freed before the batch.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     prepHdl		\IN array of prepared transaction handles
+ *	\param     num			\IN number of entries in prepHdl
+ *	\param     batchHdlP	\OUT prepared batch handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PrepBatchExec, SMB2API_PrepBatchFree
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PrepBatchCreate(
+	void		*prepHdl[],
+	u_int32		num,
+	void		**batchHdlP )
+{
+	PREP_BATCH	*b;
+	u_int32		n, size;
+
+	API_ENTRY( prepHdl );
+
+	*batchHdlP = NULL;
+
+	if( num < 1 )
+		API_RETURN( prepHdl, SMB_ERR_PARAM );
+
+	for( n=0; n<num; n++ ){
+		if( !prepHdl[n] ||
+			((PREP_TRX*)prepHdl[n])->h != ((PREP_TRX*)prepHdl[0])->h )
+			API_RETURN( prepHdl, SMB_ERR_PARAM );
+	}
+
+	size = sizeof(PREP_BATCH) + (num - 1) * sizeof(PREP_TRX*);
+	if( !(b = (PREP_BATCH*)MemAlloc( size )) )
+		API_RETURN( prepHdl, SMB_ERR_NO_MEM );
+
+	b->num = num;
+	for( n=0; n<num; n++ )
+		b->prep[n] = (PREP_TRX*)prepHdl[n];
+
+	*batchHdlP = (void*)b;
+	API_RETURN( prepHdl, 0 );
+}
+
+/****************************************************************************/
+/** Execute a prepared batch
+ *
+ *  The transactions are executed in the order of creation. Execution
+ *  stops at the first failing transaction.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     batchHdl		\IN prepared batch handle
+ *	\param     dataP		\INOUT data buffer per transaction
+ *							(see SMB2API_Prepare for the layout)
+ *	\param     errIdxP		\OUT index of failed transaction or number
+ *							of transactions if all succeeded (may be NULL)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PrepBatchCreate
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PrepBatchExec(
+	void		*batchHdl,
+	u_int8		*dataP[],
+	u_int32		*errIdxP )
+{
+	PREP_BATCH	*b = (PREP_BATCH*)batchHdl;
+	int32		rv = 0;
+	u_int32		n;
+
+	API_ENTRY( batchHdl );
+
+	if( !b || !dataP )
+		API_RETURN( batchHdl, SMB_ERR_PARAM );
+
+	for( n=0; n<b->num; n++ ){
+		if( (rv = SMB2API_PrepExec( (void*)b->prep[n], dataP[n] )) )
+			break;
+	}
+
+	if( errIdxP )
+		*errIdxP = n;
+
+	API_RETURN( batchHdl, rv );
+}
+
+/****************************************************************************/
+/** Free a prepared batch
+ *
+ *  The prepared transactions of the batch are not freed.
+ *  *batchHdlP will be set to NULL.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     batchHdlP	\INOUT pointer to prepared batch handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PrepBatchCreate
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PrepBatchFree( void **batchHdlP )
+{
+	API_ENTRY( NULL );
+
+	if( *batchHdlP ){
+		MemFree( *batchHdlP );
+		*batchHdlP = NULL;
+	}
+
+	API_RETURN( NULL, 0 );
+}
+
+/****************************************************************************/
+/** Read the same register from many devices
+ *
+ *  The read access \a size to \a cmdAddr is executed for each address of
+ *  \a addr[]. The transfer object is built once, only the address is
+ *  changed per device.
+ *
+ *  The results are stored densely into \a dataP, element n at
+ *  dataP + n * SMB2API_GATHER_STRIDE(size), in the data buffer layout of
+ *  SMB2API_SmbXfer():
+ *  - #SMB_ACC_BYTE, #SMB_ACC_BYTE_DATA: u_int8
+ *  - #SMB_ACC_WORD_DATA: u_int16
+ *  - #SMB_ACC_BLOCK_DATA: length byte + #SMB_BLOCK_MAX_BYTES data bytes
+ *
+ *  The elements of failed devices are zeroed. With presence cache (see
+ *  SMB2API_PresCacheSet), devices known to be absent are skipped with
+ *  the cached error (no bus access), unless #SMB2API_FLAG_RESCAN is set.
+ *
+ *  The bus is owned for the whole list, other transactions are served
+ *  after the last device. The priority class is taken from \a flags or
+ *  the thread default (see SMB2API_PrioSet). Rate limited devices are
+ *  waited for before the bus is owned (see SMB2API_RateSet).
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     flags		\IN flags, see \ref _SMB2_FLAG
+ *	\param     addr			\IN device addresses
+ *	\param     num			\IN number of devices
+ *	\param     cmdAddr		\IN device command or index value
+ *	\param     size			\IN size of data access (SMB_ACC_XXX)
+ *	\param     dataP		\OUT num results (see above)
+ *	\param     statusP		\OUT num status codes (0 or error code)
+ *
+ *  \return    0 | error code (status of the devices in statusP)
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_GatherRead(
+	void			*smbHdl,
+	u_int32			flags,
+	const u_int16	addr[],
+	u_int32			num,
+	u_int8			cmdAddr,
+	u_int8			size,
+	u_int8			*dataP,
+	int32			statusP[] )
+{
+	SMB_HANDLE		*h = (SMB_HANDLE*)smbHdl;
+	const OP_DESC	*op;
+	u_int32			n, stride, prio, own = !G_tlsArbDepth;
+	u_int8			*d;
+	int32			rv;
+	union
+	{
+		SMB2_TRANSFER		trx;
+		SMB2_TRANSFER_BLOCK	trxBlk;
+	}tmpl, t;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || (num && (!addr || !dataP || !statusP)) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	/* reads without input data only */
+	if( !(op = OpFind( SMB_READ, size )) || (op->dir & OP_DIR_IN) )
+		API_RETURN( smbHdl, SMB_ERR_NOT_SUPPORTED );
+
+	stride = SMB2API_GATHER_STRIDE( size );
+
+	/* build transfer object */
+	zeroOut( (int8*)&tmpl, sizeof(tmpl) );
+	if( op->dataKind == OP_DATA_BLOCK ){
+		tmpl.trxBlk.flags = flags;
+		tmpl.trxBlk.cmdAddr = cmdAddr;
+	}
+	else {
+		tmpl.trx.flags = flags;
+		tmpl.trx.readWrite = SMB_READ;
+		tmpl.trx.cmdAddr = cmdAddr;
+	}
+
+	prio = (flags & SMB2API_FLAG_PRIO_MASK) >> SMB2API_FLAG_PRIO_SHIFT;
+	prio = prio ? prio - 1 : G_tlsPrio;
+
+	/* rate limited devices: wait before the bus is owned */
+	for( n=0; own && h->root->rate && (n < num); n++ ){
+		if( (rv = RateWait( h->root, addr[n], NULL )) )
+			API_RETURN( smbHdl, rv );
+	}
+
+	/* own the bus for the whole list (unless owned already) */
+	if( (rv = ArbHold( h, prio )) )
+		API_RETURN( smbHdl, rv );
+
+	/* devices known to be absent are skipped by TrxArb */
+	for( n=0, d=dataP; n<num; n++, d+=stride ){
+		zeroOut( (int8*)d, stride );
+
+		t = tmpl;
+		if( op->dataKind == OP_DATA_BLOCK )
+			t.trxBlk.addr = addr[n];
+		else
+			t.trx.addr = addr[n];
+
+		rv = BlkStat( h, op->code, op->isGet, (void*)&t,
+					  op->dataKind == OP_DATA_BLOCK ?
+					  sizeof(SMB2_TRANSFER_BLOCK) : sizeof(SMB2_TRANSFER) );
+
+		if( !rv )
+			OpDataOut( op, (void*)&t, d );
+		statusP[n] = rv;
+	}
+
+	ArbUnhold( h );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Own the bus for several transactions (library internal)
+ *
+ *  Takes the bus of \a smbHdl like SMB2API_GatherRead() does for its
+ *  list: the following transactions of the calling thread through
+ *  \a smbHdl are executed without arbitration (recorded and counted
+ *  like any other) until SMB2API_BusRelease(). Used by modules of the
+ *  library for sequences that must not be interrupted by other threads,
+ *  clones of the same handle or broker clients, e.g. PMBus PAGE write
+ *  and the reads of the page.
+ *
+ *  Calls may be nested, the bus is released by the outermost
+ *  SMB2API_BusRelease(). Only the outermost call waits for the rate
+ *  limit of \a addr (\a num transactions) and, for
+ *  #SMB2API_PRIO_LOW, for the bus utilization target.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	  \IN SMB handle
+ *	\param     flags      \IN flags, see \ref _SMB2_FLAG (priority class)
+ *	\param     addr	      \IN device address of the transactions
+ *	\param     num	      \IN number of transactions
+ *
+ *  \return    0 (bus owned) | error code
+ *
+ *  \sa SMB2API_BusRelease
+ *
+ ****************************************************************************/
+int32 SMB2API_BusHold(
+	void		*smbHdl,
+	u_int32		flags,
+	u_int16		addr,
+	u_int32		num )
+{
+	SMB_HANDLE	*h = (SMB_HANDLE*)smbHdl;
+	u_int32		n, prio;
+	int32		rv;
+
+	if( !h )
+		return (SMB_ERR_PARAM);
+
+	prio = (flags & SMB2API_FLAG_PRIO_MASK) >> SMB2API_FLAG_PRIO_SHIFT;
+	prio = prio ? prio - 1 : G_tlsPrio;
+
+	/* rate limited device: wait before the bus is owned */
+	for( n=0; !G_tlsArbDepth && h->root->rate && (n < num); n++ ){
+		if( (rv = RateWait( h->root, addr, NULL )) )
+			return rv;
+	}
+
+	return ArbHold( h, prio );
+}
+
+/****************************************************************************/
+/** Release the bus owned by SMB2API_BusHold() (library internal)
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	  \IN SMB handle passed to SMB2API_BusHold()
+ *
+ ****************************************************************************/
+void SMB2API_BusRelease( void *smbHdl )
+{
+	ArbUnhold( (SMB_HANDLE*)smbHdl );
+}
+
+/****************************************************************************/
+/** Read the registers of a device into a snapshot
+ *
+ *  With #SMB2API_SNAP_SEQ the registers are read with one sequential I2C
+ *  read (register pointer write + read of \a num bytes). The device must
+ *  increment its register pointer on each byte. Without this flag, with
+ *  driver flags (e.g. PEC) or if the controller does not support I2C
+ *  transfers, the registers are read with SMB2API_ReadByteData().
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     flags		\IN flags, see \ref _SMB2_FLAG
+ *	\param     addr			\IN device address
+ *	\param     mode			\IN SMB2API_SNAP_XXX flags
+ *	\param     first		\IN first register
+ *	\param     num			\IN number of registers (first + num <=
+ *							#SMB2API_SNAP_REG_NUM)
+ *	\param     dataP		\OUT num register values
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_SnapRestore
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_SnapRead(
+	void		*smbHdl,
+	u_int32		flags,
+	u_int16		addr,
+	u_int32		mode,
+	u_int8		first,
+	u_int32		num,
+	u_int8		*dataP )
+{
+	SMB_HANDLE	*h = (SMB_HANDLE*)smbHdl;
+	u_int32		n;
+	int32		rv;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || !dataP || (first + num > SMB2API_SNAP_REG_NUM) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	if( !num )
+		API_RETURN( smbHdl, 0 );
+
+	if( (mode & SMB2API_SNAP_SEQ) && !(flags & ~SMB2API_FLAG_LIB_MASK) ){
+		rv = MemSeq( h, flags, addr, first, 1, dataP, num, 1 );
+		if( rv != SMB_ERR_NOT_SUPPORTED )
+			API_RETURN( smbHdl, rv );
+	}
+
+	for( n=0; n<num; n++ ){
+		if( (rv = SMB2API_ReadByteData( smbHdl, flags, addr,
+										(u_int8)(first + n), &dataP[n] )) )
+			API_RETURN( smbHdl, rv );
+	}
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Restore the registers of a device from a snapshot
+ *
+ *  The current register contents are read (see SMB2API_SnapRead) and
+ *  only the differing registers are written. With #SMB2API_SNAP_SEQ,
+ *  differences separated by at most two equal registers are merged and
+ *  each range is written with one sequential I2C write, otherwise the
+ *  registers are written with SMB2API_WriteByteData().
+ *
+ *  Devices with write pages or write cycle times (e.g. EEPROMs) must be
+ *  restored without #SMB2API_SNAP_SEQ.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     flags		\IN flags, see \ref _SMB2_FLAG
+ *	\param     addr			\IN device address
+ *	\param     mode			\IN SMB2API_SNAP_XXX flags
+ *	\param     first		\IN first register
+ *	\param     num			\IN number of registers (first + num <=
+ *							#SMB2API_SNAP_REG_NUM)
+ *	\param     dataP		\IN num register values (snapshot)
+ *	\param     writtenP		\OUT number of written registers (may be NULL)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_SnapRead
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_SnapRestore(
+	void			*smbHdl,
+	u_int32			flags,
+	u_int16			addr,
+	u_int32			mode,
+	u_int8			first,
+	u_int32			num,
+	const u_int8	*dataP,
+	u_int32			*writtenP )
+{
+	SMB_HANDLE	*h = (SMB_HANDLE*)smbHdl;
+	u_int8		cur[SMB2API_SNAP_REG_NUM];
+	u_int32		n, end, i, seq, written = 0;
+	int32		rv;
+
+	API_ENTRY( smbHdl );
+
+	if( writtenP )
+		*writtenP = 0;
+
+	if( !h || !dataP || (first + num > SMB2API_SNAP_REG_NUM) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	if( (rv = SMB2API_SnapRead( smbHdl, flags, addr, mode, first, num, cur )) )
+		API_RETURN( smbHdl, rv );
+
+	seq = (mode & SMB2API_SNAP_SEQ) && !(flags & ~SMB2API_FLAG_LIB_MASK);
+
+	for( n=0; n<num; n=end ){
+		if( cur[n] == dataP[n] ){
+			end = n + 1;
+			continue;
+		}
+
+		/* differing range [n,end) incl. small gaps of equal registers */
+		end = n + 1;
+		if( seq ){
+			for( i=end; (i < num) && (i - end <= SNAP_GAP_MAX); i++ ){
+				if( cur[i] != dataP[i] )
+					end = i + 1;
+			}
+			rv = MemSeq( h, flags, addr, first + n, 1,
+						 (u_int8*)&dataP[n], end - n, 0 );
+			/* no I2C transfers: write the remaining registers bytewise */
+			if( rv == SMB_ERR_NOT_SUPPORTED ){
+				seq = 0;
+				end = n;
+				continue;
+			}
+		}
+		else
+			rv = SMB2API_WriteByteData( smbHdl, flags, addr,
+										(u_int8)(first + n), dataP[n] );
+		if( rv )
+			break;
+
+		written += end - n;
+	}
+
+	if( writtenP )
+		*writtenP = written;
+
+	API_RETURN( smbHdl, rv );
+}
+
+/****************************************************************************/
+/** Read from an I2C memory (EEPROM, flash)
+ *
+ *  The data is read with sequential I2C reads of up to 256 bytes, each
+ *  after a write of the memory address.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     flags		\IN library flags, see \ref _SMB2API_FLAG
+ *	\param     addr			\IN device address
+ *	\param     mode			\IN SMB2API_MEM_XXX flags
+ *	\param     memAddr		\IN memory address
+ *	\param     dataP		\OUT read data
+ *	\param     len			\IN number of bytes
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_MemWrite
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_MemRead(
+	void		*smbHdl,
+	u_int32		flags,
+	u_int16		addr,
+	u_int32		mode,
+	u_int32		memAddr,
+	u_int8		*dataP,
+	u_int32		len )
+{
+	u_int32	addrLen = (mode & SMB2API_MEM_ADDR16) ? 2 : 1, off, n;
+	int32	rv;
+
+	API_ENTRY( smbHdl );
+
+	if( !smbHdl || !dataP )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+	if( (rv = MemCheck( mode, memAddr, len )) )
+		API_RETURN( smbHdl, rv );
+
+	for( off=0; off<len; off+=n ){
+		n = len - off < MEM_SEQ_MAX ? len - off : MEM_SEQ_MAX;
+		if( (rv = MemSeq( (SMB_HANDLE*)smbHdl, flags, addr, memAddr + off,
+						  addrLen, dataP + off, n, 1 )) )
+			API_RETURN( smbHdl, rv );
+	}
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Write to an I2C memory (EEPROM, flash)
+ *
+ *  The data is written in pages of \a pageSize bytes (write messages do
+ *  not cross page boundaries). After each page the device is polled
+ *  until it acknowledges again (end of the write cycle, max. 20ms).
+ *
+ *  With #SMB2API_MEM_VERIFY the written range is read back and compared
+ *  chunk by chunk (one page each) by CRC-32, see SMB2API_MemVerify().
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     flags		\IN library flags, see \ref _SMB2API_FLAG
+ *	\param     addr			\IN device address
+ *	\param     mode			\IN SMB2API_MEM_XXX flags
+ *	\param     memAddr		\IN memory address
+ *	\param     dataP		\IN data to write
+ *	\param     len			\IN number of bytes
+ *	\param     pageSize		\IN page size of the device (1..256)
+ *	\param     errOffP		\OUT offset of the failed page/chunk or
+ *							\a len if all succeeded (may be NULL)
+ *
+ *  \return    0 | error code | #SMB2API_ERR_VERIFY
+ *
+ *  \sa SMB2API_MemRead, SMB2API_MemVerify
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_MemWrite(
+	void			*smbHdl,
+	u_int32			flags,
+	u_int16			addr,
+	u_int32			mode,
+	u_int32			memAddr,
+	const u_int8	*dataP,
+	u_int32			len,
+	u_int32			pageSize,
+	u_int32			*errOffP )
+{
+	SMB_HANDLE	*h = (SMB_HANDLE*)smbHdl;
+	u_int32		addrLen = (mode & SMB2API_MEM_ADDR16) ? 2 : 1, off, n, t;
+	int32		rv;
+
+	API_ENTRY( smbHdl );
+
+	if( errOffP )
+		*errOffP = 0;
+
+	if( !h || !dataP || (pageSize < 1) || (pageSize > MEM_SEQ_MAX) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+	if( (rv = MemCheck( mode, memAddr, len )) )
+		API_RETURN( smbHdl, rv );
+
+	for( off=0; off<len; off+=n ){
+		n = pageSize - ((memAddr + off) % pageSize);
+		if( n > len - off )
+			n = len - off;
+
+		if( (rv = MemSeq( h, flags, addr, memAddr + off, addrLen,
+						  (u_int8*)(dataP + off), n, 0 )) )
+			goto DONE;
+
+		/* acknowledge polling: no response during the write cycle */
+		t = TimeUsec();
+		while( (rv = MemSeq( h, flags, addr, memAddr + off, addrLen,
+							 NULL, 0, 1 )) ){
+			if( TimeUsec() - t > MEM_WRITE_TMO_US )
+				goto DONE;
+			UOS_Delay( 1 );
+		}
+	}
+
+	if( mode & SMB2API_MEM_VERIFY )
+		API_RETURN( smbHdl, SMB2API_MemVerify( smbHdl, flags, addr, mode,
+											   memAddr, dataP, len,
+											   pageSize, errOffP ) );
+
+DONE:
+	if( errOffP )
+		*errOffP = off;
+
+	API_RETURN( smbHdl, rv );
+}
+
+/****************************************************************************/
+/** Verify the contents of an I2C memory (EEPROM, flash)
+ *
+ *  The memory is read back in chunks of \a chunk bytes. The CRC-32 of
+ *  each chunk is compared with the CRC-32 of the source data, no
+ *  read-back copy is kept.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     flags		\IN library flags, see \ref _SMB2API_FLAG
+ *	\param     addr			\IN device address
+ *	\param     mode			\IN SMB2API_MEM_XXX flags
+ *	\param     memAddr		\IN memory address
+ *	\param     dataP		\IN expected data
+ *	\param     len			\IN number of bytes
+ *	\param     chunk		\IN bytes per chunk (1..256, 0=256)
+ *	\param     errOffP		\OUT offset of the first differing/failed
+ *							chunk or \a len if all equal (may be NULL)
+ *
+ *  \return    0 | error code | #SMB2API_ERR_VERIFY
+ *
+ *  \sa SMB2API_MemWrite, SMB2API_Crc32
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_MemVerify(
+	void			*smbHdl,
+	u_int32			flags,
+	u_int16			addr,
+	u_int32			mode,
+	u_int32			memAddr,
+	const u_int8	*dataP,
+	u_int32			len,
+	u_int32			chunk,
+	u_int32			*errOffP )
+{
+	u_int8	buf[MEM_SEQ_MAX];
+	u_int32	addrLen = (mode & SMB2API_MEM_ADDR16) ? 2 : 1, off, n;
+	int32	rv;
+
+	API_ENTRY( smbHdl );
+
+	if( errOffP )
+		*errOffP = 0;
+
+	if( !chunk )
+		chunk = MEM_SEQ_MAX;
+
+	if( !smbHdl || !dataP || (chunk > MEM_SEQ_MAX) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+	if( (rv = MemCheck( mode, memAddr, len )) )
+		API_RETURN( smbHdl, rv );
+
+	for( off=0; off<len; off+=n ){
+		n = len - off < chunk ? len - off : chunk;
+		if( (rv = MemSeq( (SMB_HANDLE*)smbHdl, flags, addr, memAddr + off,
+						  addrLen, buf, n, 1 )) )
+			break;
+		if( SMB2API_Crc32( 0, buf, n ) != SMB2API_Crc32( 0, dataP + off, n ) ){
+			rv = SMB2API_ERR_VERIFY;
+			break;
+		}
+	}
+
+	if( errOffP )
+		*errOffP = off;
+
+	API_RETURN( smbHdl, rv );
+}
+
+/****************************************************************************/
+/** Calculate CRC-32
+ *
+ *  CRC-32 of IEEE 802.3 (zlib, PNG), computed with slicing-by-8 (eight
+ *  table lookups per 8 bytes). The CRC of data in pieces is computed by
+ *  passing the result of the previous piece as \a crc.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     crc		\IN CRC of previous data (0 at start)
+ *	\param     dataP	\IN data
+ *	\param     len		\IN number of bytes
+ *
+ *  \return    CRC-32
+ *
+ ****************************************************************************/
+u_int32 __MAPILIB SMB2API_Crc32(
+	u_int32			crc,
+	const u_int8	*dataP,
+	u_int32			len )
+{
+	const u_int8	*p = dataP;
+	u_int32			a, b;
+
+	API_ENTRY( NULL );
+
+	if( !G_crcInit )
+		CrcInit();
+
+	crc = ~crc;
+
+	for( ; len >= 8; len -= 8, p += 8 ){
+		a = crc ^ ((u_int32)p[0] | ((u_int32)p[1] << 8) |
+				   ((u_int32)p[2] << 16) | ((u_int32)p[3] << 24));
+		b = (u_int32)p[4] | ((u_int32)p[5] << 8) |
+			((u_int32)p[6] << 16) | ((u_int32)p[7] << 24);
+		crc = G_crcTbl[7][a & 0xff] ^ G_crcTbl[6][(a >> 8) & 0xff] ^
+			  G_crcTbl[5][(a >> 16) & 0xff] ^ G_crcTbl[4][a >> 24] ^
+			  G_crcTbl[3][b & 0xff] ^ G_crcTbl[2][(b >> 8) & 0xff] ^
+			  G_crcTbl[1][(b >> 16) & 0xff] ^ G_crcTbl[0][b >> 24];
+	}
+
+	while( len-- )
+		crc = (crc >> 8) ^ G_crcTbl[0][(crc ^ *p++) & 0xff];
+
+	TRC4( api__return, __func__, NULL, 0, ~crc );
+	return ~crc;
+}
+
+/****************************************************************************/
+/** Set presence cache TTL of an SMB handle
+ *
+ *  Accesses to unpopulated addresses take a full NAK or timeout on the
+ *  bus. A device that fails with #SMB_ERR_ADDR or #SMB_ERR_NO_DEVICE is
+ *  known to be absent. With presence cache, further SMBus accesses to
+ *  the device fail immediately with the cached error, until
+ *  - \a ttlMs passed since the device was found absent
+ *  - an access with #SMB2API_FLAG_RESCAN succeeds
+ *  - the entry is invalidated with SMB2API_PresInvalidate()
+ *
+ *  The alert response address and SMB2API_I2CXfer() are not cached.
+ *  Without presence cache (default), no access is skipped.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	  \IN SMB handle
+ *	\param     ttlMs	  \IN time to keep devices absent [ms]
+ *						   (0=presence cache off)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PresInvalidate, SMB2API_PresStatsGet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PresCacheSet( void *smbHdl, u_int32 ttlMs )
+{
+	SMB_HANDLE *h = HdlRoot( smbHdl );
+
+	API_ENTRY( smbHdl );
+
+	if( !h || (ttlMs > 0xffffffff / 1000) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	h->presTtlUs = ttlMs * 1000;
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Invalidate presence cache entries of an SMB handle
+ *
+ *  The next access to the device(s) goes to the bus again, e.g. after a
+ *  module was plugged in.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	  \IN SMB handle
+ *	\param     addr		  \IN device address or #SMB2API_PRES_ALL
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PresCacheSet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PresInvalidate( void *smbHdl, u_int16 addr )
+{
+	SMB_HANDLE	*h = HdlRoot( smbHdl );
+	u_int32		a;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || ((addr >= PRES_ADDR_NUM) && (addr != SMB2API_PRES_ALL)) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	for( a=0; a<PRES_ADDR_NUM; a++ ){
+		if( ((addr == SMB2API_PRES_ALL) || (addr == a)) && h->pres[a].err ){
+			h->pres[a].err = 0;
+			ATOMIC_ADD( h->presStats.invalidated, 1 );
+		}
+	}
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Get presence cache statistics of an SMB handle
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	  \IN SMB handle
+ *	\param     statsP	  \OUT statistics
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PresCacheSet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PresStatsGet(
+	void				*smbHdl,
+	SMB2API_PRES_STATS	*statsP )
+{
+	SMB_HANDLE *h = HdlRoot( smbHdl );
+
+	API_ENTRY( smbHdl );
+
+	if( !h || !statsP )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	*statsP = h->presStats;
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Set routing mode of an SMB handle
+ *
+ *  The capabilities of the controller are learned from the operations:
+ *  - #SMB2API_ROUTE_NATIVE: operations are passed to the driver as
+ *    requested
+ *  - #SMB2API_ROUTE_FALLBACK: operations the controller does not support
+ *    (SMB_ERR_NOT_SUPPORTED) are emulated with I2C messages from then on
+ *  - #SMB2API_ROUTE_FASTEST: additionally the time of native and emulated
+ *    operations is measured and the faster path is used
+ *
+ *  Emulated are the byte, word, block write and process call accesses
+ *  without driver flags (e.g. PEC). The messages of an access are passed
+ *  to the driver in one I2C transfer with repeated start, no STOP in
+ *  between. Block reads and block process calls are not emulated: the
+ *  block length is not known before the read, a device would be read
+ *  beyond the block. For them only the native capability is learned.
+ *
+ *  Default is #SMB2API_ROUTE_FALLBACK for handles of SMB2API_Init(), so
+ *  callers do not get SMB_ERR_NOT_SUPPORTED for operations the
+ *  controller can do with I2C messages. Handles of SMB2API_InitBackend()
+ *  (e.g. the simulator, a broker client or playback) default to
+ *  #SMB2API_ROUTE_NATIVE: their operations are passed unchanged, a
+ *  broker routes the requests of its clients with its own handle.
+ *  Clones get the mode of their parent (see SMB2API_Clone).
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	  \IN SMB handle
+ *	\param     route	  \IN routing mode (SMB2API_ROUTE_XXX)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_CapGet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_RouteSet( void *smbHdl, u_int32 route )
+{
+	SMB_HANDLE *h = (SMB_HANDLE*)smbHdl;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || (route > SMB2API_ROUTE_FASTEST) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	h->route = route;
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Get learned capabilities of an SMBus access
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     readWrite	\IN access ( #SMB_READ or #SMB_WRITE )
+ *	\param     size			\IN size of data access (SMB_ACC_XXX)
+ *	\param     capP			\OUT capabilities
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_RouteSet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_CapGet(
+	void			*smbHdl,
+	u_int8			readWrite,
+	u_int8			size,
+	SMB2API_CAP		*capP )
+{
+	SMB_HANDLE		*h = (SMB_HANDLE*)smbHdl;
+	const OP_DESC	*op;
+	CAP				*c;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || !capP )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	if( !(op = OpFind( readWrite, size )) )
+		API_RETURN( smbHdl, SMB_ERR_NOT_SUPPORTED );
+
+	c = &h->cap[(size == SMB_ACC_BLOCK_PROC_CALL) ?
+				CAP_BLK_PROC : (u_int32)(op->code - SMB2_BLK_QUICK_COMM)];
+	capP->native = c->native;
+	capP->emulated = CapEmulOk( op->code, 0 ) ? c->emul : SMB2API_CAP_NO;
+	capP->nativeUs = c->nativeUs;
+	capP->emulatedUs = c->emulUs;
+	capP->emulatedCnt = c->emulCnt;
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Set default priority class of the calling thread
+ *
+ *  All transactions of the SMB handles are served by priority class.
+ *  A waiting transaction of a higher class gets the bus at the next
+ *  message boundary, e.g. between the messages of SMB2API_I2CXfer() or
+ *  the transactions of a prepared batch.
+ *
+ *  The class can be selected per call with SMB2API_FLAG_PRIO_XXX in the
+ *  flags parameter. Accesses without SMB2API_FLAG_PRIO_XXX (or without
+ *  flags parameter, e.g. SMB2API_I2CXfer) use the default class of the
+ *  calling thread set with this function (initially #SMB2API_PRIO_NORMAL).
+ *
+ *---------------------------------------------------------------------------
+ *  \param     prio		\IN priority class (SMB2API_PRIO_XXX)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PrioStatsGet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PrioSet( u_int32 prio )
+{
+	API_ENTRY( NULL );
+
+	if( prio >= SMB2API_PRIO_NUM )
+		API_RETURN( NULL, SMB_ERR_PARAM );
+
+	G_tlsPrio = prio;
+	API_RETURN( NULL, 0 );
+}
+
+/****************************************************************************/
+/** Get latency statistics of a priority class
+ *
+ *  The latency of a transaction is the time from the request until the
+ *  driver call returns (wait for the bus + transfer).
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	\IN SMB handle
+ *	\param     prio		\IN priority class (SMB2API_PRIO_XXX)
+ *	\param     statsP	\OUT latency statistics
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PrioStatsReset
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PrioStatsGet(
+	void				*smbHdl,
+	u_int32				prio,
+	SMB2API_PRIO_STATS	*statsP )
+{
+	SMB_HANDLE	*h = HdlRoot( smbHdl );
+	ARBITER		*a;
+	PRIO_STATS	*ps;
+	u_int32		n;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || !statsP || (prio >= SMB2API_PRIO_NUM) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	a = &h->arb;
+	ps = &a->stats[prio];
+
+	MtxLock( &a->mtx );
+	statsP->count = ps->count;
+	statsP->avgUs = ps->count ? (u_int32)(ps->sumUs / ps->count) : 0;
+	statsP->maxUs = ps->maxUs;
+	statsP->avgWaitUs = ps->count ? (u_int32)(ps->sumWaitUs / ps->count) : 0;
+	statsP->maxWaitUs = ps->maxWaitUs;
+	for( n=0; n<LAT_HIST_NUM; n++ )
+		statsP->hist[n] = ps->hist[n];
+	MtxUnlock( &a->mtx );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Reset latency statistics of all priority classes and deadline counters
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	\IN SMB handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PrioStatsGet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PrioStatsReset( void *smbHdl )
+{
+	SMB_HANDLE	*h = HdlRoot( smbHdl );
+	ARBITER		*a;
+
+	API_ENTRY( smbHdl );
+
+	if( !h )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	a = &h->arb;
+	MtxLock( &a->mtx );
+	zeroOut( (int8*)a->stats, sizeof(a->stats) );
+	a->dlDropped = 0;
+	a->dlOverrun = 0;
+	MtxUnlock( &a->mtx );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Set deadline for each transaction of an SMB handle
+ *
+ *  A transaction that did not get the bus within \a msec after the
+ *  request is dropped with #SMB2API_ERR_DEADLINE. A transaction that
+ *  completes after its deadline returns #SMB2API_ERR_OVERRUN (the driver
+ *  call cannot be aborted, read data are discarded).
+ *
+ *  For batches and multi-message transfers the deadline applies to each
+ *  message. See SMB2API_DeadlineCallSet() to bound a whole call.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	\IN SMB handle
+ *	\param     msec		\IN deadline per transaction [ms] (0 = none,
+ *						max. #SMB2API_DEADLINE_MAX)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_DeadlineCallSet, SMB2API_DeadlineStatsGet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_DeadlineSet( void *smbHdl, u_int32 msec )
+{
+	API_ENTRY( smbHdl );
+
+	if( !smbHdl || (msec > SMB2API_DEADLINE_MAX) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	((SMB_HANDLE*)smbHdl)->dlUs = msec * 1000;
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Set deadline for the following calls of the calling thread
+ *
+ *  The deadline is \a msec from now and applies to all transactions of
+ *  the calling thread (on any SMB handle) until it is cleared with
+ *  \a msec = 0. Example to bound one call to 5ms:
+ *
+ *  \verbatim
+ *  SMB2API_DeadlineCallSet( 5 );
+ *  err = SMB2API_ReadWordData( smbHdl, 0, addr, cmd, &word );
+ *  SMB2API_DeadlineCallSet( 0 ); \endverbatim
+ *
+ *  If a handle deadline is set as well, the earlier one applies.
+ *
+ *---------------------------------------------------------------------------
+ *	\param     msec		\IN deadline from now [ms] (0 = clear,
+ *						max. #SMB2API_DEADLINE_MAX)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_DeadlineSet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_DeadlineCallSet( u_int32 msec )
+{
+	API_ENTRY( NULL );
+
+	if( msec > SMB2API_DEADLINE_MAX )
+		API_RETURN( NULL, SMB_ERR_PARAM );
+
+	G_tlsDl = TimeUsec() + msec * 1000;
+	G_tlsDlSet = msec ? 1 : 0;
+	API_RETURN( NULL, 0 );
+}
+
+/****************************************************************************/
+/** Get deadline miss counters of an SMB handle
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     droppedP		\OUT transactions dropped before bus access
+ *							(may be NULL)
+ *	\param     overrunP		\OUT transactions completed after deadline
+ *							(may be NULL)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_DeadlineSet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_DeadlineStatsGet(
+	void		*smbHdl,
+	u_int32		*droppedP,
+	u_int32		*overrunP )
+{
+	SMB_HANDLE	*h = HdlRoot( smbHdl );
+	ARBITER		*a;
+
+	API_ENTRY( smbHdl );
+
+	if( !h )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	a = &h->arb;
+	MtxLock( &a->mtx );
+	if( droppedP )
+		*droppedP = a->dlDropped;
+	if( overrunP )
+		*overrunP = a->dlOverrun;
+	MtxUnlock( &a->mtx );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Configure bus utilization monitor
+ *
+ *  The bus occupancy of each transaction is estimated from the number of
+ *  bytes on the bus and the bus clock. The utilization is averaged over
+ *  10ms windows (moving average over 16 windows).
+ *
+ *  If \a targetPermille is set, transactions of class #SMB2API_PRIO_LOW
+ *  (background jobs like polling or EEPROM reads) are delayed while the
+ *  average utilization is above the target, so foreground transactions
+ *  keep a low latency.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl			\IN SMB handle
+ *	\param     busClk			\IN SMBus clock [Hz] (0 = 100kHz)
+ *	\param     targetPermille	\IN max. utilization for background
+ *								transactions [permille] (0 = no throttling)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_UtilGet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_UtilCfg(
+	void		*smbHdl,
+	u_int32		busClk,
+	u_int32		targetPermille )
+{
+	SMB_HANDLE	*h = HdlRoot( smbHdl );
+	ARBITER		*a;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || (targetPermille > 1000) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	a = &h->arb;
+	MtxLock( &a->mtx );
+	a->util.busClk = busClk ? busClk : UTIL_BUSCLK_DEF;
+	a->util.target = targetPermille;
+	MtxUnlock( &a->mtx );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Get bus utilization of an SMB handle
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	\IN SMB handle
+ *	\param     utilP	\OUT bus utilization
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_UtilCfg
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_UtilGet(
+	void			*smbHdl,
+	SMB2API_UTIL	*utilP )
+{
+	SMB_HANDLE	*h = HdlRoot( smbHdl );
+	ARBITER		*a;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || !utilP )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	a = &h->arb;
+	MtxLock( &a->mtx );
+	UtilUpdate( &a->util, TimeUsec() );
+	utilP->busClk = a->util.busClk;
+	utilP->utilPermille = a->util.avgUtil >> 8;
+	utilP->bytesPerSec = a->util.avgBytes >> 8;
+	utilP->trxPerSec = a->util.avgTrx >> 8;
+	utilP->throttled = a->util.throttled;
+	MtxUnlock( &a->mtx );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Set rate limit of a device
+ *
+ *  The transactions to the device are limited to \a maxPerSec per second
+ *  on average, with up to \a burst transactions back to back (token
+ *  bucket). A transaction exceeding the limit waits before it requests
+ *  the bus, transactions of other threads to other devices are served
+ *  meanwhile. Transactions of the alert response address and nested
+ *  transactions while the bus is owned (e.g. alert callbacks) are not
+ *  limited.
+ *
+ *  The wait is done in steps of milliseconds.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     addr			\IN device address
+ *	\param     maxPerSec	\IN max. transactions per second (0=no limit)
+ *	\param     burst		\IN max. transactions back to back (0=1)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_RateStatsGet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_RateSet(
+	void		*smbHdl,
+	u_int16		addr,
+	u_int32		maxPerSec,
+	u_int32		burst )
+{
+	SMB_HANDLE	*h = HdlRoot( smbHdl );
+	RATE		*tbl = NULL, *r;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || (addr >= RATE_ADDR_NUM) || (maxPerSec > 1000000) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	if( !burst )
+		burst = 1;
+
+	/* table allocated on first limit */
+	if( maxPerSec && !h->rate ){
+		if( !(tbl = (RATE*)MemAlloc( RATE_ADDR_NUM * sizeof(RATE) )) )
+			API_RETURN( smbHdl, SMB_ERR_NO_MEM );
+		zeroOut( (int8*)tbl, RATE_ADDR_NUM * sizeof(RATE) );
+	}
+
+	MtxLock( &h->arb.mtx );
+	if( !h->rate ){
+		h->rate = tbl;
+		tbl = NULL;
+	}
+	if( h->rate ){
+		r = &h->rate[addr];
+		r->periodUs = maxPerSec ? 1000000 / maxPerSec : 0;
+		r->burstUs = (burst - 1) * r->periodUs;
+		r->tat = TimeUsec();
+	}
+	MtxUnlock( &h->arb.mtx );
+
+	MemFree( (void*)tbl );
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Get rate limit statistics of an SMB handle
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	  \IN SMB handle
+ *	\param     statsP	  \OUT statistics
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_RateSet
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_RateStatsGet(
+	void				*smbHdl,
+	SMB2API_RATE_STATS	*statsP )
+{
+	SMB_HANDLE *h = HdlRoot( smbHdl );
+
+	API_ENTRY( smbHdl );
+
+	if( !h || !statsP )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	MtxLock( &h->arb.mtx );
+	*statsP = h->rateStats;
+	MtxUnlock( &h->arb.mtx );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Start recording the transactions of an SMB handle
+ *
+ *  Each transaction (request, result, return code and timing) is
+ *  appended to the record file in a compact binary format, see
+ *  SMB2API_Replay() and SMB2API_InitPlayback().
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     fileName		\IN record file to create
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_RecordStop
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_RecordStart( void *smbHdl, char *fileName )
+{
+	SMB_HANDLE	*h = (SMB_HANDLE*)smbHdl;
+	RECORDER	*rec;
+	u_int8		fileHdr[REC_MAGIC_LEN + 8];
+	u_int32		own = !G_tlsArbDepth;
+	int32		rv;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || !fileName )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	if( h->rec )
+		API_RETURN( smbHdl, SMB_ERR_BUSY );
+
+	if( !(rec = (RECORDER*)MemAlloc( sizeof(RECORDER) )) )
+		API_RETURN( smbHdl, SMB_ERR_NO_MEM );
+
+	if( !(rec->fp = fopen( fileName, "wb" )) ){
+		MemFree( rec );
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+	}
+
+	/* file header: magic, version, reserved */
+	memcpy( fileHdr, REC_MAGIC, REC_MAGIC_LEN );
+	PutLe( fileHdr + REC_MAGIC_LEN, REC_VERSION, 4 );
+	PutLe( fileHdr + REC_MAGIC_LEN + 4, 0, 4 );
+	if( fwrite( fileHdr, sizeof(fileHdr), 1, rec->fp ) != 1 ){
+		fclose( rec->fp );
+		MemFree( rec );
+		API_RETURN( smbHdl, SMB2API_ERR_RECORD );
+	}
+
+	/* install recorder while owning the bus (unless owned already) */
+	G_tlsArbDepth++;
+	if( own && (rv = ArbAcquire( h, SMB2API_PRIO_HIGH, NULL )) ){
+		G_tlsArbDepth--;
+		fclose( rec->fp );
+		MemFree( rec );
+		API_RETURN( smbHdl, rv );
+	}
+	rec->tStart = TimeUsec();
+	h->rec = rec;
+	if( own )
+		ArbDrop( h );
+	G_tlsArbDepth--;
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/****************************************************************************/
+/** Stop recording the transactions of an SMB handle
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_RecordStart
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_RecordStop( void *smbHdl )
+{
+	SMB_HANDLE	*h = (SMB_HANDLE*)smbHdl;
+	RECORDER	*rec;
+	u_int32		own = !G_tlsArbDepth;
+	int32		rv = 0;
+
+	API_ENTRY( smbHdl );
+
+	if( !h )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	if( !h->rec )
+		API_RETURN( smbHdl, 0 );
+
+	/* remove recorder while owning the bus (unless owned already) */
+	G_tlsArbDepth++;
+	if( own && (rv = ArbAcquire( h, SMB2API_PRIO_HIGH, NULL )) ){
+		G_tlsArbDepth--;
+		API_RETURN( smbHdl, rv );
+	}
+	rec = h->rec;
+	h->rec = NULL;
+	if( own )
+		ArbDrop( h );
+	G_tlsArbDepth--;
+
+	if( ferror( rec->fp ) )
+		rv = SMB2API_ERR_RECORD;
+	if( fclose( rec->fp ) )
+		rv = SMB2API_ERR_RECORD;
+	MemFree( rec );
+
+	API_RETURN( smbHdl, rv );
+}
+
+/**********************************************************************/
+/** Initialize library with a playback backend
+ *
+ *  The returned SMB handle answers each transaction with the next
+ *  recorded result of the record file (simulated bus). A transaction
+ *  that does not match the recorded one returns #SMB2API_ERR_RECORD.
+ *  The handle must be closed with SMB2API_Exit().
+ *
+ *  \param 	fileName	\IN  record file (see SMB2API_RecordStart)
+ *  \param	smbHdlP		\INOUT pointer to variable for SMB handle
+ *  \return 	0 on success or error code
+ *
+ *  \sa SMB2API_Replay
+ */
+int32 __MAPILIB SMB2API_InitPlayback( char *fileName, void **smbHdlP )
+{
+	static const SMB2API_BACKEND playbackBe = { PlaybackStat, PlaybackExit };
+	PLAYBACK	*pb;
+	int32		rv;
+
+	API_ENTRY( NULL );
+
+	*smbHdlP = NULL;
+
+	if( !(pb = (PLAYBACK*)MemAlloc( sizeof(PLAYBACK) )) )
+		API_RETURN( NULL, SMB_ERR_NO_MEM );
+
+	if( (rv = RecOpen( fileName, &pb->fp )) ){
+		MemFree( pb );
+		API_RETURN( NULL, rv );
+	}
+
+	if( (rv = SMB2API_InitBackend( &playbackBe, (void*)pb, smbHdlP )) )
+		PlaybackExit( (void*)pb );
+
+	API_RETURN( NULL, rv );
+}
+
+/****************************************************************************/
+/** Replay recorded transactions
+ *
+ *  The transactions of the record file are issued in recorded order on
+ *  \a smbHdl (e.g. a real device, a playback handle or another backend).
+ *  Return codes and read data are compared with the recorded ones and
+ *  the time spent in driver calls is measured.
+ *
+ *  Alert callback install/remove transactions are not replayed.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle
+ *	\param     fileName		\IN record file (see SMB2API_RecordStart)
+ *	\param     flags		\IN #SMB2API_REPLAY_MAX_SPEED or
+ *							#SMB2API_REPLAY_ORIG_SPEED
+ *	\param     resP			\OUT replay result
+ *
+ *  \return    0 | error code (mismatches are no errors)
+ *
+ *  \sa SMB2API_RecordStart
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_Replay(
+	void					*smbHdl,
+	char					*fileName,
+	u_int32					flags,
+	SMB2API_REPLAY_RESULT	*resP )
+{
+	/* replay context */
+	struct {
+		u_int8	hdr[REC_HDR_LEN];		/* record header */
+		u_int8	rec[2*REC_OBJ_MAX];		/* recorded objects */
+		u_int8	enc[REC_OBJ_MAX];		/* encoded replay result */
+		u_int8	i2cBuf[REC_I2C_MAX];	/* I2C message data */
+		union {
+			SMB2_TRANSFER		trx;
+			SMB2_TRANSFER_BLOCK	trxBlk;
+			SMB_I2CMESSAGE		msg[I2C_XFER_MSG_MAX];
+			SMB2_ALERT			alert;
+		} obj;
+	} *rp;
+	FILE		*fp;
+	M_SG_BLOCK	blk;
+	u_int32		inLen, outLen, encLen, tStart, tUs, t0, isGet, recFlags;
+	u_int32		objSize;
+	int32		rv, code, recRv, delta;
+
+	API_ENTRY( smbHdl );
+
+	if( !smbHdl || !fileName || !resP )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	zeroOut( (int8*)resP, sizeof(SMB2API_REPLAY_RESULT) );
+
+	if( (rv = RecOpen( fileName, &fp )) )
+		API_RETURN( smbHdl, rv );
+
+	if( !(rp = MemAlloc( sizeof(*rp) )) ){
+		fclose( fp );
+		API_RETURN( smbHdl, SMB_ERR_NO_MEM );
+	}
+
+	tStart = TimeUsec();
+
+	while( !(rv = RecRead( fp, rp->hdr, rp->rec, &inLen, &outLen )) ){
+
+		tUs			= GetLe( rp->hdr + 0, 4 );
+		code		= (int32)GetLe( rp->hdr + 8, 4 );
+		recRv		= (int32)GetLe( rp->hdr + 12, 4 );
+		recFlags	= GetLe( rp->hdr + 16, 4 );
+		isGet		= rp->hdr[20];
+
+		resP->recBusUs += GetLe( rp->hdr + 4, 4 );
+		resP->recTotalUs = tUs + GetLe( rp->hdr + 4, 4 );
+
+		if( (code == SMB2_BLK_ALERT_CB_INSTALL) ||
+			(code == SMB2_BLK_ALERT_CB_REMOVE) )
+			continue;
+
+		/* original speed: wait for recorded start time */
+		if( flags & SMB2API_REPLAY_ORIG_SPEED ){
+			delta = (int32)(tUs - (TimeUsec() - tStart));
+			if( delta > 0 )
+				UOS_Delay( (u_int32)delta / 1000 );
+		}
+
+		blk.data = (void*)&rp->obj;
+		if( RecDecode( code, rp->rec, inLen, (void*)&rp->obj,
+					   sizeof(rp->obj), rp->i2cBuf, &objSize ) ){
+			rv = SMB2API_ERR_RECORD;
+			break;
+		}
+		blk.size = (int32)objSize;
+
+		t0 = TimeUsec();
+		rv = TrxExec( (SMB_HANDLE*)smbHdl, code, isGet, &blk, recFlags );
+		resP->replayBusUs += TimeUsec() - t0;
+
+		/* compare with recorded result */
+		if( rv != recRv ){
+			if( !resP->rvMismatch++ && !resP->dataMismatch )
+				resP->firstMismatch = resP->records;
+		}
+		else if( outLen ){
+			if( RecEncode( code, (void*)&rp->obj, blk.size, rp->enc,
+						   sizeof(rp->enc), 1, &encLen ) ||
+				(encLen != outLen) ||
+				memcmp( rp->enc, rp->rec + inLen, outLen ) ){
+				if( !resP->dataMismatch++ && !resP->rvMismatch )
+					resP->firstMismatch = resP->records;
+			}
+		}
+
+		resP->records++;
+	}
+
+	resP->replayTotalUs = TimeUsec() - tStart;
+	if( !resP->rvMismatch && !resP->dataMismatch )
+		resP->firstMismatch = resP->records;
+
+	MemFree( rp );
+	fclose( fp );
+
+	/* end of file reached? */
+	API_RETURN( smbHdl, (rv == 1) ? 0 : rv );
+}
+
+/**********************************************************************/
+/** Initialize library with a connection to a broker
+ *
+ *  The transactions of the returned SMB handle are passed to the broker
+ *  (see SMB2API_BrokerServe) that owns the SMB2 device. The handle
+ *  provides all SMB_ENTRIES functions, so existing code only replaces
+ *  SMB2API_Init() by this function.
+ *
+ *  The transactions are sent with their priority class (see
+ *  SMB2API_PrioSet). Alert callbacks cannot be installed over the
+ *  broker (#SMB_ERR_NOT_SUPPORTED), use a polling alert engine instead
+ *  (see #SMB2API_ALERT_POLL). Not supported under Windows.
+ *
+ *  \param 	sockPath	\IN  Unix domain socket of the broker
+ *  \param	smbHdlP		\INOUT pointer to variable for SMB handle
+ *  \return 	0 on success or error code
+ *
+ *  \sa SMB2API_Exit
+ */
+int32 __MAPILIB SMB2API_InitBroker( char *sockPath, void **smbHdlP )
+{
+#if defined(WINNT)
+	API_ENTRY( NULL );
+	*smbHdlP = NULL;
+	API_RETURN( NULL, SMB_ERR_NOT_SUPPORTED );
+#else
+	static const SMB2API_BACKEND brokerBe = { BrokerStat, BrokerExit };
+	struct sockaddr_un sa;
+	BROKER_CLI	*c;
+	int32		rv;
+
+	API_ENTRY( NULL );
+
+	*smbHdlP = NULL;
+
+	if( !sockPath || (strlen( sockPath ) >= sizeof(sa.sun_path)) )
+		API_RETURN( NULL, SMB_ERR_PARAM );
+
+	if( !(c = (BROKER_CLI*)MemAlloc( sizeof(BROKER_CLI) )) )
+		API_RETURN( NULL, SMB_ERR_NO_MEM );
+
+	/* connect to the broker */
+	zeroOut( (int8*)&sa, sizeof(sa) );
+	sa.sun_family = AF_UNIX;
+	strcpy( sa.sun_path, sockPath );
+
+	if( ((c->fd = socket( AF_UNIX, SOCK_STREAM, 0 )) < 0) ||
+		connect( c->fd, (struct sockaddr*)&sa, sizeof(sa) ) ){
+		if( c->fd >= 0 )
+			close( c->fd );
+		MemFree( c );
+		API_RETURN( NULL, SMB2API_ERR_BROKER );
+	}
+
+	MtxInit( &c->mtx );
+
+	if( (rv = SMB2API_InitBackend( &brokerBe, (void*)c, smbHdlP )) )
+		BrokerExit( (void*)c );
+
+	API_RETURN( NULL, rv );
+#endif
+}
+
+/****************************************************************************/
+/** Serve clients of an SMB handle as broker
+ *
+ *  Independent processes that open the same SMB2 device contend for the
+ *  bus without coordination. A broker process owns the device and
+ *  serves client processes (see SMB2API_InitBroker) over a Unix domain
+ *  socket. Each request is one transaction (SMB2_BLK_XXX code and
+ *  transfer object) in the encoding of the record file (see
+ *  SMB2API_RecordStart).
+ *
+ *  Each client connection is served by its own worker thread. The
+ *  transactions go through the bus arbiter of \a smbHdl with the
+ *  priority class of the client (see SMB2API_PrioSet), so a slow device
+ *  delays the other clients only while its transaction owns the bus.
+ *  This mode does not batch: each request is a transaction of its own,
+ *  contending requests are reordered by the arbiter only (priority
+ *  class, then arrival). With SMB2API_NO_THREADS, the requests of all
+ *  clients that arrived until a round are collected and executed as a
+ *  batch in one round, ordered by priority class and then by arrival.
+ *
+ *  The socket is created with permissions 0660: only processes of the
+ *  owner or the group of the broker process can connect. Select the
+ *  group with the process group or the set-group-ID bit of the
+ *  directory of \a sockPath.
+ *
+ *  The function returns when *stopP is set (checked at least every
+ *  100ms, e.g. set by a signal handler) or on error. The broker daemon
+ *  smb2_broker (TOOLS/SMB2_BROKER) serves a device until SIGINT or
+ *  SIGTERM.
+ *
+ *  Not supported under Windows.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl		\IN SMB handle of the device
+ *	\param     sockPath		\IN Unix domain socket to create
+ *	\param     stopP		\IN stop flag (NULL = serve forever)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_InitBroker
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_BrokerServe(
+	void				*smbHdl,
+	char				*sockPath,
+	volatile u_int32	*stopP )
+{
+#if defined(WINNT)
+	API_ENTRY( smbHdl );
+	API_RETURN( smbHdl, SMB_ERR_NOT_SUPPORTED );
+#else
+	SMB_HANDLE			*h = (SMB_HANDLE*)smbHdl;
+	struct sockaddr_un	sa;
+	int					lfd;
+	int32				rv;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || !sockPath || (strlen( sockPath ) >= sizeof(sa.sun_path)) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	/* create socket */
+	zeroOut( (int8*)&sa, sizeof(sa) );
+	sa.sun_family = AF_UNIX;
+	strcpy( sa.sun_path, sockPath );
+	unlink( sockPath );
+
+	if( (lfd = socket( AF_UNIX, SOCK_STREAM, 0 )) < 0 )
+		API_RETURN( smbHdl, SMB2API_ERR_BROKER );
+
+	/* owner and group only, set before clients can connect */
+	if( bind( lfd, (struct sockaddr*)&sa, sizeof(sa) ) ||
+		chmod( sockPath, 0660 ) ||
+		listen( lfd, BROKER_CLI_MAX ) ){
+		close( lfd );
+		unlink( sockPath );
+		API_RETURN( smbHdl, SMB2API_ERR_BROKER );
+	}
+
+#if defined(SMB2API_NO_THREADS)
+	rv = BrokerRounds( h, lfd, stopP );
+#else
+	rv = BrokerWorkers( h, lfd, stopP );
+#endif
+
+	close( lfd );
+	unlink( sockPath );
+
+	API_RETURN( smbHdl, rv );
+#endif
+}
+
+#if defined(SMB2API_NO_THREADS)
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Serve broker clients in rounds
+ */
+static int32 BrokerRounds( SMB_HANDLE *h, int lfd, volatile u_int32 *stopP )
+{
+#if defined(WINNT)
+	return (SMB_ERR_NOT_SUPPORTED);
+#else
+	struct pollfd		pfd[1 + BROKER_CLI_MAX];
+	BROKER_CONN			*conn[BROKER_CLI_MAX], *ready[BROKER_CLI_MAX], *c;
+	u_int32				n, i, num, seq = 0;
+	int					fd;
+
+	for( n=0; n<BROKER_CLI_MAX; n++ )
+		conn[n] = NULL;
+
+	while( !stopP || !*stopP ){
+		pfd[0].fd = lfd;
+		pfd[0].events = POLLIN;
+		for( n=0; n<BROKER_CLI_MAX; n++ ){
+			pfd[1 + n].fd = conn[n] ? conn[n]->fd : -1;
+			pfd[1 + n].events = POLLIN;
+			pfd[1 + n].revents = 0;
+		}
+
+		if( poll( pfd, 1 + BROKER_CLI_MAX, BROKER_POLL_MS ) <= 0 )
+			continue;
+
+		/* new client */
+		if( (pfd[0].revents & POLLIN) &&
+			((fd = accept( lfd, NULL, NULL )) >= 0) ){
+			for( n=0; n<BROKER_CLI_MAX && conn[n]; n++ )
+				;
+			if( (n == BROKER_CLI_MAX) ||
+				!(conn[n] = (BROKER_CONN*)MemAlloc( sizeof(BROKER_CONN) )) )
+				close( fd );
+			else {
+				conn[n]->fd = fd;
+				conn[n]->rxLen = 0;
+				conn[n]->seq = 0;
+			}
+		}
+
+		/* receive requests */
+		for( n=0; n<BROKER_CLI_MAX; n++ ){
+			if( !(c = conn[n]) || !pfd[1 + n].revents || c->seq )
+				continue;
+
+			switch( BrokerRecv( c ) ){
+			case 0:
+				break;
+			case 1:
+				c->seq = ++seq;
+				break;
+			default:
+				/* client closed connection */
+				close( c->fd );
+				MemFree( c );
+				conn[n] = NULL;
+			}
+		}
+
+		/* one round: complete requests by priority class and arrival */
+		for( num=0, n=0; n<BROKER_CLI_MAX; n++ ){
+			if( !(c = conn[n]) || !c->seq )
+				continue;
+
+			for( i=num++; i>0; i-- ){
+				if( (ready[i-1]->buf[9] > c->buf[9]) ||
+					((ready[i-1]->buf[9] == c->buf[9]) &&
+					 (ready[i-1]->seq < c->seq)) )
+					break;
+				ready[i] = ready[i-1];
+			}
+			ready[i] = c;
+		}
+
+		for( i=0; i<num; i++ ){
+			/* response lost: client is removed with next receive */
+			BrokerExec( h, ready[i] );
+			ready[i]->seq = 0;
+			ready[i]->rxLen = 0;
+		}
+	}
+
+	for( n=0; n<BROKER_CLI_MAX; n++ ){
+		if( conn[n] ){
+			close( conn[n]->fd );
+			MemFree( conn[n] );
+		}
+	}
+
+	return 0;
+#endif
+}
+#else
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Serve broker clients with one worker thread per connection
+ */
+static int32 BrokerWorkers( SMB_HANDLE *h, int lfd, volatile u_int32 *stopP )
+{
+#if defined(WINNT)
+	return (SMB_ERR_NOT_SUPPORTED);
+#else
+	struct pollfd		pfd;
+	BROKER_CONN			*conn[BROKER_CLI_MAX], *c;
+	volatile u_int32	stop = 0;
+	u_int32				n;
+	int					fd;
+
+	for( n=0; n<BROKER_CLI_MAX; n++ )
+		conn[n] = NULL;
+
+	while( !stopP || !*stopP ){
+		/* remove connections closed by the clients */
+		for( n=0; n<BROKER_CLI_MAX; n++ ){
+			if( (c = conn[n]) && c->done ){
+				ThreadJoin( &c->thread );
+				close( c->fd );
+				MemFree( c );
+				conn[n] = NULL;
+			}
+		}
+
+		pfd.fd = lfd;
+		pfd.events = POLLIN;
+		if( (poll( &pfd, 1, BROKER_POLL_MS ) <= 0) ||
+			((fd = accept( lfd, NULL, NULL )) < 0) )
+			continue;
+
+		/* new client */
+		for( n=0; n<BROKER_CLI_MAX && conn[n]; n++ )
+			;
+		if( (n == BROKER_CLI_MAX) ||
+			!(c = (BROKER_CONN*)MemAlloc( sizeof(BROKER_CONN) )) ){
+			close( fd );
+			continue;
+		}
+
+		c->fd = fd;
+		c->rxLen = 0;
+		c->seq = 0;
+		c->h = h;
+		c->stopP = &stop;
+		c->done = 0;
+		if( ThreadCreate( &c->thread, BrokerConnThread, (void*)c ) ){
+			close( fd );
+			MemFree( c );
+			continue;
+		}
+		conn[n] = c;
+	}
+
+	/* workers notice the stop flag within BROKER_POLL_MS */
+	stop = 1;
+	for( n=0; n<BROKER_CLI_MAX; n++ ){
+		if( (c = conn[n]) ){
+			ThreadJoin( &c->thread );
+			close( c->fd );
+			MemFree( c );
+		}
+	}
+
+	return 0;
+#endif
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Broker worker thread: receive and execute the requests of a client
+ * until the connection is closed or the broker stops
+ */
+static THREAD_RET BrokerConnThread( void *arg )
+{
+#if !defined(WINNT)
+	BROKER_CONN		*c = (BROKER_CONN*)arg;
+	struct pollfd	pfd;
+	int32			rv;
+
+	pfd.fd = c->fd;
+	pfd.events = POLLIN;
+
+	while( !*c->stopP ){
+		if( poll( &pfd, 1, BROKER_POLL_MS ) <= 0 )
+			continue;
+
+		if( (rv = BrokerRecv( c )) < 0 )
+			break;
+
+		/* response lost: the client closed the connection */
+		if( (rv == 1) && BrokerExec( c->h, c ) )
+			break;
+		if( rv == 1 )
+			c->rxLen = 0;
+	}
+
+	c->done = 1;
+#endif
+	return 0;
+}
+#endif /* SMB2API_NO_THREADS */
+
+/****************************************************************************/
+/** Start alert engine of an SMB handle
+ *
+ *  Under fault conditions, devices may alert hundreds of times per
+ *  second. Without engine, each alert signal calls the alert callback
+ *  in the context of the signal. With engine, the signals of the alerts
+ *  of this handle only wake the engine thread, which
+ *  - drains the alert response address until no device responds, if
+ *    #SMB2API_ALERT_ARA_DRAIN is set (max. cfgP->maxDrain reads per
+ *    wakeup, transactions with #SMB2API_PRIO_HIGH)
+ *  - coalesces all alerts of an address within cfgP->windowMs after its
+ *    first alert
+ *  - at the end of the window, calls the alert callback of the address
+ *    (if installed) once and cfgP->notifyFunc (if set) with the number of
+ *    coalesced alerts. Extended alert callbacks (see
+ *    SMB2API_AlertCbInstallEx) get the information of the window.
+ *
+ *  An alert reported by signal and by the alert response address in the
+ *  same wakeup is counted once. Addresses that respond to the alert
+ *  response address without installed alert callback are reported to
+ *  cfgP->notifyFunc only.
+ *
+ *  With #SMB2API_ALERT_POLL, the engine also polls the alert response
+ *  address (implies #SMB2API_ALERT_ARA_DRAIN), for platforms where alert
+ *  signals are not available or not reliable. The poll interval is
+ *  cfgP->pollMinMs while devices alert and doubles with each idle poll
+ *  up to cfgP->pollMaxMs. Alert callbacks installed with
+ *  SMB2API_AlertCbInstall or SMB2API_AlertCbInstallEx (sigCode=0) while
+ *  the engine polls use no signal. They are invoked by the polling
+ *  engine only, so the engine must not be stopped before they are
+ *  removed.
+ *
+ *  The callbacks run in the engine thread and may access the bus.
+ *  Not available with SMB2API_NO_THREADS.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	  \IN SMB handle
+ *	\param     cfgP		  \IN engine configuration
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_AlertEngineStop
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_AlertEngineStart(
+	void					*smbHdl,
+	const SMB2API_ALERT_CFG	*cfgP )
+{
+	SMB_HANDLE	*h = HdlRoot( smbHdl );
+	ALERT_ENG	*e;
+	int32		rv;
+
+	API_ENTRY( smbHdl );
+
+	if( !h || !cfgP )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	if( h->alertEng )
+		API_RETURN( smbHdl, SMB_ERR_BUSY );
+
+	if( !(e = (ALERT_ENG*)MemAlloc( sizeof(ALERT_ENG) )) )
+		API_RETURN( smbHdl, SMB_ERR_NO_MEM );
+
+	zeroOut( (int8*)e, sizeof(ALERT_ENG) );
+	e->h = h;
+	e->cfg = *cfgP;
+	if( !e->cfg.maxDrain )
+		e->cfg.maxDrain = ALERT_DRAIN_DEF;
+
+	/* polling: the alert response address tells the alerting devices */
+	if( e->cfg.flags & SMB2API_ALERT_POLL ){
+		e->cfg.flags |= SMB2API_ALERT_ARA_DRAIN;
+		if( !e->cfg.pollMinMs )
+			e->cfg.pollMinMs = ALERT_POLL_MIN_DEF;
+		if( !e->cfg.pollMaxMs )
+			e->cfg.pollMaxMs = ALERT_POLL_MAX_DEF;
+		if( e->cfg.pollMaxMs < e->cfg.pollMinMs )
+			e->cfg.pollMaxMs = e->cfg.pollMinMs;
+		e->pollUs = e->cfg.pollMinMs * 1000;
+		e->pollNext = TimeUsec();
+	}
+
+	SemInit( &e->sem );
+
+	/* signals are passed to the engine from now on */
+	AlertLock();
+	h->alertEng = e;
+	AlertUnlock();
+
+	if( (rv = ThreadCreate( &e->thread, AlertEngThread, (void*)e )) ){
+		AlertLock();
+		h->alertEng = NULL;
+		AlertUnlock();
+		SemExit( &e->sem );
+		MemFree( e );
+	}
+
+	API_RETURN( smbHdl, rv );
+}
+
+/****************************************************************************/
+/** Stop alert engine of an SMB handle
+ *
+ *  Coalesced alerts are delivered before the engine terminates. Then
+ *  the alert callbacks are invoked in the context of the signal again,
+ *  without status register (see SMB2API_AlertCbInstallEx).
+ *  Must not be called from the callbacks of the engine.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     smbHdl	  \IN SMB handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_AlertEngineStart
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_AlertEngineStop( void *smbHdl )
+{
+	SMB_HANDLE	*h = HdlRoot( smbHdl );
+	ALERT_ENG	*e;
+
+	API_ENTRY( smbHdl );
+
+	if( !h )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	/* signals call the alert callbacks again */
+	AlertLock();
+	e = h->alertEng;
+	h->alertEng = NULL;
+	AlertUnlock();
+
+	if( !e )
+		API_RETURN( smbHdl, 0 );
+
+	e->stop = 1;
+	SemPost( &e->sem );
+	ThreadJoin( &e->thread );
+
+	SemExit( &e->sem );
+	MemFree( e );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/**********************************************************************/
+/** Initialize library with a simulated SMBus
+ *
+ *  The returned SMB handle accesses an in-process SMBus simulation
+ *  instead of the SMB2 driver. It allows stress and scaling tests of
+ *  applications (and of the library) without hardware, e.g. many
+ *  threads hammering the handle while alerts are injected with
+ *  SMB2API_SimAlert().
+ *
+ *  The simulation has no devices after init, see SMB2API_SimDevSet().
+ *  Each device has a register file of 256 bytes:
+ *  - byte/word data accesses read/write the registers at cmdAddr
+ *  - block writes store the length at cmdAddr and the data behind it,
+ *    block reads return them, block process calls return the written
+ *    data
+ *  - receive/send byte (SMB2API_ReadByte/WriteByte) read the register
+ *    pointer (auto increment) / set the register pointer
+ *  - I2C writes set the register pointer with the first byte and write
+ *    the following bytes, I2C reads start at the register pointer
+ *  - a receive byte from the alert response address 0x18 returns the
+ *    lowest device address with a pending alert and clears the alert
+ *
+ *  Accesses to absent devices fail with #SMB_ERR_ADDR.
+ *
+ *  If \a busClk is not 0, each transaction occupies the bus for its
+ *  estimated bus time (the calling thread sleeps).
+ *
+ *  \param 	busClk		\IN  emulated bus clock [Hz] or 0 (no delay)
+ *  \param	smbHdlP		\INOUT pointer to variable for SMB handle
+ *  \return 	0 on success or error code
+ *
+ *  \sa SMB2API_SimDevSet, SMB2API_SimAlert, SMB2API_SimStatsGet
+ */
+int32 __MAPILIB SMB2API_InitSim( u_int32 busClk, void **smbHdlP )
+{
+	static const SMB2API_BACKEND simBe = { SimStat, SimExit };
+	SIM		*sim;
+	int32	rv;
+
+	API_ENTRY( NULL );
+
+	if( !(sim = (SIM*)MemAlloc( sizeof(SIM) )) ){
+		*smbHdlP = NULL;
+		API_RETURN( NULL, SMB_ERR_NO_MEM );
+	}
+
+	zeroOut( (int8*)sim, sizeof(SIM) );
+	MtxInit( &sim->mtx );
+	sim->busClk = busClk;
+
+	if( (rv = SMB2API_InitBackend( &simBe, (void*)sim, smbHdlP )) ){
+		MtxExit( &sim->mtx );
+		MemFree( sim );
+	}
+
+	API_RETURN( NULL, rv );
+}
+
+/**********************************************************************/
+/** Add/remove simulated device
+ *
+ *  \param 	smbHdl		\IN  SMB handle from SMB2API_InitSim()
+ *  \param 	addr		\IN  device address
+ *  \param 	present		\IN  1: device answers, 0: device absent
+ *  \param 	regs		\IN  initial register values (256 bytes)
+ *							 or NULL (keep registers)
+ *  \return 	0 on success or error code
+ */
+int32 __MAPILIB SMB2API_SimDevSet(
+	void			*smbHdl,
+	u_int16			addr,
+	u_int32			present,
+	const u_int8	*regs )
+{
+	SIM		*sim;
+	SIM_DEV	*dev;
+
+	API_ENTRY( smbHdl );
+
+	if( !(sim = SimGet( smbHdl )) || (addr >= SIM_DEV_NUM) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	dev = &sim->dev[addr];
+
+	MtxLock( &sim->mtx );
+	dev->present = present ? 1 : 0;
+	if( regs )
+		memcpy( dev->reg, regs, SIM_REG_NUM );
+	MtxUnlock( &sim->mtx );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/**********************************************************************/
+/** Raise alert of a simulated device
+ *
+ *  The device asserts SMBALERT# until its address was read from the
+ *  alert response address (see SMB2API_InitSim and
+ *  SMB2API_AlertResponse). If an alert callback is installed for the
+ *  device, its signal is sent to the process like the SMB2 driver does
+ *  (kill), so it is delivered asynchronously like a real alert. Under
+ *  Windows the signal handler is called by the calling thread.
+ *
+ *  \param 	smbHdl		\IN  SMB handle from SMB2API_InitSim()
+ *  \param 	addr		\IN  device address
+ *  \return 	0 on success or error code
+ */
+int32 __MAPILIB SMB2API_SimAlert( void *smbHdl, u_int16 addr )
+{
+	SIM		*sim;
+	SIM_DEV	*dev;
+	u_int32	sigCode;
+
+	API_ENTRY( smbHdl );
+
+	if( !(sim = SimGet( smbHdl )) || (addr >= SIM_DEV_NUM) )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	dev = &sim->dev[addr];
+
+	MtxLock( &sim->mtx );
+	dev->alert = 1;
+	sigCode = dev->sigCode;
+	sim->stats.alerts++;
+	if( sigCode )
+		sim->stats.signals++;
+	MtxUnlock( &sim->mtx );
+
+	/* send the signal like the driver */
+	if( sigCode ){
+#if defined(WINNT)
+		SigHandler( sigCode );
+#else
+		kill( getpid(), (int)sigCode );
+#endif
+	}
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/**********************************************************************/
+/** Get statistics of the simulated SMBus
+ *
+ *  \param 	smbHdl		\IN  SMB handle from SMB2API_InitSim()
+ *  \param 	statsP		\OUT statistics
+ *  \return 	0 on success or error code
+ */
+int32 __MAPILIB SMB2API_SimStatsGet(
+	void				*smbHdl,
+	SMB2API_SIM_STATS	*statsP )
+{
+	SIM *sim;
+
+	API_ENTRY( smbHdl );
+
+	if( !(sim = SimGet( smbHdl )) || !statsP )
+		API_RETURN( smbHdl, SMB_ERR_PARAM );
+
+	MtxLock( &sim->mtx );
+	*statsP = sim->stats;
+	MtxUnlock( &sim->mtx );
+
+	API_RETURN( smbHdl, 0 );
+}
+
+/**********************************************************************/
+/** Get alert statistics
+ *
+ *  The counters are process wide (all SMB handles) and count since
+ *  library load. A signal without callback is counted as lost, e.g.
+ *  if the alert was removed meanwhile or if the signal interrupted a
+ *  thread that modified the alert list.
+ *
+ *  \param 	statsP		\OUT statistics
+ *  \return 	0 on success or error code
+ */
+int32 __MAPILIB SMB2API_AlertStatsGet( SMB2API_ALERT_STATS *statsP )
+{
+	API_ENTRY( NULL );
+
+	if( !statsP )
+		API_RETURN( NULL, SMB_ERR_PARAM );
+
+	*statsP = G_alertStats;
+
+	API_RETURN( NULL, 0 );
+}
+
+/**********************************************************************/
+/** Get number of memory blocks allocated by the library
+ *
+ *  Handles, prepared transactions, alert nodes etc. are counted.
+ *  The number must return to its previous value after the objects
+ *  were freed (leak check).
+ *
+ *  \param 	blocksP		\OUT number of allocated memory blocks
+ *  \return 	0 on success or error code
+ */
+int32 __MAPILIB SMB2API_MemStatsGet( u_int32 *blocksP )
+{
+	API_ENTRY( NULL );
+
+	if( !blocksP )
+		API_RETURN( NULL, SMB_ERR_PARAM );
+
+	*blocksP = G_memBlocks;
+
+	API_RETURN( NULL, 0 );
+}
+
+/*! @} */
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Zero out data storage
+ */
+static void zeroOut( int8 *p, int32 size ){
+	while( size-- )
+		*p++ = 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Remove specified alert node (already taken from the list).
+ * If the driver refuses the removal, the node is put back to the list.
+ */
+static int32 AlertRemove(
+	void		*smbHdl,
+	ALERT_NODE	*alertNode )
+{
+	SMB_HANDLE	*h = (SMB_HANDLE*)smbHdl;
+	SMB2_ALERT	alertCtrl;
+	int32		rv, ret = 0;
+	u_int32		sigNodes;
+
+	/* no signal: alerts polled by the alert engine */
+	if( !alertNode->sigCode ){
+		MemFree( alertNode );
+		return 0;
+	}
+
+	/* remove alert callback */
+	alertCtrl.addr = alertNode->addr;
+	alertCtrl.sigCode = alertNode->sigCode;
+	DO_BLK_SETSTAT( alertCtrl, SMB2_BLK_ALERT_CB_REMOVE );
+	if( rv ){
+		AlertLock();
+		UOS_DL_AddTail( &G_alertList, &alertNode->n );
+		AlertUnlock();
+		return rv;
+	}
+
+	/* last alert of the signal: remove signal */
+	AlertLock();
+	sigNodes = AlertSigNodes( alertNode->sigCode, 0 );
+	AlertUnlock();
+	if( !sigNodes && UOS_SigRemove( alertNode->sigCode ) )
+		ret = SMB_ERR_ALERT_INSTALL;
+
+	AlertSigFree( h, alertNode->sigCode );
+
+	AlertLock();
+
+	/* last alert: terminate signal handling */
+	if( !--G_sigUsers && UOS_SigExit() )
+		ret = SMB_ERR_ALERT_INSTALL;
+
+	AlertUnlock();
+
+	/* free the node */
+	MemFree( alertNode );
+
+	return ret;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Lock/unlock alert list.
+ * A signal that interrupts the lock owner must not wait for the lock,
+ * see SigHandler.
+ */
+static void AlertLock( void )
+{
+	G_tlsAlertLock++;
+	MtxLock( &G_alertMtx );
+}
+
+static void AlertUnlock( void )
+{
+	MtxUnlock( &G_alertMtx );
+	G_tlsAlertLock--;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Allocate free signal of the signal array
+ */
+static int32 AlertSigAlloc( SMB_HANDLE *h, u_int32 *sigCodeP )
+{
+	u_int32 si;
+
+	AlertLock();
+
+	/* polling alert engine: no signal required */
+	if( h->alertEng && (h->alertEng->cfg.flags & SMB2API_ALERT_POLL) ){
+		AlertUnlock();
+		*sigCodeP = 0;
+		return 0;
+	}
+
+	for( si=0; si<NBR_OF_SIG; si++ ){
+		if( h->signal[si].condition == SIG_FREE ){
+			h->signal[si].condition = SIG_USED;
+			*sigCodeP = h->signal[si].sigCode;
+			break;
+		}
+	}
+
+	/* no free signal: share one if the alert engine drains the ARA */
+	if( (si == NBR_OF_SIG) && NBR_OF_SIG && h->alertEng &&
+		(h->alertEng->cfg.flags & SMB2API_ALERT_ARA_DRAIN) ){
+		*sigCodeP = h->signal[0].sigCode;
+		si = 0;
+	}
+	AlertUnlock();
+
+	return (si == NBR_OF_SIG) ? SMB_ERR_ALERT_NOSIG : 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Release signal (if from the signal array and no longer used)
+ */
+static void AlertSigFree( SMB_HANDLE *h, u_int32 sigCode )
+{
+	u_int32 si;
+
+	AlertLock();
+	for( si=0; si<NBR_OF_SIG && !AlertSigNodes( sigCode, 0 ); si++ ){
+		if( h->signal[si].sigCode == sigCode ){
+			h->signal[si].condition = SIG_FREE;
+			break;
+		}
+	}
+	AlertUnlock();
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Read status register of alerting device (alert engine thread)
+ */
+static int32 AlertPreRead(
+	SMB_HANDLE	*h,
+	u_int16		addr,
+	u_int8		cmdAddr,
+	u_int8		size,
+	u_int16		*statusP )
+{
+	const OP_DESC	*op = OpFind( SMB_READ, size );
+	OP_TRX			t;
+	M_SG_BLOCK		blk;
+	int32			rv;
+
+	OpInit( op, 0, addr, SMB_READ, cmdAddr, &t, &blk );
+
+	rv = TrxExec( h, op->code, op->isGet, &blk, SMB2API_FLAG_PRIO_HIGH );
+
+	*statusP = rv ? 0 :
+		(op->dataKind == OP_DATA_WORD) ? t.trx.u.wordData : t.trx.u.byteData;
+
+	return rv;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return alert node for handle (NULL = any) and address or NULL if
+ * not found
+ */
+static ALERT_NODE* AlertFindByAddr( SMB_HANDLE *h, u_int16 addr )
+{
+	ALERT_NODE	*alertNode;
+
+	/* scan the list */
+	for( alertNode=(ALERT_NODE*)G_alertList.head;
+         alertNode->n.next;
+         alertNode = (ALERT_NODE*)alertNode->n.next ){
+
+		/* alert node for specified addr? */
+		if( (alertNode->addr == addr) && (!h || (alertNode->h == h)) )
+			return alertNode;
+	}
+
+	/* alert node not found */
+	return NULL;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return number of alert nodes in the list using signal code,
+ * mark them as multiplexed if mux is set (alert list locked)
+ */
+static u_int32 AlertSigNodes( u_int32 sigCode, u_int32 mux )
+{
+	ALERT_NODE	*alertNode;
+	u_int32		n = 0;
+
+	/* scan the list */
+	for( alertNode=(ALERT_NODE*)G_alertList.head;
+         alertNode->n.next;
+         alertNode = (ALERT_NODE*)alertNode->n.next ){
+
+		if( alertNode->sigCode == sigCode ){
+			if( mux )
+				alertNode->muxed = 1;
+			n++;
+		}
+	}
+
+	return n;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Call alert callback function for signal code
+ */
+static void __MAPILIB SigHandler(u_int32 sigCode)
+{
+	ALERT_NODE	*alertNode;
+	ALERT_ENG	*e;
+	void		(*cbFunc)( void *cbArg ) = NULL;
+	void		(*cbFuncEx)( void *cbArg, const SMB2API_ALERT_INFO *infoP ) = NULL;
+	void		*cbArg = NULL;
+	u_int32		queued = 0;
+	SMB2API_ALERT_INFO info;
+
+	ATOMIC_ADD( G_alertStats.signals, 1 );
+
+	/* interrupted the lock owner: waiting for the lock would deadlock */
+	if( G_tlsAlertLock ){
+		ATOMIC_ADD( G_alertStats.lost, 1 );
+		return;
+	}
+
+	/* callback is called without lock (may install/remove alerts) */
+	AlertLock();
+	for( alertNode=(ALERT_NODE*)G_alertList.head;
+         alertNode->n.next;
+         alertNode = (ALERT_NODE*)alertNode->n.next ){
+
+		if( alertNode->sigCode != sigCode )
+			continue;
+
+		if( (e = alertNode->h->alertEng) ){
+			/*
+			 * Delivered by the alert engine. Shared signal: the
+			 * alerting addresses are read from the ARA, or, without
+			 * ARA drain, all addresses of the signal are pending.
+			 */
+			AlertEngSignal( e, (alertNode->muxed &&
+								(e->cfg.flags & SMB2API_ALERT_ARA_DRAIN)) ?
+							ALERT_ADDR_NUM : alertNode->addr );
+			queued = 1;
+			continue;
+		}
+
+		/* without engine: first alert of the signal only */
+		if( cbFunc || cbFuncEx )
+			continue;
+		cbFunc = alertNode->cbFunc;
+		cbFuncEx = alertNode->cbFuncEx;
+		cbArg = alertNode->cbArg;
+		zeroOut( (int8*)&info, sizeof(info) );
+		info.addr = alertNode->addr;
+	}
+	AlertUnlock();
+
+	if( queued && !cbFunc && !cbFuncEx )
+		return;
+
+	/*
+	 * The interrupted thread may hold arbiter or statistics locks:
+	 * transactions of the callback skip the arbitration (see TrxArb)
+	 */
+	G_tlsInSig++;
+	G_tlsArbDepth++;
+
+	if( cbFuncEx ){
+		info.count = 1;
+		info.tFirstUs = info.tLastUs = TimeUsec();
+		ATOMIC_ADD( G_alertStats.callbacks, 1 );
+		cbFuncEx( cbArg, &info );
+	}
+	else if( cbFunc ){
+		ATOMIC_ADD( G_alertStats.callbacks, 1 );
+		cbFunc( cbArg );
+	}
+	else {
+		ATOMIC_ADD( G_alertStats.lost, 1 );
+	}
+
+	G_tlsArbDepth--;
+	G_tlsInSig--;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Pass alert signal to the alert engine (signal context, alert list
+ * locked), addr >= ALERT_ADDR_NUM: wakeup only
+ */
+static void AlertEngSignal( ALERT_ENG *e, u_int16 addr )
+{
+	if( addr < ALERT_ADDR_NUM ){
+		ATOMIC_ADD( e->sigCnt[addr], 1 );
+		ATOMIC_OR( e->sigPend[addr >> 5], (u_int32)1 << (addr & 0x1f) );
+	}
+	SemPost( &e->sem );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Alert engine thread
+ */
+static THREAD_RET AlertEngThread( void *arg )
+{
+	ALERT_ENG	*e = (ALERT_ENG*)arg;
+	u_int32		wait = 0, sig, poll, now, n;
+
+	while( !e->stop ){
+		if( (sig = !SemTimedWait( &e->sem, wait )) ){
+			/* one round for all signals posted meanwhile */
+			while( !SemTimedWait( &e->sem, 0 ) )
+				;
+			if( e->stop )
+				break;
+		}
+
+		now = TimeUsec();
+		poll = (e->cfg.flags & SMB2API_ALERT_POLL) &&
+			   ((int32)(now - e->pollNext) >= 0);
+
+		if( sig || poll ){
+			if( poll )
+				ATOMIC_ADD( G_alertStats.polls, 1 );
+			n = AlertEngCollect( e, now );
+
+			/* adaptive poll interval: short while devices alert */
+			if( e->cfg.flags & SMB2API_ALERT_POLL ){
+				if( n )
+					e->pollUs = e->cfg.pollMinMs * 1000;
+				else if( e->pollUs < e->cfg.pollMaxMs * 500 )
+					e->pollUs *= 2;
+				else
+					e->pollUs = e->cfg.pollMaxMs * 1000;
+				e->pollNext = now + e->pollUs;
+			}
+		}
+
+		now = TimeUsec();
+		wait = AlertEngDeliver( e, now, 0 );
+		if( e->cfg.flags & SMB2API_ALERT_POLL ){
+			n = ((int32)(e->pollNext - now) > 0) ? e->pollNext - now : 0;
+			if( n < wait )
+				wait = n;
+		}
+	}
+
+	/* deliver coalesced alerts */
+	AlertEngDeliver( e, TimeUsec(), 1 );
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Collect alerts reported by signals and by the alert response address,
+ * returns number of alerting addresses
+ */
+static u_int32 AlertEngCollect( ALERT_ENG *e, u_int32 now )
+{
+	ALERT_NODE	*alertNode;
+	ALERT_ADDR	*a;
+	u_int32		w, bit, pend, n, i, alerting = 0;
+	u_int16		addr;
+	u_int8		ara, preCmd = 0, preSize;
+
+	/* addresses signalled since last round */
+	for( w=0; w<ALERT_ADDR_NUM/32; w++ ){
+		pend = AtomicXchg( &e->sigPend[w], 0 );
+		for( bit=0; pend; bit++, pend >>= 1 ){
+			if( pend & 1 ){
+				addr = (u_int16)(w * 32 + bit);
+				AlertEngTouch( e, addr )->sig += AtomicXchg( &e->sigCnt[addr], 0 );
+			}
+		}
+	}
+
+	/* drain the alert response address */
+	if( (e->cfg.flags & SMB2API_ALERT_ARA_DRAIN) && !AlertEngBus( e, 1 ) ){
+		for( i=0; i<e->cfg.maxDrain; i++ ){
+			if( SMB2API_ReadByte( (void*)e->h, SMB2API_FLAG_PRIO_HIGH,
+								  ARA_ADDR, &ara ) )
+				break;
+			ATOMIC_ADD( G_alertStats.araReads, 1 );
+			a = AlertEngTouch( e, ara & 0xfe );
+			a->ara++;
+			a->araValid = 1;
+			a->araData = ara;
+		}
+	}
+
+	/* add alerts of this round to the windows */
+	for( i=0; i<e->roundNum; i++ ){
+		addr = e->round[i];
+		a = &e->addr[addr];
+		n = (a->sig > a->ara) ? a->sig : a->ara;
+		a->sig = a->ara = 0;
+		a->inRound = 0;
+		if( !n )
+			continue;
+		alerting++;
+
+		if( !a->count ){
+			a->tFirst = now;
+			e->active[e->activeNum++] = addr;
+		}
+		a->tLast = now;
+		a->count += n;
+
+		/* status register of the device */
+		preSize = 0;
+		AlertLock();
+		if( (alertNode = AlertFindByAddr( e->h, addr )) ){
+			preCmd = alertNode->preCmd;
+			preSize = alertNode->preSize;
+		}
+		AlertUnlock();
+		if( preSize ){
+			a->statusValid = 1;
+			if( !(a->statusRv = AlertEngBus( e, 1 )) )
+				a->statusRv = AlertPreRead( e->h, addr, preCmd, preSize,
+											&a->status );
+		}
+	}
+	e->roundNum = 0;
+
+	AlertEngBus( e, 0 );
+
+	return alerting;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Take (own=1) or release (own=0) the bus for the engine thread.
+ * Transactions of the owner bypass the arbitration (see TrxArb).
+ */
+static int32 AlertEngBus( ALERT_ENG *e, u_int32 own )
+{
+	int32 rv;
+
+	if( own && !e->busOwned ){
+		G_tlsArbDepth++;
+		if( (rv = ArbAcquire( e->h, SMB2API_PRIO_HIGH, NULL )) ){
+			G_tlsArbDepth--;
+			return rv;
+		}
+		e->busOwned = 1;
+	}
+	else if( !own && e->busOwned ){
+		ArbDrop( e->h );
+		G_tlsArbDepth--;
+		e->busOwned = 0;
+	}
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return alert state of address, added to the current round
+ */
+static ALERT_ADDR* AlertEngTouch( ALERT_ENG *e, u_int16 addr )
+{
+	ALERT_ADDR *a = &e->addr[addr % ALERT_ADDR_NUM];
+
+	if( !a->inRound ){
+		a->inRound = 1;
+		e->round[e->roundNum++] = addr % ALERT_ADDR_NUM;
+	}
+
+	return a;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Deliver alerts with expired window (all if flush), returns time
+ * until the next window expires [us]
+ */
+static u_int32 AlertEngDeliver( ALERT_ENG *e, u_int32 now, u_int32 flush )
+{
+	ALERT_ADDR	*a;
+	u_int32		winUs = e->cfg.windowMs * 1000;
+	u_int32		wait = ALERT_IDLE_US, elapsed, count, i;
+	u_int16		addr;
+
+	for( i=0; i<e->activeNum; ){
+		addr = e->active[i];
+		a = &e->addr[addr];
+		elapsed = now - a->tFirst;
+
+		if( flush || (elapsed >= winUs) ){
+			count = a->count;
+			a->count = 0;
+			e->active[i] = e->active[--e->activeNum];
+			AlertEngNotify( e, addr, count );
+			continue;
+		}
+
+		if( winUs - elapsed < wait )
+			wait = winUs - elapsed;
+		i++;
+	}
+
+	return wait;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Call alert callback and notify function for coalesced alerts
+ */
+static void AlertEngNotify( ALERT_ENG *e, u_int16 addr, u_int32 count )
+{
+	ALERT_ADDR	*a = &e->addr[addr];
+	ALERT_NODE	*alertNode;
+	void		(*cbFunc)( void *cbArg ) = NULL;
+	void		(*cbFuncEx)( void *cbArg, const SMB2API_ALERT_INFO *infoP ) = NULL;
+	void		*cbArg = NULL;
+	SMB2API_ALERT_INFO info;
+
+	ATOMIC_ADD( G_alertStats.notifies, 1 );
+	ATOMIC_ADD( G_alertStats.coalesced, count - 1 );
+
+	/* alert information of the window */
+	info.addr = addr;
+	info.count = count;
+	info.tFirstUs = a->tFirst;
+	info.tLastUs = a->tLast;
+	info.araValid = a->araValid;
+	info.araData = a->araData;
+	info.statusValid = a->statusValid;
+	info.status = a->status;
+	info.statusRv = a->statusRv;
+	a->araValid = a->statusValid = 0;
+
+	AlertLock();
+	if( (alertNode = AlertFindByAddr( e->h, addr )) ){
+		cbFunc = alertNode->cbFunc;
+		cbFuncEx = alertNode->cbFuncEx;
+		cbArg = alertNode->cbArg;
+	}
+	AlertUnlock();
+
+	if( cbFuncEx ){
+		ATOMIC_ADD( G_alertStats.callbacks, 1 );
+		cbFuncEx( cbArg, &info );
+	}
+	else if( cbFunc ){
+		ATOMIC_ADD( G_alertStats.callbacks, 1 );
+		cbFunc( cbArg );
+	}
+
+	if( e->cfg.notifyFunc )
+		e->cfg.notifyFunc( e->cfg.notifyArg, addr, count );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return access descriptor for readWrite/size or NULL if not supported
+ */
+static const OP_DESC* OpFind( u_int8 readWrite, u_int8 size )
+{
+	const OP_DESC *op;
+
+	if( (size >= OP_TBL_SIZE) || (G_opTbl[size].size != size) )
+		return NULL;
+
+	op = &G_opTbl[size].op[readWrite == SMB_READ ? 1 : 0];
+	if( !op->code )
+		return NULL;
+
+	return op;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Build transfer object and getstat/setstat block for an access
+ * (library flags are removed from the transfer object)
+ */
+static void OpInit(
+	const OP_DESC	*op,
+	u_int32			flags,
+	u_int16			addr,
+	u_int8			readWrite,
+	u_int8			cmdAddr,
+	OP_TRX			*t,
+	M_SG_BLOCK		*blk )
+{
+	zeroOut( (int8*)t, sizeof(OP_TRX) );
+	flags &= ~SMB2API_FLAG_LIB_MASK;
+
+	if( op->dataKind == OP_DATA_BLOCK ){
+		t->trxBlk.flags = flags;
+		t->trxBlk.addr = addr;
+		t->trxBlk.cmdAddr = cmdAddr;
+		blk->size = sizeof(SMB2_TRANSFER_BLOCK);
+	}
+	else {
+		t->trx.flags = flags;
+		t->trx.addr = addr;
+		t->trx.readWrite = readWrite;
+		t->trx.cmdAddr = cmdAddr;
+		blk->size = sizeof(SMB2_TRANSFER);
+	}
+	blk->data = (void*)t;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Copy data from SmbXfer data buffer into transfer object
+ */
+static int32 OpDataIn( const OP_DESC *op, void *trxP, u_int8 *dataP )
+{
+	SMB2_TRANSFER		*trx = (SMB2_TRANSFER*)trxP;
+	SMB2_TRANSFER_BLOCK	*trxBlk = (SMB2_TRANSFER_BLOCK*)trxP;
+
+	if( !(op->dir & OP_DIR_IN) ){
+		/* block read: length is returned by the device */
+		if( op->dataKind == OP_DATA_BLOCK )
+			trxBlk->u.length = 0;
+		return 0;
+	}
+
+	switch( op->dataKind ){
+	case OP_DATA_BYTE:
+		trx->u.byteData = dataP[0];
+		break;
+	case OP_DATA_WORD:
+		trx->u.wordData = *(u_int16*)dataP;
+		break;
+	case OP_DATA_BLOCK:
+		if( (dataP[0] < 1) || (dataP[0] > SMB_BLOCK_MAX_BYTES) )
+			return (SMB_ERR_PARAM);
+		trxBlk->u.length = dataP[0];
+		memcpy( (void*)trxBlk->data, (void*)(dataP + 1), dataP[0] );
+		break;
+	}
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Copy data from transfer object into SmbXfer data buffer
+ */
+static void OpDataOut( const OP_DESC *op, void *trxP, u_int8 *dataP )
+{
+	SMB2_TRANSFER		*trx = (SMB2_TRANSFER*)trxP;
+	SMB2_TRANSFER_BLOCK	*trxBlk = (SMB2_TRANSFER_BLOCK*)trxP;
+	u_int8				writeLen;
+
+	if( !(op->dir & OP_DIR_OUT) )
+		return;
+
+	switch( op->dataKind ){
+	case OP_DATA_BYTE:
+		dataP[0] = trx->u.byteData;
+		break;
+	case OP_DATA_WORD:
+		*(u_int16*)dataP = trx->u.wordData;
+		break;
+	case OP_DATA_BLOCK:
+		/* block process call: read data follows the written data */
+		if( op->dir & OP_DIR_IN ){
+			writeLen = dataP[0];
+			dataP[0] = trxBlk->readLen;
+			memcpy( (void*)(dataP + 1), (void*)(trxBlk->data + writeLen),
+					dataP[0] );
+		}
+		else {
+			dataP[0] = trxBlk->u.length;
+			memcpy( (void*)(dataP + 1), (void*)trxBlk->data, dataP[0] );
+		}
+		break;
+	}
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Issue getstat/setstat with transfer object
+ * (library flags are removed from the object before the driver call)
+ */
+static int32 BlkStat(
+	SMB_HANDLE	*h,
+	int32		code,
+	u_int32		isGet,
+	void		*obj,
+	u_int32		size )
+{
+	M_SG_BLOCK	blk;
+	u_int32		flags = 0;
+
+	switch( code ){
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+	case SMB2_BLK_READ_BLOCK_DATA:
+		flags = ((SMB2_TRANSFER_BLOCK*)obj)->flags;
+		((SMB2_TRANSFER_BLOCK*)obj)->flags &= ~SMB2API_FLAG_LIB_MASK;
+		break;
+	case SMB2_BLK_I2C_XFER:
+	case SMB2_BLK_ALERT_CB_INSTALL:
+	case SMB2_BLK_ALERT_CB_REMOVE:
+		/* no flags */
+		break;
+	default:
+		flags = ((SMB2_TRANSFER*)obj)->flags;
+		((SMB2_TRANSFER*)obj)->flags &= ~SMB2API_FLAG_LIB_MASK;
+	}
+
+	blk.size = size;
+	blk.data = obj;
+
+	return TrxExec( h, code, isGet, &blk, flags );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Execute one transaction (traced)
+ */
+static int32 TrxExec(
+	SMB_HANDLE	*h,
+	int32		code,
+	u_int32		isGet,
+	M_SG_BLOCK	*blk,
+	u_int32		flags )
+{
+	int32	rv;
+#if defined(SMB2API_USDT)
+	u_int8	cmdAddr;
+	u_int16	addr = TrcAddr( code, blk->data, &cmdAddr );
+#endif
+
+	TRC5( trx__entry, h, code, addr, cmdAddr, blk->size );
+	rv = TrxArb( h, code, isGet, blk, flags );
+	TRC4( trx__return, h, code, addr, rv );
+
+	return rv;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Execute one transaction (driver call) under control of the bus arbiter
+ */
+static int32 TrxArb(
+	SMB_HANDLE	*h,
+	int32		code,
+	u_int32		isGet,
+	M_SG_BLOCK	*blk,
+	u_int32		flags )
+{
+	u_int32	prio, tReq, tBus, tEnd, dl, *dlP = NULL, overrun = 0, bytes, bits;
+	u_int32	inLen = 0, nested = G_tlsArbDepth;
+	u_int16	addr = PresAddr( code, blk->data );
+	int32	rv;
+	SMB_HANDLE *root = h->root;
+
+	/*
+	 * Alert callback in signal context: the interrupted thread may
+	 * hold the arbiter lock, so no locks are taken. The driver is
+	 * called directly, without statistics, recording and routing.
+	 */
+	if( G_tlsInSig )
+		return TrxCall( h, code, isGet, blk );
+
+	tReq = TimeUsec();
+
+	/* device known to be absent: fail without bus access */
+	if( root->presTtlUs && !(flags & SMB2API_FLAG_RESCAN) &&
+		(rv = PresCached( root, addr, tReq )) )
+		return rv;
+
+	/* priority class from flags or thread default */
+	prio = (flags & SMB2API_FLAG_PRIO_MASK) >> SMB2API_FLAG_PRIO_SHIFT;
+	prio = prio ? prio - 1 : G_tlsPrio;
+
+	/* deadline: earlier one of handle and thread deadline */
+	if( h->dlUs ){
+		dl = tReq + h->dlUs;
+		dlP = &dl;
+	}
+	if( G_tlsDlSet && (!dlP || (int32)(G_tlsDl - dl) < 0) ){
+		dl = G_tlsDl;
+		dlP = &dl;
+	}
+
+	/*
+	 * Nested call of this thread (bus held by the calling function,
+	 * e.g. SMB2API_GatherRead): no arbitration, otherwise the thread
+	 * would wait for itself. Rate limits and throttling are applied by
+	 * the calling function before it takes the bus. The transaction is
+	 * recorded and counted like any other.
+	 */
+	if( nested ){
+		if( dlP && (int32)(tReq - dl) >= 0 )
+			return (SMB2API_ERR_DEADLINE);
+	}
+	else {
+		/*
+		 * rate limited device: wait without owning the bus
+		 * (I2C: address of the first message)
+		 */
+		if( root->rate &&
+			(rv = RateWait( root, code == SMB2_BLK_I2C_XFER ?
+							((SMB_I2CMESSAGE*)blk->data)->addr : addr, dlP )) )
+			return rv;
+
+		G_tlsArbDepth++;
+
+		/* background work: keep bus utilization below target */
+		if( (prio == SMB2API_PRIO_LOW) && root->arb.util.target &&
+			(rv = UtilThrottle( root, dlP )) ){
+			G_tlsArbDepth--;
+			return rv;
+		}
+
+		if( (rv = ArbAcquire( h, prio, dlP )) ){
+			G_tlsArbDepth--;
+			return rv;
+		}
+	}
+	/*
+	 * recording: save request (bus is owned), objects too large for a
+	 * record fail
+	 */
+	if( h->rec &&
+		(rv = RecEncode( code, blk->data, blk->size,
+						 h->rec->buf + REC_HDR_LEN, 2*REC_OBJ_MAX, 0,
+						 &inLen )) ){
+		if( !nested ){
+			ArbDrop( h );
+			G_tlsArbDepth--;
+		}
+		return rv;
+	}
+
+	tBus = TimeUsec();
+
+	G_tlsTrxPrio = prio;
+	rv = CapStat( h, code, isGet, blk, flags );
+
+	tEnd = TimeUsec();
+
+	PresUpdate( root, addr, rv, tEnd );
+
+	if( h->rec )
+		RecWrite( h->rec, code, isGet, flags, rv, tBus, tEnd, inLen,
+				  blk->data, blk->size );
+
+	/* deadline passed during the driver call? */
+	if( dlP && (int32)(tEnd - dl) > 0 ){
+		overrun = 1;
+		rv = SMB2API_ERR_OVERRUN;
+	}
+
+	/* nested: the bus stays owned by the calling function */
+	bytes = TrxBusBytes( code, blk->data, blk->size, &bits );
+	bits = (u_int32)(((u_int64)bits * 1000000) / root->arb.util.busClk);
+	if( nested )
+		ArbStat( root, prio, tReq, tBus, overrun, bytes, bits );
+	else {
+		ArbRelease( h, prio, tReq, tBus, overrun, bytes, bits );
+		G_tlsArbDepth--;
+	}
+
+	return rv;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Wait until the bus is free and no transaction of a higher priority
+ * class is waiting, then take the bus.
+ * Returns SMB2API_ERR_DEADLINE if the deadline *dlP passed before.
+ */
+static int32 ArbAcquire( SMB_HANDLE *h, u_int32 prio, const u_int32 *dlP )
+{
+	ARBITER	*a = &h->arb;
+	u_int32	c, higher;
+	int32	left;
+
+	MtxLock( &a->mtx );
+	a->waiting[prio]++;
+
+	for(;;){
+		for( higher=0, c=prio+1; c<SMB2API_PRIO_NUM; c++ )
+			higher += a->waiting[c];
+
+		if( !a->busy && !higher )
+			break;
+
+		if( !dlP ){
+			CondWait( &a->cond[prio], &a->mtx );
+			continue;
+		}
+
+		/* drop the transaction if its deadline passed */
+		if( (left = (int32)(*dlP - TimeUsec())) <= 0 ){
+			a->waiting[prio]--;
+			/* we may have blocked lower classes */
+			ArbWakeup( a );
+			MtxUnlock( &a->mtx );
+
+			/* counted by the parent for clones */
+			MtxLock( &h->root->arb.mtx );
+			h->root->arb.dlDropped++;
+			MtxUnlock( &h->root->arb.mtx );
+			return (SMB2API_ERR_DEADLINE);
+		}
+		CondTimedWait( &a->cond[prio], &a->mtx, (u_int32)left );
+	}
+
+	a->waiting[prio]--;
+	a->busy = 1;
+	MtxUnlock( &a->mtx );
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Release the bus without transaction statistics
+ */
+static void ArbDrop( SMB_HANDLE *h )
+{
+	MtxLock( &h->arb.mtx );
+	h->arb.busy = 0;
+	ArbWakeup( &h->arb );
+	MtxUnlock( &h->arb.mtx );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Own the bus for several transactions of the calling function (nested
+ * calls of TrxArb), unless owned already. Rate limits must be waited for
+ * before.
+ */
+static int32 ArbHold( SMB_HANDLE *h, u_int32 prio )
+{
+	int32 rv;
+
+	if( G_tlsArbDepth++ )
+		return 0;
+
+	/* background work: keep bus utilization below target */
+	if( (prio == SMB2API_PRIO_LOW) && h->root->arb.util.target &&
+		(rv = UtilThrottle( h->root, NULL )) ){
+		G_tlsArbDepth--;
+		return rv;
+	}
+
+	if( (rv = ArbAcquire( h, prio, NULL )) )
+		G_tlsArbDepth--;
+
+	return rv;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Release the bus owned by ArbHold, if taken there
+ */
+static void ArbUnhold( SMB_HANDLE *h )
+{
+	if( !--G_tlsArbDepth )
+		ArbDrop( h );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Call backend or driver for one operation
+ */
+static int32 TrxCall(
+	SMB_HANDLE	*h,
+	int32		code,
+	u_int32		isGet,
+	M_SG_BLOCK	*blk )
+{
+	int32 rv;
+#if defined(SMB2API_USDT)
+	u_int8	cmdAddr;
+	u_int16	addr = TrcAddr( code, blk->data, &cmdAddr );
+#endif
+
+	TRC5( drv__entry, h, code, addr, cmdAddr, blk->size );
+
+	if( h->be )
+		rv = h->be->Stat( h->beArg, code, isGet, blk->data, blk->size );
+	else {
+		if( isGet )
+			rv = M_getstat( h->path, code, (int32 *)blk );
+		else
+			rv = M_setstat( h->path, code, (INT32_OR_64)blk );
+		if( rv )
+			rv = UOS_ErrnoGet();
+	}
+
+	TRC4( drv__return, h, code, addr, rv );
+
+	return rv;
+}
+
+#if defined(SMB2API_USDT)
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return device address and command of a transfer object (probe args),
+ * I2C: address of the first message
+ */
+static u_int16 TrcAddr( int32 code, void *obj, u_int8 *cmdAddrP )
+{
+	*cmdAddrP = 0;
+
+	switch( code ){
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+	case SMB2_BLK_READ_BLOCK_DATA:
+		*cmdAddrP = ((SMB2_TRANSFER_BLOCK*)obj)->cmdAddr;
+		return ((SMB2_TRANSFER_BLOCK*)obj)->addr;
+	case SMB2_BLK_I2C_XFER:
+		return ((SMB_I2CMESSAGE*)obj)->addr;
+	case SMB2_BLK_ALERT_CB_INSTALL:
+	case SMB2_BLK_ALERT_CB_REMOVE:
+		return ((SMB2_ALERT*)obj)->addr;
+	}
+
+	*cmdAddrP = ((SMB2_TRANSFER*)obj)->cmdAddr;
+	return ((SMB2_TRANSFER*)obj)->addr;
+}
+#endif
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Execute one operation natively or emulated with I2C messages
+ * (bus must be owned)
+ *
+ * The capabilities are learned from the operations: a path is supported
+ * after the first success and unsupported after SMB_ERR_NOT_SUPPORTED.
+ * An unsupported native operation is retried emulated. With
+ * SMB2API_ROUTE_FASTEST the path with the lower average time is used and
+ * the other one is measured again every CAP_EXPLORE operations. For
+ * operations without emulation only the native capability is learned.
+ */
+static int32 CapStat(
+	SMB_HANDLE	*h,
+	int32		code,
+	u_int32		isGet,
+	M_SG_BLOCK	*blk,
+	u_int32		flags )
+{
+	CAP		*c;
+	u_int32	idx = (u_int32)(code - SMB2_BLK_QUICK_COMM), emul, t, fast;
+	u_int32	*avgP;
+	int32	rv;
+
+	if( (h->route == SMB2API_ROUTE_NATIVE) ||
+		(flags & ~SMB2API_FLAG_LIB_MASK) || (idx >= CAP_OP_NUM) )
+		return TrxCall( h, code, isGet, blk );
+
+	/* block process call has its own entry */
+	if( (code == SMB2_BLK_READ_BLOCK_DATA) &&
+		((SMB2_TRANSFER_BLOCK*)blk->data)->u.writeLen )
+		idx = CAP_BLK_PROC;
+
+	c = &h->cap[idx];
+
+	if( !CapEmulOk( code, flags ) ){
+		rv = TrxCall( h, code, isGet, blk );
+		if( rv == SMB_ERR_NOT_SUPPORTED )
+			c->native = SMB2API_CAP_NO;
+		else if( !rv )
+			c->native = SMB2API_CAP_YES;
+		return rv;
+	}
+
+	/* select path */
+	if( c->native == SMB2API_CAP_NO )
+		emul = 1;
+	else if( (h->route != SMB2API_ROUTE_FASTEST) ||
+			 (c->native == SMB2API_CAP_UNKNOWN) ||
+			 (c->emul == SMB2API_CAP_NO) )
+		emul = 0;
+	else if( c->emul == SMB2API_CAP_UNKNOWN )
+		emul = 1;
+	else {
+		fast = c->emulUs < c->nativeUs;
+		if( ++c->count >= CAP_EXPLORE ){
+			c->count = 0;
+			emul = !fast;
+		}
+		else
+			emul = fast;
+	}
+
+	for( ;; ){
+		t = TimeUsec();
+		rv = emul ? CapEmulate( h, code, blk->data ) :
+					TrxCall( h, code, isGet, blk );
+		t = TimeUsec() - t;
+
+		if( rv == SMB_ERR_NOT_SUPPORTED ){
+			if( emul ){
+				c->emul = SMB2API_CAP_NO;
+				break;
+			}
+			c->native = SMB2API_CAP_NO;
+			if( c->emul == SMB2API_CAP_NO )
+				break;
+			emul = 1;
+			continue;
+		}
+
+		/* other errors (e.g. absent device) say nothing about the path */
+		if( !rv ){
+			if( emul ){
+				c->emul = SMB2API_CAP_YES;
+				c->emulCnt++;
+				avgP = &c->emulUs;
+			}
+			else {
+				c->native = SMB2API_CAP_YES;
+				avgP = &c->nativeUs;
+			}
+			*avgP = *avgP ?
+				*avgP + ((int32)(t - *avgP) >> CAP_AVG_SHIFT) : (t ? t : 1);
+		}
+		break;
+	}
+
+	return rv;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Check if an operation can be emulated with I2C messages
+ * (no driver flags, e.g. PEC, since the I2C messages cannot carry them)
+ *
+ * Block reads and block process calls are not emulated: the length is
+ * not known before, the read of the length byte and SMB_BLOCK_MAX_BYTES
+ * would access the device beyond the block.
+ */
+static u_int32 CapEmulOk( int32 code, u_int32 flags )
+{
+	if( flags & ~SMB2API_FLAG_LIB_MASK )
+		return 0;
+
+	switch( code ){
+	case SMB2_BLK_WRITE_BYTE:
+	case SMB2_BLK_READ_BYTE:
+	case SMB2_BLK_WRITE_BYTE_DATA:
+	case SMB2_BLK_READ_BYTE_DATA:
+	case SMB2_BLK_WRITE_WORD_DATA:
+	case SMB2_BLK_READ_WORD_DATA:
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+	case SMB2_BLK_PROCESS_CALL:
+		return 1;
+	}
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Emulate an SMBus operation with I2C messages (bus must be owned)
+ *
+ * The messages are passed to the driver in one I2C transfer, so the
+ * read follows the command write with a repeated start (no STOP in
+ * between, as the SMBus protocols require).
+ */
+static int32 CapEmulate( SMB_HANDLE *h, int32 code, void *obj )
+{
+	SMB2_TRANSFER		*trx = (SMB2_TRANSFER*)obj;
+	SMB2_TRANSFER_BLOCK	*trxBlk = (SMB2_TRANSFER_BLOCK*)obj;
+	SMB_I2CMESSAGE		msg[I2C_XFER_MSG_MAX];
+	M_SG_BLOCK			blk;
+	u_int8				wBuf[2 + SMB_BLOCK_MAX_BYTES];
+	u_int8				rBuf[2];
+	u_int32				num = 2;
+	int32				rv;
+
+	/* write command (and data), read result */
+	msg[0].addr = trx->addr;
+	msg[0].flags = 0;
+	msg[0].buf = wBuf;
+	msg[0].len = 1;
+	msg[1].addr = trx->addr;
+	msg[1].flags = I2C_M_RD;
+	msg[1].buf = rBuf;
+	msg[1].len = 0;
+	wBuf[0] = trx->cmdAddr;
+
+	switch( code ){
+	case SMB2_BLK_WRITE_BYTE:
+		wBuf[0] = trx->u.byteData;
+		num = 1;
+		break;
+	case SMB2_BLK_READ_BYTE:
+		msg[0] = msg[1];
+		msg[0].len = 1;
+		num = 1;
+		break;
+	case SMB2_BLK_WRITE_BYTE_DATA:
+		wBuf[1] = trx->u.byteData;
+		msg[0].len = 2;
+		num = 1;
+		break;
+	case SMB2_BLK_READ_BYTE_DATA:
+		msg[1].len = 1;
+		break;
+	case SMB2_BLK_WRITE_WORD_DATA:
+		wBuf[1] = (u_int8)trx->u.wordData;
+		wBuf[2] = (u_int8)(trx->u.wordData >> 8);
+		msg[0].len = 3;
+		num = 1;
+		break;
+	case SMB2_BLK_READ_WORD_DATA:
+		msg[1].len = 2;
+		break;
+	case SMB2_BLK_PROCESS_CALL:
+		wBuf[1] = (u_int8)trx->u.wordData;
+		wBuf[2] = (u_int8)(trx->u.wordData >> 8);
+		msg[0].len = 3;
+		msg[1].len = 2;
+		break;
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+		msg[0].addr = msg[1].addr = trxBlk->addr;
+		wBuf[0] = trxBlk->cmdAddr;
+		wBuf[1] = trxBlk->u.length;
+		memcpy( (void*)(wBuf + 2), (void*)trxBlk->data, trxBlk->u.length );
+		msg[0].len = 2 + trxBlk->u.length;
+		num = 1;
+		break;
+	default:
+		return (SMB_ERR_NOT_SUPPORTED);
+	}
+
+	blk.size = num * sizeof(SMB_I2CMESSAGE);
+	blk.data = (void*)msg;
+	if( (rv = TrxCall( h, SMB2_BLK_I2C_XFER, 1, &blk )) )
+		return rv;
+
+	switch( code ){
+	case SMB2_BLK_READ_BYTE:
+		trx->u.byteData = rBuf[0];
+		break;
+	case SMB2_BLK_READ_BYTE_DATA:
+		trx->u.byteData = rBuf[0];
+		break;
+	case SMB2_BLK_READ_WORD_DATA:
+	case SMB2_BLK_PROCESS_CALL:
+		trx->u.wordData = (u_int16)(rBuf[0] | (rBuf[1] << 8));
+		break;
+	}
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Sequential register/memory read/write with I2C messages
+ * (addrLen address bytes, MSB first, max. MEM_SEQ_MAX data bytes)
+ *
+ * The address pointer write and the data message are passed in one I2C
+ * transfer (repeated start), so no other transaction can move the
+ * pointer.
+ */
+static int32 MemSeq(
+	SMB_HANDLE	*h,
+	u_int32		flags,
+	u_int16		addr,
+	u_int32		memAddr,
+	u_int32		addrLen,
+	u_int8		*dataP,
+	u_int32		num,
+	u_int32		isRead )
+{
+	SMB_I2CMESSAGE	msg[I2C_XFER_MSG_MAX];
+	M_SG_BLOCK		blk;
+	u_int8			wBuf[2 + MEM_SEQ_MAX];
+
+	if( addrLen == 2 )
+		wBuf[0] = (u_int8)(memAddr >> 8);
+	wBuf[addrLen - 1] = (u_int8)memAddr;
+	msg[0].addr = addr;
+	msg[0].flags = 0;
+	msg[0].buf = wBuf;
+	msg[0].len = (u_int16)addrLen;
+	msg[1].addr = addr;
+	msg[1].flags = I2C_M_RD;
+	msg[1].buf = dataP;
+	msg[1].len = (u_int16)num;
+
+	/* write: address pointer and data in one message */
+	if( !isRead ){
+		memcpy( (void*)(wBuf + addrLen), (void*)dataP, num );
+		msg[0].len = (u_int16)(addrLen + num);
+	}
+
+	blk.size = ((isRead && num) ? 2 : 1) * sizeof(SMB_I2CMESSAGE);
+	blk.data = (void*)msg;
+
+	return TrxExec( h, SMB2_BLK_I2C_XFER, 1, &blk,
+					flags & SMB2API_FLAG_LIB_MASK );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Check memory range for the address length of mode
+ */
+static int32 MemCheck( u_int32 mode, u_int32 memAddr, u_int32 len )
+{
+	u_int32 size = (mode & SMB2API_MEM_ADDR16) ? 0x10000 : 0x100;
+
+	if( (memAddr > size) || (len > size - memAddr) )
+		return (SMB_ERR_PARAM);
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Fill the slicing-by-8 CRC-32 tables
+ *
+ * Table n is the CRC of a byte followed by n zero bytes. Concurrent
+ * first calls compute the same values, the flag is set after the tables.
+ */
+static void CrcInit( void )
+{
+	u_int32 i, j, c;
+
+	for( i=0; i<256; i++ ){
+		c = i;
+		for( j=0; j<8; j++ )
+			c = (c >> 1) ^ (CRC_POLY & (0 - (c & 1)));
+		G_crcTbl[0][i] = c;
+	}
+
+	for( i=0; i<256; i++ ){
+		for( j=1; j<8; j++ ){
+			c = G_crcTbl[j-1][i];
+			G_crcTbl[j][i] = (c >> 8) ^ G_crcTbl[0][c & 0xff];
+		}
+	}
+
+	ATOMIC_OR( G_crcInit, 1 );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Wake up the highest waiting priority class if the bus is free
+ * (arbiter must be locked)
+ */
+static void ArbWakeup( ARBITER *a )
+{
+	u_int32 c;
+
+	if( a->busy )
+		return;
+
+	for( c=SMB2API_PRIO_NUM; c>0; c-- ){
+		if( a->waiting[c-1] ){
+			CondBroadcast( &a->cond[c-1] );
+			break;
+		}
+	}
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Release the bus, wake up the highest waiting priority class and
+ * update the statistics
+ */
+static void ArbRelease(
+	SMB_HANDLE	*h,
+	u_int32		prio,
+	u_int32		tReq,
+	u_int32		tBus,
+	u_int32		overrun,
+	u_int32		bytes,
+	u_int32		busUs )
+{
+	ArbDrop( h );
+
+	/* statistics of clones are kept by the parent */
+	ArbStat( h->root, prio, tReq, tBus, overrun, bytes, busUs );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Count a transaction in the statistics of the bus arbiter of root
+ * (latency, deadline overruns, bus utilization)
+ */
+static void ArbStat(
+	SMB_HANDLE	*root,
+	u_int32		prio,
+	u_int32		tReq,
+	u_int32		tBus,
+	u_int32		overrun,
+	u_int32		bytes,
+	u_int32		busUs )
+{
+	ARBITER		*a = &root->arb;
+	PRIO_STATS	*ps;
+	u_int32		now, lat, wait, n;
+
+	now = TimeUsec();
+	lat = now - tReq;
+	wait = tBus - tReq;
+
+	MtxLock( &a->mtx );
+	ps = &a->stats[prio];
+
+	a->dlOverrun += overrun;
+
+	UtilUpdate( &a->util, now );
+	a->util.winBusyUs += busUs;
+	a->util.winBytes += bytes;
+	a->util.winTrx++;
+
+	ps->count++;
+	ps->sumUs += lat;
+	ps->sumWaitUs += wait;
+	if( lat > ps->maxUs )
+		ps->maxUs = lat;
+	if( wait > ps->maxWaitUs )
+		ps->maxWaitUs = wait;
+
+	/* bucket n: latency < 2^n us */
+	for( n=0; (lat >> n) && (n < LAT_HIST_NUM-1); n++ )
+		;
+	ps->hist[n]++;
+
+	MtxUnlock( &a->mtx );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Delay a background transaction while the bus utilization is above
+ * the target (checked at the end of each averaging window)
+ */
+static int32 UtilThrottle( SMB_HANDLE *h, const u_int32 *dlP )
+{
+	ARBITER	*a = &h->arb;
+	u_int32	now, over, waitUs;
+
+	for(;;){
+		now = TimeUsec();
+
+		MtxLock( &a->mtx );
+		UtilUpdate( &a->util, now );
+		over = a->util.avgUtil >= (a->util.target << 8);
+		waitUs = UTIL_WIN_US - (now - a->util.winStart);
+		if( over )
+			a->util.throttled++;
+		MtxUnlock( &a->mtx );
+
+		if( !over )
+			return 0;
+
+		if( dlP && (int32)(*dlP - (now + waitUs)) <= 0 ){
+			MtxLock( &a->mtx );
+			a->dlDropped++;
+			MtxUnlock( &a->mtx );
+			return (SMB2API_ERR_DEADLINE);
+		}
+
+		UOS_Delay( (waitUs + 999) / 1000 );
+	}
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Wait until a transaction to a rate limited device conforms
+ * (bus not owned)
+ *
+ * A transaction conforms if it is not earlier than its theoretical
+ * arrival time minus the burst tolerance; the arrival time then
+ * advances by one period (equivalent to a token bucket).
+ */
+static int32 RateWait( SMB_HANDLE *h, u_int16 addr, const u_int32 *dlP )
+{
+	RATE	*r;
+	u_int32	now, waitUs, deferred = 0;
+
+	if( addr >= RATE_ADDR_NUM )
+		return 0;
+
+	for(;;){
+		now = TimeUsec();
+
+		MtxLock( &h->arb.mtx );
+		r = &h->rate[addr];
+		if( !r->periodUs ){
+			MtxUnlock( &h->arb.mtx );
+			return 0;
+		}
+
+		/* idle device (or stale time after wrap): full burst available */
+		if( (int32)(now - r->tat) > 0 ||
+			(r->tat - now) > r->burstUs + r->periodUs )
+			r->tat = now;
+
+		waitUs = r->tat - r->burstUs - now;
+		if( (int32)waitUs <= 0 ){
+			r->tat += r->periodUs;
+			MtxUnlock( &h->arb.mtx );
+			return 0;
+		}
+
+		if( !deferred ){
+			h->rateStats.deferred++;
+			deferred = 1;
+		}
+		h->rateStats.waitUs += waitUs;
+
+		if( dlP && (int32)(*dlP - (now + waitUs)) <= 0 ){
+			h->arb.dlDropped++;
+			MtxUnlock( &h->arb.mtx );
+			return (SMB2API_ERR_DEADLINE);
+		}
+		MtxUnlock( &h->arb.mtx );
+
+		UOS_Delay( (waitUs + 999) / 1000 );
+	}
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Close elapsed averaging windows and update the moving averages
+ * (arbiter must be locked)
+ */
+static void UtilUpdate( UTIL *u, u_int32 now )
+{
+	u_int32 n, util;
+
+	for( n=0; (now - u->winStart) >= UTIL_WIN_US; n++ ){
+
+		/* long idle: restart averaging */
+		if( n == UTIL_GAP_MAX ){
+			u->avgUtil = u->avgBytes = u->avgTrx = 0;
+			u->winStart = now;
+			break;
+		}
+
+		util = (u->winBusyUs * 1000) / UTIL_WIN_US;
+		if( util > 1000 )
+			util = 1000;
+
+		u->avgUtil += ((util << 8) >> UTIL_AVG_SHIFT) -
+					  (u->avgUtil >> UTIL_AVG_SHIFT);
+		u->avgBytes += (((u->winBytes * (1000000 / UTIL_WIN_US)) << 8) >>
+						UTIL_AVG_SHIFT) - (u->avgBytes >> UTIL_AVG_SHIFT);
+		u->avgTrx += (((u->winTrx * (1000000 / UTIL_WIN_US)) << 8) >>
+					  UTIL_AVG_SHIFT) - (u->avgTrx >> UTIL_AVG_SHIFT);
+
+		u->winBusyUs = u->winBytes = u->winTrx = 0;
+		u->winStart += UTIL_WIN_US;
+	}
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return number of bytes on the bus for a completed transaction and
+ * estimated bus bits (9 bits per byte + START/STOP + repeated START)
+ */
+static u_int32 TrxBusBytes(
+	int32		code,
+	void		*obj,
+	u_int32		size,
+	u_int32		*bitsP )
+{
+	SMB2_TRANSFER_BLOCK	*trxBlk = (SMB2_TRANSFER_BLOCK*)obj;
+	SMB_I2CMESSAGE		*msg = (SMB_I2CMESSAGE*)obj;
+	u_int32				bytes, rs = 0, n;
+
+	switch( code ){
+	case SMB2_BLK_QUICK_COMM:		bytes = 1;				break;
+	case SMB2_BLK_WRITE_BYTE:
+	case SMB2_BLK_READ_BYTE:		bytes = 2;				break;
+	case SMB2_BLK_ALERT_RESPONSE:	bytes = 2;				break;
+	case SMB2_BLK_WRITE_BYTE_DATA:	bytes = 3;				break;
+	case SMB2_BLK_READ_BYTE_DATA:	bytes = 4;	rs = 1;		break;
+	case SMB2_BLK_WRITE_WORD_DATA:	bytes = 4;				break;
+	case SMB2_BLK_READ_WORD_DATA:	bytes = 5;	rs = 1;		break;
+	case SMB2_BLK_PROCESS_CALL:		bytes = 7;	rs = 1;		break;
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+		bytes = 3 + trxBlk->u.length;
+		break;
+	case SMB2_BLK_READ_BLOCK_DATA:
+		/* block read: length, block process call: writeLen + readLen */
+		bytes = 4 + trxBlk->u.length + trxBlk->readLen;
+		rs = 1;
+		break;
+	case SMB2_BLK_I2C_XFER:
+		/* repeated start between the messages */
+		for( bytes=n=0; n<size/sizeof(SMB_I2CMESSAGE); n++ )
+			bytes += 1 + msg[n].len;
+		rs = n ? n - 1 : 0;
+		break;
+	default:
+		/* no bus access (e.g. alert callback install) */
+		*bitsP = 0;
+		return 0;
+	}
+
+	*bitsP = bytes * 9 + 2 + rs;
+	return bytes;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Encode transfer object for record file (little endian).
+ * isOut=0: request, isOut=1: result (I2C: only read data)
+ *
+ *  SMB2_TRANSFER       : flags(4) addr(2) readWrite(1) cmdAddr(1)
+ *                        byteData(1) wordData(2)
+ *  SMB2_TRANSFER_BLOCK : flags(4) addr(2) cmdAddr(1) length(1) readLen(1)
+ *                        n(1) data(n)
+ *  SMB_I2CMESSAGE[]    : num(2), per message:
+ *                        addr(2) flags(2) len(2) n(2) data(n)
+ *  SMB2_ALERT          : addr(2) sigCode(4)
+ *
+ * size is the size of the transfer object (number of I2C messages).
+ * *lenP gets the encoded length. Returns SMB_ERR_PARAM if the I2C data
+ * exceed REC_I2C_MAX or the encoding exceeds bufLen.
+ */
+static int32 RecEncode(
+	int32		code,
+	void		*obj,
+	u_int32		size,
+	u_int8		*buf,
+	u_int32		bufLen,
+	u_int32		isOut,
+	u_int32		*lenP )
+{
+	SMB2_TRANSFER		*trx = (SMB2_TRANSFER*)obj;
+	SMB2_TRANSFER_BLOCK	*trxBlk = (SMB2_TRANSFER_BLOCK*)obj;
+	SMB_I2CMESSAGE		*msg = (SMB_I2CMESSAGE*)obj;
+	SMB2_ALERT			*alert = (SMB2_ALERT*)obj;
+	u_int32				n, m, num, len, i2cLen;
+
+	switch( code ){
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+	case SMB2_BLK_READ_BLOCK_DATA:
+		n = trxBlk->u.length + trxBlk->readLen;
+		if( n > SMB_BLOCK_MAX_BYTES )
+			n = SMB_BLOCK_MAX_BYTES;
+		if( 10 + n > bufLen )
+			return (SMB_ERR_PARAM);
+		PutLe( buf + 0, trxBlk->flags, 4 );
+		PutLe( buf + 4, trxBlk->addr, 2 );
+		buf[6] = trxBlk->cmdAddr;
+		buf[7] = trxBlk->u.length;
+		buf[8] = trxBlk->readLen;
+		buf[9] = (u_int8)n;
+		memcpy( buf + 10, trxBlk->data, n );
+		*lenP = 10 + n;
+		return 0;
+
+	case SMB2_BLK_I2C_XFER:
+		num = size / sizeof(SMB_I2CMESSAGE);
+		if( num > I2C_XFER_MSG_MAX )
+			num = I2C_XFER_MSG_MAX;
+		for( i2cLen=0, m=0; m<num; m++ )
+			i2cLen += msg[m].len;
+		if( (i2cLen > REC_I2C_MAX) || (2 > bufLen) )
+			return (SMB_ERR_PARAM);
+		PutLe( buf + 0, num, 2 );
+		for( len=2, m=0; m<num; m++, msg++ ){
+			n = ((msg->flags & I2C_M_RD) ? isOut : !isOut) ? msg->len : 0;
+			if( 8 + n > bufLen - len )
+				return (SMB_ERR_PARAM);
+			PutLe( buf + len + 0, msg->addr, 2 );
+			PutLe( buf + len + 2, msg->flags, 2 );
+			PutLe( buf + len + 4, msg->len, 2 );
+			PutLe( buf + len + 6, n, 2 );
+			if( n )
+				memcpy( buf + len + 8, msg->buf, n );
+			len += 8 + n;
+		}
+		*lenP = len;
+		return 0;
+
+	case SMB2_BLK_ALERT_CB_INSTALL:
+	case SMB2_BLK_ALERT_CB_REMOVE:
+		if( 6 > bufLen )
+			return (SMB_ERR_PARAM);
+		PutLe( buf + 0, alert->addr, 2 );
+		PutLe( buf + 2, alert->sigCode, 4 );
+		*lenP = 6;
+		return 0;
+
+	default:
+		if( 11 > bufLen )
+			return (SMB_ERR_PARAM);
+		PutLe( buf + 0, trx->flags, 4 );
+		PutLe( buf + 4, trx->addr, 2 );
+		buf[6] = trx->readWrite;
+		buf[7] = trx->cmdAddr;
+		buf[8] = trx->u.byteData;
+		PutLe( buf + 9, trx->u.wordData, 2 );
+		*lenP = 11;
+		return 0;
+	}
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Decode transfer object of bufLen bytes (see RecEncode), *sizeP gets
+ * the size of the transfer object. size is the size of obj, it limits
+ * the number of I2C messages.
+ *
+ * i2cBuf set: request, the I2C data of all messages (write data, room
+ * for read data) are placed in i2cBuf (REC_I2C_MAX bytes) and msg->buf
+ * is set into it. i2cBuf NULL: result, the read data are copied to
+ * msg->buf, the message lengths of obj must match.
+ *
+ * Returns SMB_ERR_PARAM if the encoding is truncated, exceeds the
+ * buffers or carries data of another length than the messages.
+ */
+static int32 RecDecode(
+	int32			code,
+	const u_int8	*buf,
+	u_int32			bufLen,
+	void			*obj,
+	u_int32			size,
+	u_int8			*i2cBuf,
+	u_int32			*sizeP )
+{
+	SMB2_TRANSFER		*trx = (SMB2_TRANSFER*)obj;
+	SMB2_TRANSFER_BLOCK	*trxBlk = (SMB2_TRANSFER_BLOCK*)obj;
+	SMB_I2CMESSAGE		*msg = (SMB_I2CMESSAGE*)obj;
+	SMB2_ALERT			*alert = (SMB2_ALERT*)obj;
+	u_int32				n, m, num, len, isRd, off = 0;
+
+	switch( code ){
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+	case SMB2_BLK_READ_BLOCK_DATA:
+		if( (10 > bufLen) || (buf[9] > SMB_BLOCK_MAX_BYTES) ||
+			(10 + (u_int32)buf[9] > bufLen) )
+			return (SMB_ERR_PARAM);
+		trxBlk->flags = GetLe( buf + 0, 4 );
+		trxBlk->addr = (u_int16)GetLe( buf + 4, 2 );
+		trxBlk->cmdAddr = buf[6];
+		trxBlk->u.length = buf[7];
+		trxBlk->readLen = buf[8];
+		memcpy( trxBlk->data, buf + 10, buf[9] );
+		*sizeP = sizeof(SMB2_TRANSFER_BLOCK);
+		return 0;
+
+	case SMB2_BLK_I2C_XFER:
+		if( 2 > bufLen )
+			return (SMB_ERR_PARAM);
+		num = GetLe( buf, 2 );
+		if( num > size / sizeof(SMB_I2CMESSAGE) )
+			return (SMB_ERR_PARAM);
+		for( bufLen -= 2, buf += 2, m=0; m<num; m++, msg++ ){
+			if( 8 > bufLen )
+				return (SMB_ERR_PARAM);
+			len = GetLe( buf + 4, 2 );
+			n = GetLe( buf + 6, 2 );
+			isRd = (GetLe( buf + 2, 2 ) & I2C_M_RD) != 0;
+			if( 8 + n > bufLen )
+				return (SMB_ERR_PARAM);
+
+			/* data of the request: write data, of the result: read data */
+			if( n != ((isRd ? !i2cBuf : !!i2cBuf) ? len : 0) )
+				return (SMB_ERR_PARAM);
+
+			if( i2cBuf ){
+				if( len > REC_I2C_MAX - off )
+					return (SMB_ERR_PARAM);
+				msg->buf = i2cBuf + off;
+				off += len;
+			}
+			else if( len != msg->len )
+				return (SMB_ERR_PARAM);
+
+			msg->addr = (u_int16)GetLe( buf + 0, 2 );
+			msg->flags = (u_int16)GetLe( buf + 2, 2 );
+			msg->len = (u_int16)len;
+			if( n )
+				memcpy( msg->buf, buf + 8, n );
+			buf += 8 + n;
+			bufLen -= 8 + n;
+		}
+		*sizeP = num * sizeof(SMB_I2CMESSAGE);
+		return 0;
+
+	case SMB2_BLK_ALERT_CB_INSTALL:
+	case SMB2_BLK_ALERT_CB_REMOVE:
+		if( 6 > bufLen )
+			return (SMB_ERR_PARAM);
+		alert->addr = (u_int16)GetLe( buf + 0, 2 );
+		alert->sigCode = GetLe( buf + 2, 4 );
+		*sizeP = sizeof(SMB2_ALERT);
+		return 0;
+
+	default:
+		if( 11 > bufLen )
+			return (SMB_ERR_PARAM);
+		trx->flags = GetLe( buf + 0, 4 );
+		trx->addr = (u_int16)GetLe( buf + 4, 2 );
+		trx->readWrite = buf[6];
+		trx->cmdAddr = buf[7];
+		trx->u.wordData = (u_int16)GetLe( buf + 9, 2 );
+		if( code != SMB2_BLK_PROCESS_CALL &&
+			code != SMB2_BLK_READ_WORD_DATA &&
+			code != SMB2_BLK_WRITE_WORD_DATA &&
+			code != SMB2_BLK_ALERT_RESPONSE )
+			trx->u.byteData = buf[8];
+		*sizeP = sizeof(SMB2_TRANSFER);
+		return 0;
+	}
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Append transaction to record file (bus must be owned).
+ * The request is already encoded at rec->buf + REC_HDR_LEN.
+ *
+ *  record header: tUs(4) durUs(4) code(4) rv(4) flags(4) isGet(1)
+ *                 inLen(2) outLen(2)
+ *  followed by the encoded request (inLen) and result (outLen)
+ */
+static void RecWrite(
+	RECORDER	*rec,
+	int32		code,
+	u_int32		isGet,
+	u_int32		flags,
+	int32		rv,
+	u_int32		tBus,
+	u_int32		tEnd,
+	u_int32		inLen,
+	void		*obj,
+	u_int32		size )
+{
+	u_int32 outLen = 0;
+
+	if( isGet && !rv &&
+		RecEncode( code, obj, size, rec->buf + REC_HDR_LEN + inLen,
+				   2*REC_OBJ_MAX - inLen, 1, &outLen ) )
+		outLen = 0;
+
+	PutLe( rec->buf + 0, tBus - rec->tStart, 4 );
+	PutLe( rec->buf + 4, tEnd - tBus, 4 );
+	PutLe( rec->buf + 8, (u_int32)code, 4 );
+	PutLe( rec->buf + 12, (u_int32)rv, 4 );
+	PutLe( rec->buf + 16, flags, 4 );
+	rec->buf[20] = (u_int8)isGet;
+	PutLe( rec->buf + 21, inLen, 2 );
+	PutLe( rec->buf + 23, outLen, 2 );
+
+	/* write errors are reported by SMB2API_RecordStop */
+	fwrite( rec->buf, REC_HDR_LEN + inLen + outLen, 1, rec->fp );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Read next record, returns 0=ok, 1=end of file or error code
+ */
+static int32 RecRead(
+	FILE	*fp,
+	u_int8	*hdr,
+	u_int8	*objBuf,
+	u_int32	*inLenP,
+	u_int32	*outLenP )
+{
+	size_t n;
+
+	if( (n = fread( hdr, 1, REC_HDR_LEN, fp )) != REC_HDR_LEN )
+		return n ? (SMB2API_ERR_RECORD) : 1;
+
+	*inLenP = GetLe( hdr + 21, 2 );
+	*outLenP = GetLe( hdr + 23, 2 );
+
+	if( (*inLenP + *outLenP) &&
+		(fread( objBuf, *inLenP + *outLenP, 1, fp ) != 1) )
+		return (SMB2API_ERR_RECORD);
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Open record file and check file header
+ */
+static int32 RecOpen( const char *fileName, FILE **fpP )
+{
+	u_int8 fileHdr[REC_MAGIC_LEN + 8];
+
+	if( !(*fpP = fopen( fileName, "rb" )) )
+		return (SMB_ERR_PARAM);
+
+	if( (fread( fileHdr, sizeof(fileHdr), 1, *fpP ) != 1) ||
+		memcmp( fileHdr, REC_MAGIC, REC_MAGIC_LEN ) ||
+		(GetLe( fileHdr + REC_MAGIC_LEN, 4 ) != REC_VERSION) ){
+		fclose( *fpP );
+		*fpP = NULL;
+		return (SMB2API_ERR_RECORD);
+	}
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Store/load n byte little endian value
+ */
+static void PutLe( u_int8 *p, u_int32 val, u_int32 n )
+{
+	while( n-- ){
+		*p++ = (u_int8)val;
+		val >>= 8;
+	}
+}
+
+static u_int32 GetLe( const u_int8 *p, u_int32 n )
+{
+	u_int32 val = 0;
+
+	while( n-- )
+		val = (val << 8) | p[n];
+
+	return val;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Playback backend: answer transaction with next recorded result
+ */
+static int32 __MAPILIB PlaybackStat(
+	void		*beArg,
+	int32		code,
+	u_int32		isGet,
+	void		*obj,
+	u_int32		size )
+{
+	PLAYBACK	*pb = (PLAYBACK*)beArg;
+	u_int8		hdr[REC_HDR_LEN];
+	u_int32		inLen, outLen;
+	int32		rv;
+
+	/* skip records of transactions without bus access */
+	do {
+		if( (rv = RecRead( pb->fp, hdr, pb->buf, &inLen, &outLen )) )
+			return (SMB2API_ERR_RECORD);
+	} while( ((int32)GetLe( hdr + 8, 4 ) != code) &&
+			 ((GetLe( hdr + 8, 4 ) == SMB2_BLK_ALERT_CB_INSTALL) ||
+			  (GetLe( hdr + 8, 4 ) == SMB2_BLK_ALERT_CB_REMOVE)) );
+
+	if( ((int32)GetLe( hdr + 8, 4 ) != code) || (hdr[20] != isGet) )
+		return (SMB2API_ERR_RECORD);
+
+	if( outLen &&
+		RecDecode( code, pb->buf + inLen, outLen, obj, size, NULL, &size ) )
+		return (SMB2API_ERR_RECORD);
+
+	return (int32)GetLe( hdr + 12, 4 );
+}
+
+static int32 __MAPILIB PlaybackExit( void *beArg )
+{
+	PLAYBACK *pb = (PLAYBACK*)beArg;
+
+	fclose( pb->fp );
+	MemFree( pb );
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Broker backend functions of a client (see SMB2API_InitBroker)
+ *
+ *  request:  len(4) code(4) isGet(1) prio(1) encoded request
+ *  response: len(4) rv(4) encoded result
+ *  (len: bytes following the len field)
+ */
+static int32 __MAPILIB BrokerStat(
+	void		*beArg,
+	int32		code,
+	u_int32		isGet,
+	void		*obj,
+	u_int32		size )
+{
+	BROKER_CLI	*c = (BROKER_CLI*)beArg;
+	u_int32		len;
+	int32		rv;
+
+	/* alert signals cannot be sent to other processes */
+	if( (code == SMB2_BLK_ALERT_CB_INSTALL) ||
+		(code == SMB2_BLK_ALERT_CB_REMOVE) )
+		return (SMB_ERR_NOT_SUPPORTED);
+
+	MtxLock( &c->mtx );
+
+	/* e.g. more I2C data than a request takes */
+	if( (rv = RecEncode( code, obj, size, c->buf + BROKER_REQ_HDR,
+						 BROKER_MSG_MAX - BROKER_REQ_HDR, 0, &len )) ){
+		MtxUnlock( &c->mtx );
+		return rv;
+	}
+
+	len += BROKER_REQ_HDR;
+	PutLe( c->buf + 0, len - 4, 4 );
+	PutLe( c->buf + 4, (u_int32)code, 4 );
+	c->buf[8] = (u_int8)isGet;
+	c->buf[9] = (u_int8)G_tlsTrxPrio;
+
+	if( BrokerXfer( c->fd, c->buf, len, 1 ) ||
+		BrokerXfer( c->fd, c->buf, 4, 0 ) ||
+		((len = GetLe( c->buf, 4 )) < BROKER_RSP_HDR - 4) ||
+		(len > BROKER_MSG_MAX - 4) ||
+		BrokerXfer( c->fd, c->buf + 4, len, 0 ) ){
+		rv = SMB2API_ERR_BROKER;
+	}
+	else {
+		rv = (int32)GetLe( c->buf + 4, 4 );
+		if( (len > BROKER_RSP_HDR - 4) &&
+			RecDecode( code, c->buf + BROKER_RSP_HDR,
+					   len + 4 - BROKER_RSP_HDR, obj, size, NULL, &size ) )
+			rv = SMB2API_ERR_BROKER;
+	}
+
+	MtxUnlock( &c->mtx );
+
+	return rv;
+}
+
+static int32 __MAPILIB BrokerExit( void *beArg )
+{
+	BROKER_CLI *c = (BROKER_CLI*)beArg;
+
+#if !defined(WINNT)
+	close( c->fd );
+#endif
+	MtxExit( &c->mtx );
+	MemFree( c );
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Receive request of a broker client, returns 1 if complete, 0 if
+ * incomplete, -1 on closed connection or invalid request
+ */
+static int32 BrokerRecv( BROKER_CONN *c )
+{
+#if defined(WINNT)
+	return -1;
+#else
+	u_int32	need;
+	ssize_t	got;
+
+	if( c->rxLen < 4 )
+		need = 4 - c->rxLen;
+	else {
+		need = GetLe( c->buf, 4 );
+		if( (need < BROKER_REQ_HDR - 4) || (need > BROKER_MSG_MAX - 4) )
+			return -1;
+		need -= c->rxLen - 4;
+	}
+
+	if( (got = recv( c->fd, c->buf + c->rxLen, need, 0 )) <= 0 )
+		return ((got < 0) && (errno == EINTR)) ? 0 : -1;
+
+	c->rxLen += (u_int32)got;
+
+	/* header complete: read the rest with the next call */
+	return ((c->rxLen > 4) && (c->rxLen == 4 + GetLe( c->buf, 4 ))) ? 1 : 0;
+#endif
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Execute complete request of a broker client and send the response
+ */
+static int32 BrokerExec( SMB_HANDLE *h, BROKER_CONN *c )
+{
+	union
+	{
+		SMB2_TRANSFER		trx;
+		SMB2_TRANSFER_BLOCK	trxBlk;
+		SMB_I2CMESSAGE		msg[I2C_XFER_MSG_MAX];
+		SMB2_ALERT			alert;
+	}obj;
+	M_SG_BLOCK	blk;
+	int32		code = (int32)GetLe( c->buf + 4, 4 );
+	u_int32		isGet = c->buf[8], prio = c->buf[9], len, objSize = 0;
+	int32		rv;
+
+	if( prio >= SMB2API_PRIO_NUM )
+		prio = SMB2API_PRIO_NORMAL;
+
+	zeroOut( (int8*)&obj, sizeof(obj) );
+	blk.data = (void*)&obj;
+
+	/* malformed request (e.g. I2C data beyond the received bytes) */
+	rv = RecDecode( code, c->buf + BROKER_REQ_HDR,
+					GetLe( c->buf, 4 ) + 4 - BROKER_REQ_HDR, (void*)&obj,
+					sizeof(obj), c->i2cBuf, &objSize );
+	blk.size = (int32)objSize;
+
+	switch( rv ? 0 : code ){
+	case SMB2_BLK_QUICK_COMM:
+	case SMB2_BLK_WRITE_BYTE:
+	case SMB2_BLK_READ_BYTE:
+	case SMB2_BLK_WRITE_BYTE_DATA:
+	case SMB2_BLK_READ_BYTE_DATA:
+	case SMB2_BLK_WRITE_WORD_DATA:
+	case SMB2_BLK_READ_WORD_DATA:
+	case SMB2_BLK_PROCESS_CALL:
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+	case SMB2_BLK_READ_BLOCK_DATA:
+	case SMB2_BLK_I2C_XFER:
+	case SMB2_BLK_ALERT_RESPONSE:
+		rv = TrxExec( h, code, isGet, &blk,
+					  (prio + 1) << SMB2API_FLAG_PRIO_SHIFT );
+		break;
+	case 0:
+		/* malformed request: no result */
+		if( !rv )
+			rv = SMB_ERR_NOT_SUPPORTED;
+		blk.size = 0;
+		break;
+	default:
+		/* alert signals of other processes, unknown codes */
+		rv = SMB_ERR_NOT_SUPPORTED;
+	}
+
+	if( !blk.size ||
+		RecEncode( code, (void*)&obj, blk.size, c->buf + BROKER_RSP_HDR,
+				   BROKER_MSG_MAX - BROKER_RSP_HDR, 1, &len ) )
+		len = 0;
+	len += BROKER_RSP_HDR;
+	PutLe( c->buf + 0, len - 4, 4 );
+	PutLe( c->buf + 4, (u_int32)rv, 4 );
+
+	return BrokerXfer( c->fd, c->buf, len, 1 );
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Send or receive len bytes over a broker connection
+ */
+static int32 BrokerXfer( int fd, u_int8 *buf, u_int32 len, u_int32 isSend )
+{
+#if defined(WINNT)
+	return (SMB2API_ERR_BROKER);
+#else
+	ssize_t n;
+
+	while( len ){
+		/* no SIGPIPE if the peer closed the connection */
+		if( isSend )
+			n = send( fd, buf, len, MSG_NOSIGNAL );
+		else
+			n = read( fd, buf, len );
+
+		if( n <= 0 ){
+			if( (n < 0) && (errno == EINTR) )
+				continue;
+			return (SMB2API_ERR_BROKER);
+		}
+		buf += n;
+		len -= (u_int32)n;
+	}
+
+	return 0;
+#endif
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return cached error if device is known to be absent, else 0
+ */
+static int32 PresCached( SMB_HANDLE *h, u_int16 addr, u_int32 now )
+{
+	PRES	*p;
+	int32	err;
+
+	if( addr >= PRES_ADDR_NUM )
+		return 0;
+
+	p = &h->pres[addr];
+	if( !(err = p->err) )
+		return 0;
+
+	/* entry expired? */
+	if( h->presTtlUs && (now - p->t >= h->presTtlUs) ){
+		p->err = 0;
+		ATOMIC_ADD( h->presStats.expired, 1 );
+		return 0;
+	}
+
+	ATOMIC_ADD( h->presStats.avoided, 1 );
+	return err;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Update presence of device with result of an access
+ */
+static void PresUpdate( SMB_HANDLE *h, u_int16 addr, int32 rv, u_int32 now )
+{
+	PRES *p;
+
+	if( addr >= PRES_ADDR_NUM )
+		return;
+
+	p = &h->pres[addr];
+	if( (rv == SMB_ERR_ADDR) || (rv == SMB_ERR_NO_DEVICE) ){
+		p->t = now;
+		if( !p->err )
+			ATOMIC_ADD( h->presStats.absent, 1 );
+		p->err = rv;
+	}
+	else if( !rv )
+		p->err = 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return device address of a transaction for the presence cache,
+ * PRES_ADDR_NUM if not cached
+ */
+static u_int16 PresAddr( int32 code, void *obj )
+{
+	u_int16 addr;
+
+	switch( code ){
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+	case SMB2_BLK_READ_BLOCK_DATA:
+		addr = ((SMB2_TRANSFER_BLOCK*)obj)->addr;
+		break;
+	case SMB2_BLK_I2C_XFER:
+	case SMB2_BLK_ALERT_RESPONSE:
+	case SMB2_BLK_ALERT_CB_INSTALL:
+	case SMB2_BLK_ALERT_CB_REMOVE:
+		return PRES_ADDR_NUM;
+	default:
+		addr = ((SMB2_TRANSFER*)obj)->addr;
+	}
+
+	/* no device behind the alert response address */
+	return (addr == ARA_ADDR) ? PRES_ADDR_NUM : addr;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return simulation of SMB handle or NULL if no simulated SMBus
+ */
+static SIM* SimGet( void *smbHdl )
+{
+	SMB_HANDLE *h = (SMB_HANDLE*)smbHdl;
+
+	if( !h || !h->be || (h->be->Stat != SimStat) )
+		return NULL;
+
+	return (SIM*)h->beArg;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Simulation backend: execute transaction and emulate bus time
+ */
+static int32 __MAPILIB SimStat(
+	void		*beArg,
+	int32		code,
+	u_int32		isGet,
+	void		*obj,
+	u_int32		size )
+{
+	SIM		*sim = (SIM*)beArg;
+	u_int32	bits;
+	int32	rv;
+
+	(void)isGet;	/* direction given by code */
+
+	MtxLock( &sim->mtx );
+	rv = SimAccess( sim, code, obj, size );
+	sim->stats.trx++;
+	if( rv )
+		sim->stats.naks++;
+	MtxUnlock( &sim->mtx );
+
+	/* occupy the bus (the caller owns it) */
+	if( sim->busClk && !rv && TrxBusBytes( code, obj, size, &bits ) )
+		SleepUsec( (u_int32)(((u_int64)bits * 1000000) / sim->busClk) );
+
+	return rv;
+}
+
+static int32 __MAPILIB SimExit( void *beArg )
+{
+	SIM *sim = (SIM*)beArg;
+
+	MtxExit( &sim->mtx );
+	MemFree( sim );
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Execute transaction on the simulated devices (simulation locked)
+ */
+static int32 SimAccess( SIM *sim, int32 code, void *obj, u_int32 size )
+{
+	SMB2_TRANSFER		*trx = (SMB2_TRANSFER*)obj;
+	SMB2_TRANSFER_BLOCK	*trxBlk = (SMB2_TRANSFER_BLOCK*)obj;
+	SMB_I2CMESSAGE		*msg = (SMB_I2CMESSAGE*)obj;
+	SMB2_ALERT			*alert = (SMB2_ALERT*)obj;
+	SIM_DEV				*dev;
+	u_int16				addr;
+	u_int32				n, len;
+	u_int8				reg;
+	int32				rv;
+
+	/* alert response: device with lowest address wins the arbitration */
+	if( (code == SMB2_BLK_ALERT_RESPONSE) ||
+		((code == SMB2_BLK_READ_BYTE) && (trx->addr == ARA_ADDR) &&
+		 !sim->dev[ARA_ADDR].present) ){
+		for( n=0; n<SIM_DEV_NUM; n++ ){
+			if( sim->dev[n].present && sim->dev[n].alert )
+				break;
+		}
+		if( code == SMB2_BLK_ALERT_RESPONSE ){
+			trx->u.alertCnt = 0;
+			if( n < SIM_DEV_NUM ){
+				sim->dev[n].alert = 0;
+				if( !trx->addr || (trx->addr == n) )
+					trx->u.alertCnt = 1;
+			}
+			return 0;
+		}
+		if( n == SIM_DEV_NUM )
+			return (SMB_ERR_ADDR);
+		sim->dev[n].alert = 0;
+		trx->u.byteData = (u_int8)n;
+		return 0;
+	}
+
+	/* I2C messages: stop at the first failing message */
+	if( code == SMB2_BLK_I2C_XFER ){
+		for( n=0; n<size/sizeof(SMB_I2CMESSAGE); n++ ){
+			if( (rv = SimI2cMsg( sim, &msg[n] )) )
+				return rv;
+		}
+		return 0;
+	}
+
+	switch( code ){
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+	case SMB2_BLK_READ_BLOCK_DATA:	addr = trxBlk->addr;	break;
+	case SMB2_BLK_ALERT_CB_INSTALL:
+	case SMB2_BLK_ALERT_CB_REMOVE:	addr = alert->addr;		break;
+	default:						addr = trx->addr;
+	}
+
+	if( addr >= SIM_DEV_NUM )
+		return (SMB_ERR_ADDR);
+	dev = &sim->dev[addr];
+
+	/* alert callbacks need no device response */
+	if( code == SMB2_BLK_ALERT_CB_INSTALL ){
+		dev->sigCode = alert->sigCode;
+		return 0;
+	}
+	if( code == SMB2_BLK_ALERT_CB_REMOVE ){
+		if( dev->sigCode != alert->sigCode )
+			return (SMB_ERR_PARAM);
+		dev->sigCode = 0;
+		return 0;
+	}
+
+	if( !dev->present )
+		return (SMB_ERR_ADDR);
+
+	switch( code ){
+	case SMB2_BLK_QUICK_COMM:
+		break;
+	case SMB2_BLK_WRITE_BYTE:
+		dev->ptr = trx->u.byteData;
+		break;
+	case SMB2_BLK_READ_BYTE:
+		trx->u.byteData = dev->reg[dev->ptr++];
+		break;
+	case SMB2_BLK_WRITE_BYTE_DATA:
+		dev->reg[trx->cmdAddr] = trx->u.byteData;
+		break;
+	case SMB2_BLK_READ_BYTE_DATA:
+		trx->u.byteData = dev->reg[trx->cmdAddr];
+		break;
+	case SMB2_BLK_WRITE_WORD_DATA:
+	case SMB2_BLK_PROCESS_CALL:
+		reg = trx->cmdAddr;
+		dev->reg[reg++] = (u_int8)trx->u.wordData;
+		dev->reg[reg] = (u_int8)(trx->u.wordData >> 8);
+		break;
+	case SMB2_BLK_READ_WORD_DATA:
+		reg = trx->cmdAddr;
+		trx->u.wordData = dev->reg[reg++];
+		trx->u.wordData |= (u_int16)(dev->reg[reg] << 8);
+		break;
+	case SMB2_BLK_WRITE_BLOCK_DATA:
+		reg = trxBlk->cmdAddr;
+		dev->reg[reg++] = trxBlk->u.length;
+		for( n=0; n<trxBlk->u.length; n++ )
+			dev->reg[reg++] = trxBlk->data[n];
+		break;
+	case SMB2_BLK_READ_BLOCK_DATA:
+		reg = trxBlk->cmdAddr;
+		if( trxBlk->u.writeLen ){
+			/* block process call: return written data */
+			dev->reg[reg++] = trxBlk->u.writeLen;
+			for( n=0; n<trxBlk->u.writeLen; n++ ){
+				dev->reg[reg++] = trxBlk->data[n];
+				trxBlk->data[trxBlk->u.writeLen + n] = trxBlk->data[n];
+			}
+			trxBlk->readLen = trxBlk->u.writeLen;
+		}
+		else {
+			len = dev->reg[reg++];
+			if( len > SMB_BLOCK_MAX_BYTES )
+				len = SMB_BLOCK_MAX_BYTES;
+			for( n=0; n<len; n++ )
+				trxBlk->data[n] = dev->reg[reg++];
+			trxBlk->u.length = (u_int8)len;
+		}
+		break;
+	default:
+		return (SMB_ERR_NOT_SUPPORTED);
+	}
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Execute I2C message on a simulated device (simulation locked).
+ * A write sets the register pointer with the first byte.
+ */
+static int32 SimI2cMsg( SIM *sim, SMB_I2CMESSAGE *msg )
+{
+	SIM_DEV	*dev;
+	u_int32	n = 0;
+
+	if( (msg->addr >= SIM_DEV_NUM) || !sim->dev[msg->addr].present )
+		return (SMB_ERR_ADDR);
+	dev = &sim->dev[msg->addr];
+
+	if( !(msg->flags & I2C_M_RD) && msg->len )
+		dev->ptr = msg->buf[n++];
+	for( ; n<msg->len; n++ ){
+		if( msg->flags & I2C_M_RD )
+			msg->buf[n] = dev->reg[dev->ptr++];
+		else
+			dev->reg[dev->ptr++] = msg->buf[n];
+	}
+
+	return 0;
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Allocate/free memory (counted for leak checks)
+ */
+static void* MemAlloc( u_int32 size )
+{
+	void *p;
+
+	if( (p = malloc( size )) )
+		ATOMIC_ADD( G_memBlocks, 1 );
+
+	return p;
+}
+
+static void MemFree( void *p )
+{
+	if( p ){
+		ATOMIC_ADD( G_memBlocks, -1 );
+		free( p );
+	}
+}
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * OS specific synchronisation and time functions
+ */
+#if defined(SMB2API_NO_THREADS)
+
+static void MtxInit( MTX *m ){}
+static void MtxExit( MTX *m ){}
+static void MtxLock( MTX *m ){}
+static void MtxUnlock( MTX *m ){}
+static void CondInit( COND *c ){}
+static void CondExit( COND *c ){}
+static void CondWait( COND *c, MTX *m ){}
+static void CondTimedWait( COND *c, MTX *m, u_int32 us ){}
+static void CondBroadcast( COND *c ){}
+static void SemInit( SEM *s ){}
+static void SemExit( SEM *s ){}
+static void SemPost( SEM *s ){}
+static int32 SemTimedWait( SEM *s, u_int32 us ){ return 1; }
+static int32 ThreadCreate( THREAD *t, THREAD_FUNC func, void *arg )
+{
+	return (SMB_ERR_NOT_SUPPORTED);
+}
+static void ThreadJoin( THREAD *t ){}
+
+static u_int32 AtomicXchg( u_int32 *p, u_int32 val )
+{
+	u_int32 old = *p;
+
+	*p = val;
+	return old;
+}
+
+static u_int32 TimeUsec( void )
+{
+	return UOS_MsecTimerGet() * 1000;
+}
+
+static void SleepUsec( u_int32 us ){ UOS_Delay( (us + 999) / 1000 ); }
+
+#elif defined(WINNT)
+
+static void MtxInit( MTX *m ){ InitializeCriticalSection( m ); }
+static void MtxExit( MTX *m ){ DeleteCriticalSection( m ); }
+static void MtxLock( MTX *m ){ EnterCriticalSection( m ); }
+static void MtxUnlock( MTX *m ){ LeaveCriticalSection( m ); }
+static void CondInit( COND *c ){ InitializeConditionVariable( c ); }
+static void CondExit( COND *c ){}
+static void CondWait( COND *c, MTX *m ){ SleepConditionVariableCS( c, m, INFINITE ); }
+static void CondTimedWait( COND *c, MTX *m, u_int32 us )
+{
+	SleepConditionVariableCS( c, m, (us + 999) / 1000 );
+}
+static void CondBroadcast( COND *c ){ WakeAllConditionVariable( c ); }
+static void SemInit( SEM *s ){ *s = CreateSemaphore( NULL, 0, 0x7fffffff, NULL ); }
+static void SemExit( SEM *s ){ CloseHandle( *s ); }
+static void SemPost( SEM *s ){ ReleaseSemaphore( *s, 1, NULL ); }
+static int32 SemTimedWait( SEM *s, u_int32 us )
+{
+	return WaitForSingleObject( *s, (us + 999) / 1000 ) == WAIT_OBJECT_0 ? 0 : 1;
+}
+
+static int32 ThreadCreate( THREAD *t, THREAD_FUNC func, void *arg )
+{
+	if( !(*t = CreateThread( NULL, 0, func, arg, 0, NULL )) )
+		return (SMB_ERR_NO_MEM);
+	return 0;
+}
+
+static void ThreadJoin( THREAD *t )
+{
+	WaitForSingleObject( *t, INFINITE );
+	CloseHandle( *t );
+}
+
+static u_int32 AtomicXchg( u_int32 *p, u_int32 val )
+{
+	return (u_int32)InterlockedExchange( (LONG volatile*)p, (LONG)val );
+}
+
+static u_int32 TimeUsec( void )
+{
+	LARGE_INTEGER cnt, freq;
+
+	QueryPerformanceCounter( &cnt );
+	QueryPerformanceFrequency( &freq );
+	return (u_int32)((cnt.QuadPart * 1000000) / freq.QuadPart);
+}
+
+static void SleepUsec( u_int32 us ){ Sleep( (us + 999) / 1000 ); }
+
+#else
+
+static void MtxInit( MTX *m ){ pthread_mutex_init( m, NULL ); }
+static void MtxExit( MTX *m ){ pthread_mutex_destroy( m ); }
+static void MtxLock( MTX *m ){ pthread_mutex_lock( m ); }
+static void MtxUnlock( MTX *m ){ pthread_mutex_unlock( m ); }
+static void CondExit( COND *c ){ pthread_cond_destroy( c ); }
+static void CondWait( COND *c, MTX *m ){ pthread_cond_wait( c, m ); }
+
+static void CondInit( COND *c )
+{
+	pthread_condattr_t attr;
+
+	/* timed waits are relative to the monotonic clock (see TimeUsec) */
+	pthread_condattr_init( &attr );
+	pthread_condattr_setclock( &attr, CLOCK_MONOTONIC );
+	pthread_cond_init( c, &attr );
+	pthread_condattr_destroy( &attr );
+}
+
+static void CondTimedWait( COND *c, MTX *m, u_int32 us )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	ts.tv_sec += us / 1000000;
+	ts.tv_nsec += (us % 1000000) * 1000;
+	if( ts.tv_nsec >= 1000000000 ){
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+	pthread_cond_timedwait( c, m, &ts );
+}
+static void CondBroadcast( COND *c ){ pthread_cond_broadcast( c ); }
+static void SemInit( SEM *s ){ sem_init( s, 0, 0 ); }
+static void SemExit( SEM *s ){ sem_destroy( s ); }
+static void SemPost( SEM *s ){ sem_post( s ); }
+
+static int32 SemTimedWait( SEM *s, u_int32 us )
+{
+	struct timespec ts;
+	int rv;
+
+	if( !us )
+		return sem_trywait( s ) ? 1 : 0;
+
+	/* sem_timedwait uses the realtime clock */
+	clock_gettime( CLOCK_REALTIME, &ts );
+	ts.tv_sec += us / 1000000;
+	ts.tv_nsec += (us % 1000000) * 1000;
+	if( ts.tv_nsec >= 1000000000 ){
+		ts.tv_sec++;
+		ts.tv_nsec -= 1000000000;
+	}
+
+	while( (rv = sem_timedwait( s, &ts )) && (errno == EINTR) )
+		;
+	return rv ? 1 : 0;
+}
+
+static int32 ThreadCreate( THREAD *t, THREAD_FUNC func, void *arg )
+{
+	if( pthread_create( t, NULL, func, arg ) )
+		return (SMB_ERR_NO_MEM);
+	return 0;
+}
+
+static void ThreadJoin( THREAD *t ){ pthread_join( *t, NULL ); }
+
+static u_int32 AtomicXchg( u_int32 *p, u_int32 val )
+{
+	return __sync_lock_test_and_set( p, val );
+}
+
+static u_int32 TimeUsec( void )
+{
+	struct timespec ts;
+
+	clock_gettime( CLOCK_MONOTONIC, &ts );
+	return (u_int32)ts.tv_sec * 1000000 + (u_int32)(ts.tv_nsec / 1000);
+}
+
+static void SleepUsec( u_int32 us )
+{
+	struct timespec ts;
+
+	ts.tv_sec = us / 1000000;
+	ts.tv_nsec = (long)(us % 1000000) * 1000;
+	while( nanosleep( &ts, &ts ) && (errno == EINTR) )
+		;
+}
+
+#endif
+
 
 
 
@@ -0,0 +1,367 @@
+/***********************  I n c l u d e  -  F i l e  ***********************/
+/*!
+ *        \file  smb2_api.hpp
+ *
+ *       \brief  Header-only C++ layer over the SMB2_API
+ *
+ *               RAII ownership of SMB handles, transfers on std::span
+ *               buffers without heap allocation and register accessors
+ *               specialized at compile time. The functions return the
+ *               error codes of the SMB2_API, no exceptions are thrown.
+ *
+ *               Example:
+ *               \verbatim
+ *               smb2api::Handle smb;
+ *               u_int16 temp;
+ *
+ *               if( (err = smb.Init( "smb2_1" )) )
+ *                   return err;
+ *
+ *               // 16-bit register 0x05 of device 0x30
+ *               using TempReg = smb2api::Reg<0x30, 0x05, u_int16>;
+ *               err = TempReg::Read( smb, temp );
+ *
+ *               // register pointer write, then read with repeated start
+ *               err = smb.I2CWriteRead( 0xa0, hdr,
+ *                                       std::span<u_int8>( buf ) ); \endverbatim
+ *
+ *    \switches  -
+ *
+ *     Required: C++20
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#ifndef _SMB2_API_HPP
+#define _SMB2_API_HPP
+
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "smb2_api_ext.h"
+
+namespace smb2api {
+
+/** I2C message (see SMB2API_I2CXfer) */
+typedef SMB_I2CMESSAGE I2cMsg;
+
+/** I2C write message of \a data (buffer must stay valid until the
+ *  transfer is done) */
+inline I2cMsg I2cWrite( u_int16 addr, std::span<const u_int8> data )
+{
+	I2cMsg msg;
+
+	msg.addr = addr;
+	msg.flags = 0;
+	msg.len = (u_int16)data.size();
+	msg.buf = const_cast<u_int8*>( data.data() );
+	return msg;
+}
+
+/** I2C read message into \a data */
+inline I2cMsg I2cRead( u_int16 addr, std::span<u_int8> data )
+{
+	I2cMsg msg;
+
+	msg.addr = addr;
+	msg.flags = I2C_M_RD;
+	msg.len = (u_int16)data.size();
+	msg.buf = data.data();
+	return msg;
+}
+
+/** I2C message with several buffers (see SMB2API_I2CXferV) */
+typedef SMB2API_I2C_MSGV I2cMsgV;
+
+/** Buffer of an I2C message with several buffers */
+inline SMB2API_I2C_VEC I2cVec( std::span<const u_int8> data )
+{
+	SMB2API_I2C_VEC vec;
+
+	vec.buf = const_cast<u_int8*>( data.data() );
+	vec.len = (u_int16)data.size();
+	return vec;
+}
+
+/****************************************************************************/
+/** SMB handle (owner of an SMB2_API handle)
+ *
+ *  The handle is freed with SMB2API_Exit() on destruction. It can be
+ *  moved, not copied. One handle may be used by several threads, see
+ *  Clone() for a handle per thread.
+ *
+ *  Clones may outlive their parent: the SMB handle of a parent destroyed
+ *  (or exited) with open clones is freed with its last clone.
+ ****************************************************************************/
+class Handle
+{
+public:
+	Handle() noexcept : _hdl( nullptr ) {}
+
+	/** Take ownership of an SMB handle of the C API */
+	explicit Handle( void *smbHdl ) noexcept : _hdl( smbHdl ) {}
+
+	Handle( Handle &&other ) noexcept : _hdl( other.Release() ) {}
+
+	Handle& operator=( Handle &&other ) noexcept
+	{
+		if( this != &other ){
+			Exit();
+			_hdl = other.Release();
+		}
+		return *this;
+	}
+
+	Handle( const Handle& ) = delete;
+	Handle& operator=( const Handle& ) = delete;
+
+	~Handle() { Exit(); }
+
+	/** Open MDIS device (see SMB2API_Init) */
+	int32 Init( const char *device )
+	{
+		Exit();
+		return SMB2API_Init( const_cast<char*>( device ), &_hdl );
+	}
+
+	/** Open simulated SMBus (see SMB2API_InitSim) */
+	int32 InitSim( u_int32 busClk = 0 )
+	{
+		Exit();
+		return SMB2API_InitSim( busClk, &_hdl );
+	}
+
+	/** Create clone with own MDIS path (see SMB2API_Clone) */
+	int32 Clone( Handle &clone ) const
+	{
+		clone.Exit();
+		return SMB2API_Clone( _hdl, &clone._hdl );
+	}
+
+	/** Free the handle (see SMB2API_Exit), no-op if not open */
+	int32 Exit()
+	{
+		return _hdl ? SMB2API_Exit( &_hdl ) : 0;
+	}
+
+	/** Give up ownership, returns the SMB handle of the C API */
+	void* Release() noexcept
+	{
+		return std::exchange( _hdl, nullptr );
+	}
+
+	/** SMB handle for the C API */
+	void* Get() const noexcept { return _hdl; }
+
+	explicit operator bool() const noexcept { return _hdl != nullptr; }
+
+	/* single read/write (see the SMB2_API functions of the same name) */
+	int32 QuickComm( u_int32 flags, u_int16 addr, u_int8 readWrite ) const
+	{
+		return SMB2API_QuickComm( _hdl, flags, addr, readWrite );
+	}
+
+	int32 WriteByte( u_int32 flags, u_int16 addr, u_int8 data ) const
+	{
+		return SMB2API_WriteByte( _hdl, flags, addr, data );
+	}
+
+	int32 ReadByte( u_int32 flags, u_int16 addr, u_int8 &data ) const
+	{
+		return SMB2API_ReadByte( _hdl, flags, addr, &data );
+	}
+
+	int32 WriteByteData(
+		u_int32 flags, u_int16 addr, u_int8 cmdAddr, u_int8 data ) const
+	{
+		return SMB2API_WriteByteData( _hdl, flags, addr, cmdAddr, data );
+	}
+
+	int32 ReadByteData(
+		u_int32 flags, u_int16 addr, u_int8 cmdAddr, u_int8 &data ) const
+	{
+		return SMB2API_ReadByteData( _hdl, flags, addr, cmdAddr, &data );
+	}
+
+	int32 WriteWordData(
+		u_int32 flags, u_int16 addr, u_int8 cmdAddr, u_int16 data ) const
+	{
+		return SMB2API_WriteWordData( _hdl, flags, addr, cmdAddr, data );
+	}
+
+	int32 ReadWordData(
+		u_int32 flags, u_int16 addr, u_int8 cmdAddr, u_int16 &data ) const
+	{
+		return SMB2API_ReadWordData( _hdl, flags, addr, cmdAddr, &data );
+	}
+
+	int32 ProcessCall(
+		u_int32 flags, u_int16 addr, u_int8 cmdAddr, u_int16 &data ) const
+	{
+		return SMB2API_ProcessCall( _hdl, flags, addr, cmdAddr, &data );
+	}
+
+	/** Write data block (max. #SMB_BLOCK_MAX_BYTES) */
+	int32 WriteBlockData(
+		u_int32 flags, u_int16 addr, u_int8 cmdAddr,
+		std::span<const u_int8> data ) const
+	{
+		if( data.size() > SMB_BLOCK_MAX_BYTES )
+			return (SMB_ERR_PARAM);
+
+		return SMB2API_WriteBlockData( _hdl, flags, addr, cmdAddr,
+									   (u_int8)data.size(),
+									   const_cast<u_int8*>( data.data() ) );
+	}
+
+	/** Read data block into \a data, \a len gets the block length
+	 *
+	 *  A buffer of #SMB_BLOCK_MAX_BYTES is filled directly, a smaller
+	 *  buffer over the stack. Fails with #SMB_ERR_PARAM if the block
+	 *  does not fit.
+	 */
+	int32 ReadBlockData(
+		u_int32 flags, u_int16 addr, u_int8 cmdAddr,
+		std::span<u_int8> data, std::size_t &len ) const
+	{
+		u_int8	tmp[SMB_BLOCK_MAX_BYTES];
+		u_int8	*buf = (data.size() >= SMB_BLOCK_MAX_BYTES) ?
+					   data.data() : tmp;
+		u_int8	length;
+		int32	rv;
+
+		len = 0;
+		if( (rv = SMB2API_ReadBlockData( _hdl, flags, addr, cmdAddr,
+										 &length, buf )) )
+			return rv;
+
+		if( length > data.size() )
+			return (SMB_ERR_PARAM);
+		if( buf == tmp )
+			std::memcpy( data.data(), tmp, length );
+
+		len = length;
+		return 0;
+	}
+
+	/** Write data block, then read data block (see ReadBlockData) */
+	int32 BlockProcessCall(
+		u_int32 flags, u_int16 addr, u_int8 cmdAddr,
+		std::span<const u_int8> wrData, std::span<u_int8> rdData,
+		std::size_t &rdLen ) const
+	{
+		u_int8	tmp[SMB_BLOCK_MAX_BYTES];
+		u_int8	*buf = (rdData.size() >= SMB_BLOCK_MAX_BYTES) ?
+					   rdData.data() : tmp;
+		u_int8	length;
+		int32	rv;
+
+		rdLen = 0;
+		if( wrData.size() > SMB_BLOCK_MAX_BYTES )
+			return (SMB_ERR_PARAM);
+
+		if( (rv = SMB2API_BlockProcessCall(
+				 _hdl, flags, addr, cmdAddr, (u_int8)wrData.size(),
+				 const_cast<u_int8*>( wrData.data() ), &length, buf )) )
+			return rv;
+
+		if( length > rdData.size() )
+			return (SMB_ERR_PARAM);
+		if( buf == tmp )
+			std::memcpy( rdData.data(), tmp, length );
+
+		rdLen = length;
+		return 0;
+	}
+
+	/** I2C transfer of \a msg (see I2cWrite, I2cRead)
+	 *
+	 *  Each message is a transfer of its own (see SMB2API_I2CXfer),
+	 *  other transactions may come between them. Use I2CXferV() or
+	 *  I2CWriteRead() for messages in one bus ownership.
+	 */
+	int32 I2CXfer( std::span<I2cMsg> msg ) const
+	{
+		return SMB2API_I2CXfer( _hdl, msg.data(), (u_int32)msg.size() );
+	}
+
+	/** I2C transfer of messages with several buffers each, e.g. memory
+	 *  address and page data from different places (see I2cVec), in
+	 *  one bus ownership */
+	int32 I2CXferV( std::span<I2cMsgV> msg ) const
+	{
+		return SMB2API_I2CXferV( _hdl, msg.data(), (u_int32)msg.size() );
+	}
+
+	/** Write \a wrData, then read \a rdData with repeated start, e.g.
+	 *  register pointer and data of an EEPROM
+	 *
+	 *  Both messages are passed in one I2C transfer (see
+	 *  SMB2API_I2CXferV), so no other transaction can move the register
+	 *  pointer in between.
+	 */
+	int32 I2CWriteRead(
+		u_int16 addr, std::span<const u_int8> wrData,
+		std::span<u_int8> rdData ) const
+	{
+		SMB2API_I2C_VEC	vec[2] = { I2cVec( wrData ), I2cVec( rdData ) };
+		I2cMsgV			msg[2];
+
+		if( (wrData.size() > 0xffff) || (rdData.size() > 0xffff) )
+			return (SMB_ERR_PARAM);
+
+		msg[0].addr = addr;
+		msg[0].flags = 0;
+		msg[0].vecNum = 1;
+		msg[0].vec = &vec[0];
+		msg[1].addr = addr;
+		msg[1].flags = I2C_M_RD;
+		msg[1].vecNum = 1;
+		msg[1].vec = &vec[1];
+
+		return SMB2API_I2CXferV( _hdl, msg, 2 );
+	}
+
+private:
+	void	*_hdl;		/**< SMB handle of the C API */
+};
+
+/****************************************************************************/
+/** Register of a device, specialized at compile time
+ *
+ *  \a T is u_int8 (byte data access) or u_int16 (word data access).
+ *  Example: using Status = Reg<0x30, 0x01, u_int8>;
+ ****************************************************************************/
+template <u_int16 Addr, u_int8 CmdAddr, typename T>
+struct Reg
+{
+	static_assert( std::is_same_v<T, u_int8> || std::is_same_v<T, u_int16>,
+				   "register width must be u_int8 or u_int16" );
+
+	static constexpr u_int16	addr = Addr;		/**< device address */
+	static constexpr u_int8		cmdAddr = CmdAddr;	/**< register */
+
+	static int32 Read( const Handle &smb, T &val, u_int32 flags = 0 )
+	{
+		if constexpr( std::is_same_v<T, u_int8> )
+			return SMB2API_ReadByteData( smb.Get(), flags, Addr, CmdAddr, &val );
+		else
+			return SMB2API_ReadWordData( smb.Get(), flags, Addr, CmdAddr, &val );
+	}
+
+	static int32 Write( const Handle &smb, T val, u_int32 flags = 0 )
+	{
+		if constexpr( std::is_same_v<T, u_int8> )
+			return SMB2API_WriteByteData( smb.Get(), flags, Addr, CmdAddr, val );
+		else
+			return SMB2API_WriteWordData( smb.Get(), flags, Addr, CmdAddr, val );
+	}
+};
+
+} /* namespace smb2api */
+
+#endif /* _SMB2_API_HPP */
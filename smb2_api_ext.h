@@ -0,0 +1,512 @@
+/***********************  I n c l u d e  -  F i l e  ***********************/
+/*!
+ *        \file  smb2_api_ext.h
+ *
+ *       \brief  Extended SMB2_API functions (prepared transactions, ...)
+ *
+ *               Declarations for the SMB2_API functions that go beyond
+ *               the SMB_ENTRIES jump table of the SMB2 library.
+ *
+ *    \switches  -
+ *
+ *     Required: -
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#ifndef _SMB2_API_EXT_H
+#define _SMB2_API_EXT_H
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_err.h>
+#include <MEN/smb2.h>
+#include <MEN/smb2_api.h>
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/*--------------------------------------------------------------------------+
+|  DEFINES                                                                  |
++--------------------------------------------------------------------------*/
+/** \defgroup _SMB2API_FLAG SMB2_API library flags
+ *  Library flags can be or'ed to the flags parameter of the SMB2_API
+ *  functions. They are removed before the flags are passed to the driver.
+ *  @{ */
+#define SMB2API_FLAG_LIB_MASK		0xff000000	/**< all library flags */
+
+#define SMB2API_FLAG_PRIO_SHIFT		28
+#define SMB2API_FLAG_PRIO_MASK		0x30000000	/**< priority class */
+#define SMB2API_FLAG_PRIO_LOW		0x10000000	/**< #SMB2API_PRIO_LOW */
+#define SMB2API_FLAG_PRIO_NORMAL	0x20000000	/**< #SMB2API_PRIO_NORMAL */
+#define SMB2API_FLAG_PRIO_HIGH		0x30000000	/**< #SMB2API_PRIO_HIGH */
+
+#define SMB2API_FLAG_RESCAN			0x01000000	/**< access devices known
+												 to be absent */
+/** @} */
+
+/** \defgroup _SMB2API_ROUTE SMB2_API routing modes
+ *  (see SMB2API_RouteSet)
+ *  @{ */
+#define SMB2API_ROUTE_NATIVE	0	/**< driver operations only */
+#define SMB2API_ROUTE_FALLBACK	1	/**< emulate unsupported operations
+										 with I2C messages */
+#define SMB2API_ROUTE_FASTEST	2	/**< use faster of native and emulated
+										 operation (measured) */
+/** @} */
+
+/** \defgroup _SMB2API_CAP SMB2_API capability states
+ *  @{ */
+#define SMB2API_CAP_UNKNOWN		0	/**< not used yet */
+#define SMB2API_CAP_YES			1	/**< supported */
+#define SMB2API_CAP_NO			2	/**< not supported */
+/** @} */
+
+/** \defgroup _SMB2API_SNAP SMB2_API register snapshot flags
+ *  (see SMB2API_SnapRead)
+ *  @{ */
+#define SMB2API_SNAP_SEQ		0x01	/**< device increments its register
+										 pointer (sequential I2C access) */
+/** @} */
+
+/** Registers of a device (8-bit register address) */
+#define SMB2API_SNAP_REG_NUM	256
+
+/** \defgroup _SMB2API_MEM SMB2_API I2C memory flags
+ *  (see SMB2API_MemWrite)
+ *  @{ */
+#define SMB2API_MEM_ADDR16		0x01	/**< 16-bit memory address
+										 (else 8-bit) */
+#define SMB2API_MEM_VERIFY		0x02	/**< verify after write */
+/** @} */
+
+/** \defgroup _SMB2API_PRIO SMB2_API priority classes
+ *  @{ */
+#define SMB2API_PRIO_LOW		0	/**< bulk work (e.g. EEPROM dump) */
+#define SMB2API_PRIO_NORMAL		1	/**< default */
+#define SMB2API_PRIO_HIGH		2	/**< time critical (e.g. watchdog) */
+#define SMB2API_PRIO_NUM		3	/**< number of priority classes */
+/** @} */
+
+/** \defgroup _SMB2API_REPLAY SMB2_API replay flags
+ *  @{ */
+#define SMB2API_REPLAY_MAX_SPEED	0x00	/**< replay at maximum speed */
+#define SMB2API_REPLAY_ORIG_SPEED	0x01	/**< replay with recorded timing */
+/** @} */
+
+/** \defgroup _SMB2API_ALERT SMB2_API alert engine flags
+ *  @{ */
+#define SMB2API_ALERT_ARA_DRAIN		0x01	/**< read alert response address
+											 until no device responds */
+#define SMB2API_ALERT_POLL			0x02	/**< poll alert response address
+											 (no signals required) */
+/** @} */
+
+#define SMB2API_LAT_HIST_NUM	20	/**< buckets of latency histograms */
+
+/** Max. deadline [ms] (see SMB2API_DeadlineSet), the deadlines are
+ *  compared in wrapping 32-bit microseconds */
+#define SMB2API_DEADLINE_MAX	2000000
+
+/** All addresses (see SMB2API_PresInvalidate) */
+#define SMB2API_PRES_ALL	0xffff
+
+/** element size of SMB2API_GatherRead results for access size */
+#define SMB2API_GATHER_STRIDE( size ) \
+	((size) == SMB_ACC_WORD_DATA  ? 2 : \
+	 (size) == SMB_ACC_BLOCK_DATA ? 1 + SMB_BLOCK_MAX_BYTES : 1)
+
+/** \defgroup _SMB2API_ERR SMB2_API library error codes
+ *  Error codes generated by the library (not by the SMB2 driver).
+ *  @{ */
+#define SMB2API_ERR_DEADLINE	(ERR_DEV+0xf0)	/**< deadline passed before
+												 bus access (dropped) */
+#define SMB2API_ERR_OVERRUN		(ERR_DEV+0xf1)	/**< deadline passed during
+												 bus access */
+#define SMB2API_ERR_RECORD		(ERR_DEV+0xf2)	/**< record file corrupt or
+												 replay mismatch */
+#define SMB2API_ERR_SHM			(ERR_DEV+0xf3)	/**< shared memory region
+												 not available */
+#define SMB2API_ERR_NO_DATA		(ERR_DEV+0xf4)	/**< no value published
+												 yet */
+#define SMB2API_ERR_BROKER		(ERR_DEV+0xf5)	/**< broker connection
+												 failed */
+#define SMB2API_ERR_VERIFY		(ERR_DEV+0xf6)	/**< verify after write
+												 failed */
+/** @} */
+
+/*--------------------------------------------------------------------------+
+|  TYPEDEFS                                                                 |
++--------------------------------------------------------------------------*/
+/** SMBus access of a sequence (see SMB2API_SmbXferList) */
+typedef struct
+{
+	u_int32		flags;			/**< flags, see \ref _SMB2_FLAG */
+	u_int16		addr;			/**< device address */
+	u_int8		readWrite;		/**< #SMB_READ or #SMB_WRITE */
+	u_int8		cmdAddr;		/**< device command or index value */
+	u_int8		size;			/**< access size (SMB_ACC_XXX) */
+	u_int8		*dataP;			/**< data to write / read data */
+}SMB2API_XFER;
+
+/** Buffer of a scatter-gather I2C message */
+typedef struct
+{
+	u_int8		*buf;			/**< data to write / buffer for read data */
+	u_int16		len;			/**< length [bytes] */
+}SMB2API_I2C_VEC;
+
+/** Scatter-gather I2C message (see SMB2API_I2CXferV) */
+typedef struct
+{
+	u_int16				addr;		/**< device address */
+	u_int16				flags;		/**< I2C_M_XXX flags */
+	u_int32				vecNum;		/**< number of buffers */
+	SMB2API_I2C_VEC		*vec;		/**< buffers, data of the message in
+										 this order */
+}SMB2API_I2C_MSGV;
+
+/** Latency statistics of a priority class */
+typedef struct
+{
+	u_int32		count;		/**< number of transactions */
+	u_int32		avgUs;		/**< average latency (wait + transfer) [us] */
+	u_int32		maxUs;		/**< maximum latency [us] */
+	u_int32		avgWaitUs;	/**< average wait for the bus [us] */
+	u_int32		maxWaitUs;	/**< maximum wait for the bus [us] */
+	u_int32		hist[SMB2API_LAT_HIST_NUM];	/**< latency histogram,
+										 bucket n: latency < 2^n us */
+}SMB2API_PRIO_STATS;
+
+/** Bus utilization (moving averages) */
+typedef struct
+{
+	u_int32		busClk;			/**< configured bus clock [Hz] */
+	u_int32		utilPermille;	/**< estimated bus occupancy [permille] */
+	u_int32		bytesPerSec;	/**< throughput [bytes/s] */
+	u_int32		trxPerSec;		/**< transactions per second */
+	u_int32		throttled;		/**< delays of background transactions */
+}SMB2API_UTIL;
+
+/** Backend functions (instead of the SMB2 MDIS driver) */
+typedef struct
+{
+	/** execute transaction (SMB2_BLK_XXX code + transfer object) */
+	int32 (__MAPILIB *Stat)( void *beArg, int32 code, u_int32 isGet,
+							 void *obj, u_int32 size );
+	/** terminate backend, called by SMB2API_Exit (may be NULL) */
+	int32 (__MAPILIB *Exit)( void *beArg );
+}SMB2API_BACKEND;
+
+/** Rate limit statistics of an SMB handle (see SMB2API_RateSet) */
+typedef struct
+{
+	u_int32		deferred;		/**< transactions delayed by rate limits */
+	u_int32		waitUs;			/**< sum of the delays [us] */
+}SMB2API_RATE_STATS;
+
+/** Replay result */
+typedef struct
+{
+	u_int32		records;		/**< replayed transactions */
+	u_int32		rvMismatch;		/**< different return code */
+	u_int32		dataMismatch;	/**< different data */
+	u_int32		firstMismatch;	/**< index of first mismatch
+									 (= records if none) */
+	u_int32		recBusUs;		/**< recorded time in driver calls [us] */
+	u_int32		replayBusUs;	/**< replay time in driver calls [us] */
+	u_int32		recTotalUs;		/**< recorded total time [us] */
+	u_int32		replayTotalUs;	/**< replay total time [us] */
+}SMB2API_REPLAY_RESULT;
+
+/** Statistics of the simulated SMBus */
+typedef struct
+{
+	u_int32		trx;			/**< executed transactions */
+	u_int32		naks;			/**< failed transactions (absent device) */
+	u_int32		alerts;			/**< raised alerts */
+	u_int32		signals;		/**< alert signals sent to the library */
+}SMB2API_SIM_STATS;
+
+/** Presence cache statistics of an SMB handle */
+typedef struct
+{
+	u_int32		avoided;		/**< accesses failed from the cache */
+	u_int32		absent;			/**< devices found absent */
+	u_int32		expired;		/**< cache entries expired (TTL) */
+	u_int32		invalidated;	/**< cache entries invalidated */
+}SMB2API_PRES_STATS;
+
+/** Capabilities of an SMBus access (see SMB2API_CapGet) */
+typedef struct
+{
+	u_int8		native;			/**< native operation (SMB2API_CAP_XXX) */
+	u_int8		emulated;		/**< I2C emulation (SMB2API_CAP_XXX) */
+	u_int32		nativeUs;		/**< avg. time of native operation [us] */
+	u_int32		emulatedUs;		/**< avg. time of emulation [us] */
+	u_int32		emulatedCnt;	/**< accesses executed by emulation */
+}SMB2API_CAP;
+
+/** Alert statistics (process wide) */
+typedef struct
+{
+	u_int32		signals;		/**< received alert signals */
+	u_int32		callbacks;		/**< invoked alert callbacks */
+	u_int32		lost;			/**< signals without callback */
+	u_int32		araReads;		/**< devices read from the alert response
+									 address by alert engines */
+	u_int32		notifies;		/**< notifications of alert engines */
+	u_int32		coalesced;		/**< alerts merged into notifications */
+	u_int32		polls;			/**< alert response address polls of
+									 alert engines */
+}SMB2API_ALERT_STATS;
+
+/** Alert information for extended alert callbacks */
+typedef struct
+{
+	u_int16		addr;			/**< device address */
+	u_int32		count;			/**< coalesced alerts (1 without engine) */
+	u_int32		tFirstUs;		/**< time of first alert [us] */
+	u_int32		tLastUs;		/**< time of last alert [us] */
+	u_int8		araValid;		/**< araData valid */
+	u_int8		araData;		/**< data returned from the alert response
+									 address (device address + status) */
+	u_int8		statusValid;	/**< status/statusRv valid */
+	u_int16		status;			/**< pre-read status register */
+	int32		statusRv;		/**< result of status pre-read */
+}SMB2API_ALERT_INFO;
+
+/** Status register to read on alert (see SMB2API_AlertCbInstallEx) */
+typedef struct
+{
+	u_int8		cmdAddr;		/**< register (command) */
+	u_int8		size;			/**< access size (SMB_ACC_XXX, 0=none) */
+}SMB2API_ALERT_PREREAD;
+
+/** Alert engine configuration (see SMB2API_AlertEngineStart) */
+typedef struct
+{
+	u_int32		flags;			/**< SMB2API_ALERT_XXX flags */
+	u_int32		windowMs;		/**< coalescing window [ms] (0=none) */
+	u_int32		maxDrain;		/**< max. ARA reads per wakeup (0=default) */
+	/** notify function for coalesced alerts of an address (may be NULL) */
+	void		(*notifyFunc)( void *notifyArg, u_int16 addr, u_int32 count );
+	void		*notifyArg;		/**< argument for notify function */
+	u_int32		pollMinMs;		/**< poll interval while devices alert [ms]
+									 (#SMB2API_ALERT_POLL, 0=default) */
+	u_int32		pollMaxMs;		/**< poll interval while idle [ms]
+									 (#SMB2API_ALERT_POLL, 0=default) */
+}SMB2API_ALERT_CFG;
+
+/*--------------------------------------------------------------------------+
+|  PROTOTYPES                                                               |
++--------------------------------------------------------------------------*/
+/* backends */
+extern int32 __MAPILIB SMB2API_InitBackend(
+	const SMB2API_BACKEND	*be,
+	void					*beArg,
+	void					**smbHdlP );
+
+/* clones */
+extern int32 __MAPILIB SMB2API_Clone( void *smbHdl, void **cloneHdlP );
+
+/* scatter-gather I2C messages */
+extern int32 __MAPILIB SMB2API_I2CXferV(
+	void				*smbHdl,
+	SMB2API_I2C_MSGV	msg[],
+	u_int32				num );
+
+/* access sequences */
+extern int32 __MAPILIB SMB2API_SmbXferList(
+	void			*smbHdl,
+	SMB2API_XFER	xfer[],
+	u_int32			num,
+	u_int32			*errIdxP );
+
+/* prepared transactions (full transaction path, see SMB2API_Prepare) */
+extern int32 __MAPILIB SMB2API_Prepare(
+	void		*smbHdl,
+	u_int32		flags,
+	u_int16		addr,
+	u_int8		readWrite,
+	u_int8		cmdAddr,
+	u_int8		size,
+	void		**prepHdlP );
+extern int32 __MAPILIB SMB2API_PrepExec( void *prepHdl, u_int8 *dataP );
+extern int32 __MAPILIB SMB2API_PrepFree( void **prepHdlP );
+extern int32 __MAPILIB SMB2API_PrepBatchCreate(
+	void		*prepHdl[],
+	u_int32		num,
+	void		**batchHdlP );
+extern int32 __MAPILIB SMB2API_PrepBatchExec(
+	void		*batchHdl,
+	u_int8		*dataP[],
+	u_int32		*errIdxP );
+extern int32 __MAPILIB SMB2API_PrepBatchFree( void **batchHdlP );
+
+/* gather read */
+extern int32 __MAPILIB SMB2API_GatherRead(
+	void			*smbHdl,
+	u_int32			flags,
+	const u_int16	addr[],
+	u_int32			num,
+	u_int8			cmdAddr,
+	u_int8			size,
+	u_int8			*dataP,
+	int32			statusP[] );
+
+/* register snapshots */
+extern int32 __MAPILIB SMB2API_SnapRead(
+	void		*smbHdl,
+	u_int32		flags,
+	u_int16		addr,
+	u_int32		mode,
+	u_int8		first,
+	u_int32		num,
+	u_int8		*dataP );
+extern int32 __MAPILIB SMB2API_SnapRestore(
+	void			*smbHdl,
+	u_int32			flags,
+	u_int16			addr,
+	u_int32			mode,
+	u_int8			first,
+	u_int32			num,
+	const u_int8	*dataP,
+	u_int32			*writtenP );
+
+/* I2C memories */
+extern int32 __MAPILIB SMB2API_MemRead(
+	void		*smbHdl,
+	u_int32		flags,
+	u_int16		addr,
+	u_int32		mode,
+	u_int32		memAddr,
+	u_int8		*dataP,
+	u_int32		len );
+extern int32 __MAPILIB SMB2API_MemWrite(
+	void			*smbHdl,
+	u_int32			flags,
+	u_int16			addr,
+	u_int32			mode,
+	u_int32			memAddr,
+	const u_int8	*dataP,
+	u_int32			len,
+	u_int32			pageSize,
+	u_int32			*errOffP );
+extern int32 __MAPILIB SMB2API_MemVerify(
+	void			*smbHdl,
+	u_int32			flags,
+	u_int16			addr,
+	u_int32			mode,
+	u_int32			memAddr,
+	const u_int8	*dataP,
+	u_int32			len,
+	u_int32			chunk,
+	u_int32			*errOffP );
+extern u_int32 __MAPILIB SMB2API_Crc32(
+	u_int32			crc,
+	const u_int8	*dataP,
+	u_int32			len );
+
+/* presence cache */
+extern int32 __MAPILIB SMB2API_PresCacheSet( void *smbHdl, u_int32 ttlMs );
+extern int32 __MAPILIB SMB2API_PresInvalidate( void *smbHdl, u_int16 addr );
+extern int32 __MAPILIB SMB2API_PresStatsGet(
+	void				*smbHdl,
+	SMB2API_PRES_STATS	*statsP );
+
+/* capabilities and routing */
+extern int32 __MAPILIB SMB2API_RouteSet( void *smbHdl, u_int32 route );
+extern int32 __MAPILIB SMB2API_CapGet(
+	void			*smbHdl,
+	u_int8			readWrite,
+	u_int8			size,
+	SMB2API_CAP		*capP );
+
+/* priority classes */
+extern int32 __MAPILIB SMB2API_PrioSet( u_int32 prio );
+extern int32 __MAPILIB SMB2API_PrioStatsGet(
+	void				*smbHdl,
+	u_int32				prio,
+	SMB2API_PRIO_STATS	*statsP );
+extern int32 __MAPILIB SMB2API_PrioStatsReset( void *smbHdl );
+
+/* deadlines */
+extern int32 __MAPILIB SMB2API_DeadlineSet( void *smbHdl, u_int32 msec );
+extern int32 __MAPILIB SMB2API_DeadlineCallSet( u_int32 msec );
+extern int32 __MAPILIB SMB2API_DeadlineStatsGet(
+	void		*smbHdl,
+	u_int32		*droppedP,
+	u_int32		*overrunP );
+
+/* bus utilization */
+extern int32 __MAPILIB SMB2API_UtilCfg(
+	void		*smbHdl,
+	u_int32		busClk,
+	u_int32		targetPermille );
+extern int32 __MAPILIB SMB2API_UtilGet(
+	void			*smbHdl,
+	SMB2API_UTIL	*utilP );
+
+/* per device rate limits */
+extern int32 __MAPILIB SMB2API_RateSet(
+	void		*smbHdl,
+	u_int16		addr,
+	u_int32		maxPerSec,
+	u_int32		burst );
+extern int32 __MAPILIB SMB2API_RateStatsGet(
+	void				*smbHdl,
+	SMB2API_RATE_STATS	*statsP );
+
+/* record and replay */
+extern int32 __MAPILIB SMB2API_RecordStart( void *smbHdl, char *fileName );
+extern int32 __MAPILIB SMB2API_RecordStop( void *smbHdl );
+extern int32 __MAPILIB SMB2API_InitPlayback( char *fileName, void **smbHdlP );
+extern int32 __MAPILIB SMB2API_Replay(
+	void					*smbHdl,
+	char					*fileName,
+	u_int32					flags,
+	SMB2API_REPLAY_RESULT	*resP );
+
+/* extended alert callbacks */
+extern int32 __MAPILIB SMB2API_AlertCbInstallEx(
+	void		*smbHdl,
+	u_int16		addr,
+	void (*cbFuncExP)( void *cbArg, const SMB2API_ALERT_INFO *infoP ),
+	void		*cbArgP,
+	const SMB2API_ALERT_PREREAD *preReadP,
+	u_int32		sigCode );
+
+/* broker */
+extern int32 __MAPILIB SMB2API_InitBroker( char *sockPath, void **smbHdlP );
+extern int32 __MAPILIB SMB2API_BrokerServe(
+	void				*smbHdl,
+	char				*sockPath,
+	volatile u_int32	*stopP );
+
+/* alert engine */
+extern int32 __MAPILIB SMB2API_AlertEngineStart(
+	void					*smbHdl,
+	const SMB2API_ALERT_CFG	*cfgP );
+extern int32 __MAPILIB SMB2API_AlertEngineStop( void *smbHdl );
+
+/* simulated SMBus and test support */
+extern int32 __MAPILIB SMB2API_InitSim( u_int32 busClk, void **smbHdlP );
+extern int32 __MAPILIB SMB2API_SimDevSet(
+	void			*smbHdl,
+	u_int16			addr,
+	u_int32			present,
+	const u_int8	*regs );
+extern int32 __MAPILIB SMB2API_SimAlert( void *smbHdl, u_int16 addr );
+extern int32 __MAPILIB SMB2API_SimStatsGet(
+	void				*smbHdl,
+	SMB2API_SIM_STATS	*statsP );
+extern int32 __MAPILIB SMB2API_AlertStatsGet( SMB2API_ALERT_STATS *statsP );
+extern int32 __MAPILIB SMB2API_MemStatsGet( u_int32 *blocksP );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _SMB2_API_EXT_H */
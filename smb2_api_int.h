@@ -0,0 +1,39 @@
+/***********************  I n c l u d e  -  F i l e  ***********************/
+/*!
+ *        \file  smb2_api_int.h
+ *
+ *       \brief  Library internal functions of the SMB2_API
+ *
+ *               Used by the modules of the library (e.g. smb2_pmbus.c),
+ *               not part of the API.
+ *
+ *    \switches  -
+ *
+ *     Required: men_typs.h
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#ifndef _SMB2_API_INT_H
+#define _SMB2_API_INT_H
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/*--------------------------------------------------------------------------+
+|  PROTOTYPES                                                               |
++--------------------------------------------------------------------------*/
+extern int32 SMB2API_BusHold(
+	void		*smbHdl,
+	u_int32		flags,
+	u_int16		addr,
+	u_int32		num );
+extern void SMB2API_BusRelease( void *smbHdl );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _SMB2_API_INT_H */
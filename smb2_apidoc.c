@@ -76,13 +76,136 @@
   <b>Other read/write</b>\n
   - Quick command SMB2API_QuickComm()
   - Read/write using the I2C protocol SMB2API_I2CXfer()
+  - I2C messages with several buffers each (scatter-gather), e.g. memory
+    address and data from different places SMB2API_I2CXferV()
 
   <b>Alert support</b>\n
   - Issue a read byte command to the Alert Response Address SMB2API_AlertResponse()
   - Install/remove alert callback function SMB2API_AlertCbInstall(), SMB2API_AlertCbInstallSig(), SMB2API_AlertCbRemove()
 
-  <b>Unsupported SMB2 library functions</b>\n
-  - SMB2API_SmbXfer()\n
+  <b>Prepared transactions</b>\n
+  - Validate and pre-fill a transaction once, execute it repeatedly
+    SMB2API_Prepare(), SMB2API_PrepExec(), SMB2API_PrepFree()
+    (executed over the full transaction path: arbitration, statistics,
+    and the presence cache, rate limits, recording and routing if
+    enabled)
+  - Group prepared transactions SMB2API_PrepBatchCreate(),
+    SMB2API_PrepBatchExec(), SMB2API_PrepBatchFree()
+
+  <b>Gather read</b>\n
+  - Same register from many devices SMB2API_GatherRead()
+
+  <b>Register snapshots</b>\n
+  - Save the registers of a device SMB2API_SnapRead(), restore only the
+    differing registers SMB2API_SnapRestore() (sequential I2C access
+    with #SMB2API_SNAP_SEQ)
+
+  <b>I2C memories (EEPROM, flash)</b>\n
+  - Sequential read and page write SMB2API_MemRead(), SMB2API_MemWrite()
+  - Verify after write by CRC-32 of the read-back data per chunk
+    SMB2API_MemVerify(), #SMB2API_MEM_VERIFY, SMB2API_Crc32()
+
+  <b>Presence cache</b>\n
+  - Fail fast on absent devices SMB2API_PresCacheSet(),
+    SMB2API_PresInvalidate(), SMB2API_PresStatsGet()
+
+  <b>Capabilities and routing</b>\n
+  - Operations the controller does not support are emulated with I2C
+    messages (no block reads, default for SMB2API_Init()), optionally
+    the faster path is used SMB2API_RouteSet()
+  - Learned capabilities and timing SMB2API_CapGet()
+
+  <b>Cloned handles</b>\n
+  - Additional MDIS path per worker thread SMB2API_Clone(), transactions
+    of different clones are arbitrated by the driver instead of the
+    library, alerts and statistics are shared with the parent handle
+
+  <b>Priority classes</b>\n
+  - Transactions are served by priority class (SMB2API_FLAG_PRIO_XXX flags
+    or thread default SMB2API_PrioSet()). A waiting high priority transaction
+    gets the bus at the next message boundary of a batch or I2C transfer.
+  - Latency statistics per class SMB2API_PrioStatsGet(), SMB2API_PrioStatsReset()
+
+  <b>Deadlines</b>\n
+  - Per handle and per call deadlines SMB2API_DeadlineSet(), SMB2API_DeadlineCallSet()
+  - Deadline miss counters SMB2API_DeadlineStatsGet()
+
+  <b>Bus utilization</b>\n
+  - Estimated bus occupancy and throughput SMB2API_UtilGet()
+  - Bus clock and throttling of background (#SMB2API_PRIO_LOW) transactions
+    SMB2API_UtilCfg()
+
+  <b>Per device rate limits</b>\n
+  - Token bucket per device address SMB2API_RateSet(), transactions
+    exceeding the limit wait without blocking the bus
+    SMB2API_RateStatsGet()
+
+  <b>Record and replay</b>\n
+  - Record transactions to a file SMB2API_RecordStart(), SMB2API_RecordStop()
+  - Replay and compare recorded transactions SMB2API_Replay()
+  - Simulated SMBus from a record file SMB2API_InitPlayback() or from
+    application defined backend functions SMB2API_InitBackend()
+
+  <b>Broker</b>\n
+  - One process owns the device and serves other processes over a Unix
+    domain socket SMB2API_BrokerServe(), clients get an SMB handle with
+    SMB2API_InitBroker()
+
+  <b>Alert engine</b>\n
+  - Drain the alert response address, coalesce and debounce alerts
+    SMB2API_AlertEngineStart(), SMB2API_AlertEngineStop()
+  - Alert callbacks with address, timestamps, alert response data and
+    status register pre-read by the engine SMB2API_AlertCbInstallEx()
+  - Any number of alert addresses per signal, demultiplexed by the
+    alert engine (see SMB2API_AlertCbInstallSig())
+  - Polling of the alert response address with adaptive interval where
+    alert signals are not available (#SMB2API_ALERT_POLL)
+
+  <b>Static tracepoints (Linux)</b>\n
+  - USDT probes of provider smb2api for bpftrace/perf, a NOP when not
+    traced (built if <sys/sdt.h> is available, switch SMB2API_NO_USDT):
+    - api__entry/api__return: SMB2 library functions
+      (function name, handle, SMB2_BLK_XXX code, object size / result)
+    - trx__entry/trx__return: each transaction incl. bus arbitration
+      (handle, code, address, command, size / result)
+    - drv__entry/drv__return: each driver or backend call
+      (handle, code, address, command, size / result)
+  \verbatim
+  bpftrace -e 'usdt:./libsmb2_api.so:smb2api:drv__entry { @t[tid] = nsecs; }
+    usdt:./libsmb2_api.so:smb2api:drv__return /@t[tid]/ {
+      @us[arg1] = hist((nsecs - @t[tid]) / 1000); delete(@t[tid]); }' \endverbatim
+
+  <b>Simulated SMBus and test support</b>\n
+  - In-process SMBus simulation SMB2API_InitSim(), SMB2API_SimDevSet()
+  - Alert injection SMB2API_SimAlert(), SMB2API_SimStatsGet()
+  - Lost alert and leak checks SMB2API_AlertStatsGet(),
+    SMB2API_MemStatsGet()
+
+  <b>PMBus layer (smb2_pmbus.h)</b>\n
+  - PAGE aware command access SMB2API_PmbusDevInit(),
+    SMB2API_PmbusPageSet(), SMB2API_PmbusReadWord(), ...
+  - Telemetry sets SMB2API_PmbusTlmCreate(), SMB2API_PmbusTlmRead(),
+    SMB2API_PmbusTlmFree()
+  - Bulk decoders SMB2API_PmbusLinear11(), SMB2API_PmbusLinear16(),
+    SMB2API_PmbusDirect()
+
+  <b>Shared memory telemetry (smb2_shm.h)</b>\n
+  - Publisher SMB2API_ShmPubCreate(), SMB2API_ShmPubUpdate(),
+    SMB2API_ShmPubDestroy()
+  - Readers without bus access SMB2API_ShmOpen(), SMB2API_ShmFind(),
+    SMB2API_ShmRead(), SMB2API_ShmPolls(), SMB2API_ShmClose()
+
+  <b>C++ layer (smb2_api.hpp, header only, C++20)</b>\n
+  - RAII handle smb2api::Handle (Init, InitSim, Clone, Exit on
+    destruction)
+  - Block and I2C transfers on std::span buffers without heap
+    allocation, I2C messages smb2api::I2cWrite(), smb2api::I2cRead()
+  - Register accessors specialized by address, command and width
+    smb2api::Reg
+
+  <b>Generic SMBus access</b>\n
+  - Any access size through one entry SMB2API_SmbXfer() (also
+    SMB_ENTRIES::SmbXfer), sequences of accesses SMB2API_SmbXferList()
 
   \n \subsection smb2_api_call   Calling SMB2_API functions
   The SMB2_API functions can be called either directly or via the SMB-Handle
@@ -0,0 +1,562 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  smb2_pmbus.c
+ *
+ *  	 \brief  PMBus command layer on top of the SMB2_API
+ *
+ *               PAGE aware command access, telemetry sets and bulk
+ *               decoders for the PMBus data formats.
+ *
+ *     Switches: -
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#include <stdlib.h>
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_err.h>
+#include <MEN/smb2_api.h>
+#include "smb2_api_ext.h"
+#include "smb2_api_int.h"
+#include "smb2_pmbus.h"
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/** Entry of a telemetry set */
+typedef struct
+{
+	SMB2API_PMBUS_TLM	tlm;	/**< telemetry entry */
+	u_int32				idx;	/**< index in the result arrays */
+	void				*prep;	/**< prepared word read */
+}TLM_ENT;
+
+/** Telemetry set (see SMB2API_PmbusTlmCreate) */
+typedef struct
+{
+	u_int32		num;		/**< number of entries */
+	TLM_ENT		ent[1];		/**< entries grouped by device/page */
+}TLM_SET;
+
+/** Float with access to its bits */
+typedef union
+{
+	float		f;
+	u_int32		u;
+}FLOAT_BITS;
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static float Pow2f( int32 e );
+
+/**
+ * \defgroup _SMB2_PMBUS SMB2_API PMBus layer
+ *  PMBus command access on top of the SMB2_API.
+ *
+ *  A PMBus device object caches the PAGE of the device, so commands to
+ *  the same page do not repeat the PAGE write. The cache assumes that
+ *  the device is accessed through its device object only, by one
+ *  thread at a time.
+ *  @{
+ */
+
+/****************************************************************************/
+/** Init PMBus device object
+ *
+ *---------------------------------------------------------------------------
+ *  \param     devP		  \OUT device object
+ *	\param     smbHdl	  \IN SMB handle
+ *	\param     flags	  \IN flags for the accesses, see \ref _SMB2_FLAG
+ *	\param     addr		  \IN device address
+ *
+ *  \return    0 | error code
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PmbusDevInit(
+	SMB2API_PMBUS_DEV	*devP,
+	void				*smbHdl,
+	u_int32				flags,
+	u_int16				addr )
+{
+	if( !devP || !smbHdl )
+		return (SMB_ERR_PARAM);
+
+	devP->smbHdl = smbHdl;
+	devP->flags = flags;
+	devP->addr = addr;
+	devP->page = SMB2API_PMBUS_NOPAGE;
+	devP->pageWrites = 0;
+	devP->pageSkips = 0;
+
+	return 0;
+}
+
+/****************************************************************************/
+/** Select page of a PMBus device
+ *
+ *  PAGE is written only if the cached page of the device differs.
+ *  If the write fails, the page is unknown and written again by the
+ *  next access.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     devP		  \IN device object
+ *	\param     page		  \IN page (0..0xff) or #SMB2API_PMBUS_NOPAGE
+ *						   (nothing to do)
+ *
+ *  \return    0 | error code
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PmbusPageSet(
+	SMB2API_PMBUS_DEV	*devP,
+	u_int16				page )
+{
+	int32 rv;
+
+	if( page == SMB2API_PMBUS_NOPAGE )
+		return 0;
+
+	if( page > 0xff )
+		return (SMB_ERR_PARAM);
+
+	if( devP->page == page ){
+		devP->pageSkips++;
+		return 0;
+	}
+
+	rv = SMB2API_WriteByteData( devP->smbHdl, devP->flags, devP->addr,
+								SMB2API_PMBUS_PAGE, (u_int8)page );
+	if( rv ){
+		devP->page = SMB2API_PMBUS_NOPAGE;
+		return rv;
+	}
+
+	devP->page = page;
+	devP->pageWrites++;
+	return 0;
+}
+
+/****************************************************************************/
+/** Read byte command of a PMBus device page
+ *
+ *---------------------------------------------------------------------------
+ *  \param     devP		  \IN device object
+ *	\param     page		  \IN page or #SMB2API_PMBUS_NOPAGE
+ *	\param     cmd		  \IN PMBus command
+ *	\param     byteP	  \OUT read value
+ *
+ *  \return    0 | error code
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PmbusReadByte(
+	SMB2API_PMBUS_DEV	*devP,
+	u_int16				page,
+	u_int8				cmd,
+	u_int8				*byteP )
+{
+	int32 rv;
+
+	if( (rv = SMB2API_PmbusPageSet( devP, page )) )
+		return rv;
+
+	return SMB2API_ReadByteData( devP->smbHdl, devP->flags, devP->addr,
+								 cmd, byteP );
+}
+
+/****************************************************************************/
+/** Write byte command of a PMBus device page
+ *
+ *---------------------------------------------------------------------------
+ *  \param     devP		  \IN device object
+ *	\param     page		  \IN page or #SMB2API_PMBUS_NOPAGE
+ *	\param     cmd		  \IN PMBus command
+ *	\param     byte		  \IN value to write
+ *
+ *  \return    0 | error code
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PmbusWriteByte(
+	SMB2API_PMBUS_DEV	*devP,
+	u_int16				page,
+	u_int8				cmd,
+	u_int8				byte )
+{
+	int32 rv;
+
+	if( (rv = SMB2API_PmbusPageSet( devP, page )) )
+		return rv;
+
+	return SMB2API_WriteByteData( devP->smbHdl, devP->flags, devP->addr,
+								  cmd, byte );
+}
+
+/****************************************************************************/
+/** Read word command of a PMBus device page
+ *
+ *---------------------------------------------------------------------------
+ *  \param     devP		  \IN device object
+ *	\param     page		  \IN page or #SMB2API_PMBUS_NOPAGE
+ *	\param     cmd		  \IN PMBus command
+ *	\param     wordP	  \OUT read value
+ *
+ *  \return    0 | error code
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PmbusReadWord(
+	SMB2API_PMBUS_DEV	*devP,
+	u_int16				page,
+	u_int8				cmd,
+	u_int16				*wordP )
+{
+	int32 rv;
+
+	if( (rv = SMB2API_PmbusPageSet( devP, page )) )
+		return rv;
+
+	return SMB2API_ReadWordData( devP->smbHdl, devP->flags, devP->addr,
+								 cmd, wordP );
+}
+
+/****************************************************************************/
+/** Write word command of a PMBus device page
+ *
+ *---------------------------------------------------------------------------
+ *  \param     devP		  \IN device object
+ *	\param     page		  \IN page or #SMB2API_PMBUS_NOPAGE
+ *	\param     cmd		  \IN PMBus command
+ *	\param     word		  \IN value to write
+ *
+ *  \return    0 | error code
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PmbusWriteWord(
+	SMB2API_PMBUS_DEV	*devP,
+	u_int16				page,
+	u_int8				cmd,
+	u_int16				word )
+{
+	int32 rv;
+
+	if( (rv = SMB2API_PmbusPageSet( devP, page )) )
+		return rv;
+
+	return SMB2API_WriteWordData( devP->smbHdl, devP->flags, devP->addr,
+								  cmd, word );
+}
+
+/****************************************************************************/
+/** Create a telemetry set
+ *
+ *  A telemetry set reads word commands (e.g. READ_VOUT, READ_IOUT and
+ *  READ_TEMPERATURE_1 of all rails) with one call of
+ *  SMB2API_PmbusTlmRead(). The reads are prepared once (see
+ *  SMB2API_Prepare) and grouped by device and page, so each page is
+ *  selected once per read of the set, regardless of the order of
+ *  \a tlm[].
+ *
+ *  The device objects must stay valid until the set is freed.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     tlm		  \IN telemetry entries
+ *	\param     num		  \IN number of entries
+ *	\param     tlmHdlP	  \OUT telemetry set handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PmbusTlmRead, SMB2API_PmbusTlmFree
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PmbusTlmCreate(
+	const SMB2API_PMBUS_TLM	tlm[],
+	u_int32					num,
+	void					**tlmHdlP )
+{
+	TLM_SET		*s;
+	TLM_ENT		*ent;
+	u_int8		*placed;
+	u_int32		i, j, n;
+	int32		rv = 0;
+
+	*tlmHdlP = NULL;
+
+	if( !tlm || (num < 1) )
+		return (SMB_ERR_PARAM);
+
+	for( i=0; i<num; i++ ){
+		if( !tlm[i].dev ||
+			((tlm[i].page > 0xff) && (tlm[i].page != SMB2API_PMBUS_NOPAGE)) )
+			return (SMB_ERR_PARAM);
+	}
+
+	s = (TLM_SET*)calloc( 1, sizeof(TLM_SET) + (num - 1) * sizeof(TLM_ENT) );
+	placed = (u_int8*)calloc( num, 1 );
+	if( !s || !placed ){
+		free( s );
+		free( placed );
+		return (SMB_ERR_NO_MEM);
+	}
+
+	/* group by device/page in order of first appearance */
+	for( i=0, n=0; i<num; i++ ){
+		if( placed[i] )
+			continue;
+
+		for( j=i; j<num; j++ ){
+			if( placed[j] || (tlm[j].dev != tlm[i].dev) ||
+				(tlm[j].page != tlm[i].page) )
+				continue;
+
+			ent = &s->ent[n++];
+			ent->tlm = tlm[j];
+			ent->idx = j;
+			placed[j] = 1;
+		}
+	}
+	free( placed );
+
+	/* prepare the reads */
+	for( n=0; n<num && !rv; n++ ){
+		ent = &s->ent[n];
+		rv = SMB2API_Prepare( ent->tlm.dev->smbHdl, ent->tlm.dev->flags,
+							  ent->tlm.dev->addr, SMB_READ, ent->tlm.cmd,
+							  SMB_ACC_WORD_DATA, &ent->prep );
+		s->num++;
+	}
+
+	if( rv ){
+		SMB2API_PmbusTlmFree( (void**)&s );
+		return rv;
+	}
+
+	*tlmHdlP = (void*)s;
+	return 0;
+}
+
+/****************************************************************************/
+/** Read a telemetry set
+ *
+ *  The raw values are stored in the order of the entries passed to
+ *  SMB2API_PmbusTlmCreate(). The raw value of a failed entry is zero.
+ *  If the PAGE write fails, the entries of the page fail with its error
+ *  without further bus access.
+ *
+ *  The bus is owned for each device/page (PAGE write and the reads of
+ *  the page), so other threads, clones of the SMB handle or broker
+ *  clients cannot change the page in between.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     tlmHdl	  \IN telemetry set handle
+ *	\param     rawP		  \OUT raw values (one per entry)
+ *	\param     statusP	  \OUT status codes (0 or error code, one per entry)
+ *
+ *  \return    0 | error code (status of the entries in statusP)
+ *
+ *  \sa SMB2API_PmbusTlmCreate
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PmbusTlmRead(
+	void		*tlmHdl,
+	u_int16		rawP[],
+	int32		statusP[] )
+{
+	TLM_SET				*s = (TLM_SET*)tlmHdl;
+	TLM_ENT				*ent, *prev = NULL;
+	SMB2API_PMBUS_DEV	*dev;
+	u_int16				word;
+	u_int32				n, trx, held = 0;
+	int32				rv, pageRv = 0;
+
+	if( !s || !rawP || !statusP )
+		return (SMB_ERR_PARAM);
+
+	for( n=0; n<s->num; n++ ){
+		ent = &s->ent[n];
+		dev = ent->tlm.dev;
+
+		/* first entry of device/page: own the bus, select page */
+		if( !prev || (prev->tlm.dev != dev) ||
+			(prev->tlm.page != ent->tlm.page) ){
+			if( held )
+				SMB2API_BusRelease( prev->tlm.dev->smbHdl );
+
+			/* transactions of the group: reads and PAGE write */
+			for( trx=1; (n + trx < s->num) &&
+					 (s->ent[n + trx].tlm.dev == dev) &&
+					 (s->ent[n + trx].tlm.page == ent->tlm.page); trx++ )
+				;
+			if( (ent->tlm.page != SMB2API_PMBUS_NOPAGE) &&
+				(dev->page != ent->tlm.page) )
+				trx++;
+
+			pageRv = SMB2API_BusHold( dev->smbHdl, dev->flags, dev->addr,
+									  trx );
+			if( (held = !pageRv) )
+				pageRv = SMB2API_PmbusPageSet( dev, ent->tlm.page );
+		}
+		prev = ent;
+
+		word = 0;
+		if( !(rv = pageRv) )
+			rv = SMB2API_PrepExec( ent->prep, (u_int8*)&word );
+
+		rawP[ent->idx] = rv ? 0 : word;
+		statusP[ent->idx] = rv;
+	}
+
+	if( held )
+		SMB2API_BusRelease( prev->tlm.dev->smbHdl );
+
+	return 0;
+}
+
+/****************************************************************************/
+/** Free a telemetry set
+ *
+ *  *tlmHdlP will be set to NULL.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     tlmHdlP	  \INOUT pointer to telemetry set handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_PmbusTlmCreate
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_PmbusTlmFree( void **tlmHdlP )
+{
+	TLM_SET		*s = (TLM_SET*)*tlmHdlP;
+	u_int32		n;
+
+	if( s ){
+		for( n=0; n<s->num; n++ )
+			SMB2API_PrepFree( &s->ent[n].prep );
+		free( s );
+		*tlmHdlP = NULL;
+	}
+
+	return 0;
+}
+
+/****************************************************************************/
+/** Decode LINEAR11 values
+ *
+ *  value = mantissa * 2^exponent with the 11-bit two's complement
+ *  mantissa in bits 10..0 and the 5-bit two's complement exponent in
+ *  bits 15..11 (e.g. READ_IOUT, READ_TEMPERATURE_1).
+ *
+ *  The loop has no branches and no library calls, so the compiler can
+ *  vectorize it.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     raw		  \IN raw values
+ *	\param     num		  \IN number of values
+ *	\param     val		  \OUT decoded values
+ *
+ ****************************************************************************/
+void __MAPILIB SMB2API_PmbusLinear11(
+	const u_int16	raw[],
+	u_int32			num,
+	float			val[] )
+{
+	FLOAT_BITS	scale;
+	int32		m, e;
+	u_int32		i;
+
+	for( i=0; i<num; i++ ){
+		m = (int32)(raw[i] & 0x7ff) - (int32)(raw[i] & 0x400) * 2;
+		e = (int32)(raw[i] >> 11) - (int32)((raw[i] >> 11) & 0x10) * 2;
+
+		/* 2^e built from the float exponent bits (-16 <= e <= 15) */
+		scale.u = (u_int32)(e + 127) << 23;
+		val[i] = (float)m * scale.f;
+	}
+}
+
+/****************************************************************************/
+/** Decode LINEAR16 values
+ *
+ *  value = raw * 2^exp with the unsigned 16-bit raw value and the
+ *  exponent from VOUT_MODE (see #SMB2API_PMBUS_VOUT_EXP), e.g. for
+ *  READ_VOUT.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     raw		  \IN raw values
+ *	\param     num		  \IN number of values
+ *	\param     exp		  \IN exponent (-16..15)
+ *	\param     val		  \OUT decoded values
+ *
+ ****************************************************************************/
+void __MAPILIB SMB2API_PmbusLinear16(
+	const u_int16	raw[],
+	u_int32			num,
+	int32			exp,
+	float			val[] )
+{
+	float		scale = Pow2f( exp );
+	u_int32		i;
+
+	for( i=0; i<num; i++ )
+		val[i] = (float)raw[i] * scale;
+}
+
+/****************************************************************************/
+/** Decode DIRECT values
+ *
+ *  value = (Y * 10^-R - b) / m with the 16-bit two's complement raw
+ *  value Y and the coefficients of the command (see the device data
+ *  sheet or COEFFICIENTS command). The values are zero if m is zero.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     raw		  \IN raw values
+ *	\param     num		  \IN number of values
+ *	\param     coefP	  \IN coefficients
+ *	\param     val		  \OUT decoded values
+ *
+ ****************************************************************************/
+void __MAPILIB SMB2API_PmbusDirect(
+	const u_int16				raw[],
+	u_int32						num,
+	const SMB2API_PMBUS_DIRECT	*coefP,
+	float						val[] )
+{
+	float		scale = 1.0f, offset;
+	int32		r;
+	u_int32		i;
+
+	/* X = Y * scale - offset */
+	for( r=coefP->r; r>0; r-- )
+		scale /= 10.0f;
+	for( ; r<0; r++ )
+		scale *= 10.0f;
+
+	if( coefP->m ){
+		scale /= (float)coefP->m;
+		offset = (float)coefP->b / (float)coefP->m;
+	}
+	else
+		scale = offset = 0.0f;
+
+	for( i=0; i<num; i++ )
+		val[i] = (float)(int16)raw[i] * scale - offset;
+}
+
+/*! @} */
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Return 2^e (-126 <= e <= 127)
+ */
+static float Pow2f( int32 e )
+{
+	FLOAT_BITS p;
+
+	if( e < -126 )
+		return 0.0f;
+	if( e > 127 )
+		e = 127;
+
+	p.u = (u_int32)(e + 127) << 23;
+	return p.f;
+}
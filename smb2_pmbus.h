@@ -0,0 +1,149 @@
+/***********************  I n c l u d e  -  F i l e  ***********************/
+/*!
+ *        \file  smb2_pmbus.h
+ *
+ *       \brief  PMBus command layer on top of the SMB2_API
+ *
+ *               PAGE aware command access, telemetry sets and bulk
+ *               decoders for LINEAR11, LINEAR16 and DIRECT data formats.
+ *
+ *    \switches  -
+ *
+ *     Required: men_typs.h, mdis_err.h, smb2_api.h
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#ifndef _SMB2_PMBUS_H
+#define _SMB2_PMBUS_H
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/*--------------------------------------------------------------------------+
+|  DEFINES                                                                  |
++--------------------------------------------------------------------------*/
+/** \defgroup _SMB2API_PMBUS_CMD PMBus commands (subset)
+ *  @{ */
+#define SMB2API_PMBUS_PAGE					0x00
+#define SMB2API_PMBUS_OPERATION				0x01
+#define SMB2API_PMBUS_CLEAR_FAULTS			0x03
+#define SMB2API_PMBUS_VOUT_MODE				0x20
+#define SMB2API_PMBUS_VOUT_COMMAND			0x21
+#define SMB2API_PMBUS_STATUS_BYTE			0x78
+#define SMB2API_PMBUS_STATUS_WORD			0x79
+#define SMB2API_PMBUS_READ_VIN				0x88
+#define SMB2API_PMBUS_READ_IIN				0x89
+#define SMB2API_PMBUS_READ_VOUT				0x8b
+#define SMB2API_PMBUS_READ_IOUT				0x8c
+#define SMB2API_PMBUS_READ_TEMPERATURE_1	0x8d
+#define SMB2API_PMBUS_READ_TEMPERATURE_2	0x8e
+#define SMB2API_PMBUS_READ_POUT				0x96
+#define SMB2API_PMBUS_READ_PIN				0x97
+/** @} */
+
+/** Page of page independent commands (no PAGE write) */
+#define SMB2API_PMBUS_NOPAGE	0x100
+
+/** Exponent of LINEAR16 data from VOUT_MODE */
+#define SMB2API_PMBUS_VOUT_EXP( voutMode ) \
+	((int32)((voutMode) & 0x0f) - (int32)((voutMode) & 0x10))
+
+/*--------------------------------------------------------------------------+
+|  TYPEDEFS                                                                 |
++--------------------------------------------------------------------------*/
+/** PMBus device (see SMB2API_PmbusDevInit) */
+typedef struct
+{
+	void		*smbHdl;		/**< SMB handle */
+	u_int32		flags;			/**< flags for the accesses */
+	u_int16		addr;			/**< device address */
+	u_int16		page;			/**< cached PAGE or SMB2API_PMBUS_NOPAGE
+									 (unknown) */
+	u_int32		pageWrites;		/**< PAGE writes done */
+	u_int32		pageSkips;		/**< PAGE writes avoided by the cache */
+}SMB2API_PMBUS_DEV;
+
+/** Telemetry entry (see SMB2API_PmbusTlmCreate) */
+typedef struct
+{
+	SMB2API_PMBUS_DEV	*dev;	/**< device */
+	u_int16		page;			/**< page or SMB2API_PMBUS_NOPAGE */
+	u_int8		cmd;			/**< word read command (e.g. READ_VOUT) */
+}SMB2API_PMBUS_TLM;
+
+/** DIRECT data format coefficients: X = (Y * 10^-R - b) / m */
+typedef struct
+{
+	int32		m;				/**< slope */
+	int32		b;				/**< offset */
+	int32		r;				/**< exponent */
+}SMB2API_PMBUS_DIRECT;
+
+/*--------------------------------------------------------------------------+
+|  PROTOTYPES                                                               |
++--------------------------------------------------------------------------*/
+/* PAGE aware command access */
+extern int32 __MAPILIB SMB2API_PmbusDevInit(
+	SMB2API_PMBUS_DEV	*devP,
+	void				*smbHdl,
+	u_int32				flags,
+	u_int16				addr );
+extern int32 __MAPILIB SMB2API_PmbusPageSet(
+	SMB2API_PMBUS_DEV	*devP,
+	u_int16				page );
+extern int32 __MAPILIB SMB2API_PmbusReadByte(
+	SMB2API_PMBUS_DEV	*devP,
+	u_int16				page,
+	u_int8				cmd,
+	u_int8				*byteP );
+extern int32 __MAPILIB SMB2API_PmbusWriteByte(
+	SMB2API_PMBUS_DEV	*devP,
+	u_int16				page,
+	u_int8				cmd,
+	u_int8				byte );
+extern int32 __MAPILIB SMB2API_PmbusReadWord(
+	SMB2API_PMBUS_DEV	*devP,
+	u_int16				page,
+	u_int8				cmd,
+	u_int16				*wordP );
+extern int32 __MAPILIB SMB2API_PmbusWriteWord(
+	SMB2API_PMBUS_DEV	*devP,
+	u_int16				page,
+	u_int8				cmd,
+	u_int16				word );
+
+/* telemetry sets */
+extern int32 __MAPILIB SMB2API_PmbusTlmCreate(
+	const SMB2API_PMBUS_TLM	tlm[],
+	u_int32					num,
+	void					**tlmHdlP );
+extern int32 __MAPILIB SMB2API_PmbusTlmRead(
+	void		*tlmHdl,
+	u_int16		rawP[],
+	int32		statusP[] );
+extern int32 __MAPILIB SMB2API_PmbusTlmFree( void **tlmHdlP );
+
+/* bulk decoders */
+extern void __MAPILIB SMB2API_PmbusLinear11(
+	const u_int16	raw[],
+	u_int32			num,
+	float			val[] );
+extern void __MAPILIB SMB2API_PmbusLinear16(
+	const u_int16	raw[],
+	u_int32			num,
+	int32			exp,
+	float			val[] );
+extern void __MAPILIB SMB2API_PmbusDirect(
+	const u_int16				raw[],
+	u_int32						num,
+	const SMB2API_PMBUS_DIRECT	*coefP,
+	float						val[] );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _SMB2_PMBUS_H */
@@ -0,0 +1,575 @@
+/*********************  P r o g r a m  -  M o d u l e ***********************/
+/*!
+ *        \file  smb2_shm.c
+ *
+ *  	 \brief  Shared memory telemetry publisher and reader
+ *
+ *               The publisher polls registers with prepared transactions
+ *               and writes the values into a shared memory region, one
+ *               seqlock per entry. Readers map the region read-only.
+ *
+ *     Switches: WINNT - Windows file mapping instead of POSIX shared memory
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(WINNT)
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
+#include <MEN/men_typs.h>
+#include <MEN/mdis_err.h>
+#include <MEN/smb2.h>
+#include <MEN/smb2_api.h>
+#include "smb2_api_ext.h"
+#include "smb2_shm.h"
+
+/*-----------------------------------------+
+|  DEFINES                                 |
++-----------------------------------------*/
+#define SHM_MAGIC		0x534d4232	/* 'SMB2' */
+#define SHM_LAYOUT		1			/* layout version of the region */
+#define SHM_RETRIES		100000		/* max. seqlock read retries */
+
+/* full memory barrier */
+#if defined(WINNT)
+#	define SHM_BARRIER()	MemoryBarrier()
+#else
+#	define SHM_BARRIER()	__sync_synchronize()
+#endif
+
+/*-----------------------------------------+
+|  TYPEDEFS                                |
++-----------------------------------------*/
+/** Header of the shared memory region */
+typedef struct
+{
+	volatile u_int32	magic;		/**< SHM_MAGIC (set when initialized) */
+	u_int32				layout;		/**< SHM_LAYOUT */
+	u_int32				num;		/**< number of entries */
+	u_int32				entSize;	/**< size of an entry */
+	volatile u_int32	polls;		/**< completed polls of all entries */
+}SHM_HDR;
+
+/** Entry of the shared memory region */
+typedef struct
+{
+	volatile u_int32	seq;		/**< seqlock (odd while written) */
+	SMB2API_SHM_VALUE	val;		/**< published value */
+}SHM_ENT;
+
+/** Mapping of the shared memory region */
+typedef struct
+{
+#if defined(WINNT)
+	HANDLE		map;		/**< file mapping */
+#else
+	int			fd;			/**< shared memory object */
+#endif
+	u_int32		size;		/**< size of the region */
+	SHM_HDR		*hdr;		/**< mapped region */
+	SHM_ENT		*ent;		/**< entries of the region */
+}SHM_MAP;
+
+/** Publisher (see SMB2API_ShmPubCreate) */
+typedef struct
+{
+	SHM_MAP		m;			/**< region (read/write) */
+	char		*name;		/**< name of the region */
+	u_int32		num;		/**< number of entries */
+	void		**prep;		/**< prepared read per entry */
+}SHM_PUB;
+
+/*-----------------------------------------+
+|  PROTOTYPES                              |
++-----------------------------------------*/
+static int32 ShmMap( const char *name, u_int32 size, u_int32 create,
+					 SHM_MAP *m );
+static void ShmUnmap( SHM_MAP *m );
+
+/**
+ * \defgroup _SMB2_SHM SMB2_API shared memory telemetry
+ *  Several processes need the same sensor values. One process publishes
+ *  them: it polls the registers with SMB2API_ShmPubUpdate(), e.g. once
+ *  per second, and writes the values into a named shared memory region.
+ *  Other processes map the region read-only with SMB2API_ShmOpen() and
+ *  read the values at memory speed, without SMB handle and bus access.
+ *
+ *  Each entry is protected by a seqlock: the publisher makes the
+ *  sequence number odd while it writes the entry, readers retry until
+ *  they copied the entry with the same even sequence number before and
+ *  after. Readers never block the publisher.
+ *
+ *  The region name is passed to shm_open() (POSIX, must start with
+ *  '/') or CreateFileMapping() (Windows).
+ *  @{
+ */
+
+/****************************************************************************/
+/** Create a telemetry publisher
+ *
+ *  The shared memory region \a name is (re)created with one entry per
+ *  register of \a ent[]. The reads are prepared once (see
+ *  SMB2API_Prepare). Until the first poll, the status of the entries is
+ *  #SMB2API_ERR_NO_DATA.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     name		  \IN name of the shared memory region
+ *	\param     smbHdl	  \IN SMB handle
+ *	\param     flags	  \IN flags for the reads, see \ref _SMB2_FLAG
+ *	\param     ent		  \IN registers to publish
+ *	\param     num		  \IN number of registers
+ *	\param     pubHdlP	  \OUT publisher handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_ShmPubUpdate, SMB2API_ShmPubDestroy
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_ShmPubCreate(
+	const char				*name,
+	void					*smbHdl,
+	u_int32					flags,
+	const SMB2API_SHM_ENTRY	ent[],
+	u_int32					num,
+	void					**pubHdlP )
+{
+	SHM_PUB		*pub;
+	SHM_ENT		*e;
+	u_int32		n;
+	int32		rv = 0;
+
+	*pubHdlP = NULL;
+
+	if( !name || !smbHdl || !ent || (num < 1) )
+		return (SMB_ERR_PARAM);
+
+	if( !(pub = (SHM_PUB*)calloc( 1, sizeof(SHM_PUB) )) )
+		return (SMB_ERR_NO_MEM);
+
+	pub->prep = (void**)calloc( num, sizeof(void*) );
+	pub->name = (char*)malloc( strlen(name) + 1 );
+	if( !pub->prep || !pub->name ){
+		rv = SMB_ERR_NO_MEM;
+		goto ERR_EXIT;
+	}
+	strcpy( pub->name, name );
+
+	/* prepare the reads */
+	for( n=0; n<num && !rv; n++ ){
+		rv = SMB2API_Prepare( smbHdl, flags, ent[n].addr, SMB_READ,
+							  ent[n].cmdAddr, ent[n].size, &pub->prep[n] );
+		pub->num++;
+	}
+	if( rv )
+		goto ERR_EXIT;
+
+	/* create region */
+	if( (rv = ShmMap( name, sizeof(SHM_HDR) + num * sizeof(SHM_ENT), 1,
+					  &pub->m )) )
+		goto ERR_EXIT;
+
+	pub->m.hdr->layout = SHM_LAYOUT;
+	pub->m.hdr->num = num;
+	pub->m.hdr->entSize = sizeof(SHM_ENT);
+	pub->m.hdr->polls = 0;
+
+	for( n=0; n<num; n++ ){
+		e = &pub->m.ent[n];
+		memset( (void*)&e->val, 0, sizeof(e->val) );
+		e->val.addr = ent[n].addr;
+		e->val.cmdAddr = ent[n].cmdAddr;
+		e->val.size = ent[n].size;
+		e->val.status = SMB2API_ERR_NO_DATA;
+		e->seq = 0;
+	}
+
+	/* region valid for readers */
+	SHM_BARRIER();
+	pub->m.hdr->magic = SHM_MAGIC;
+
+	*pubHdlP = (void*)pub;
+	return 0;
+
+ERR_EXIT:
+	SMB2API_ShmPubDestroy( (void**)&pub );
+	return rv;
+}
+
+/****************************************************************************/
+/** Poll all registers of a publisher and publish the values
+ *
+ *  The data of an entry is updated on success only, so readers get the
+ *  last good value together with the status of the last poll.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     pubHdl	  \IN publisher handle
+ *
+ *  \return    0 | error code (status of the entries in the region)
+ *
+ *  \sa SMB2API_ShmPubCreate
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_ShmPubUpdate( void *pubHdl )
+{
+	SHM_PUB		*pub = (SHM_PUB*)pubHdl;
+	SHM_ENT		*e;
+	u_int8		data[1 + SMB_BLOCK_MAX_BYTES];
+	u_int32		n;
+	int32		rv;
+
+	if( !pub )
+		return (SMB_ERR_PARAM);
+
+	for( n=0; n<pub->num; n++ ){
+		e = &pub->m.ent[n];
+
+		/* bus access outside of the seqlock */
+		memcpy( data, e->val.data, sizeof(data) );
+		rv = SMB2API_PrepExec( pub->prep[n], data );
+
+		/* publish */
+		e->seq++;
+		SHM_BARRIER();
+		e->val.status = rv;
+		e->val.polls++;
+		if( !rv )
+			memcpy( e->val.data, data, sizeof(data) );
+		SHM_BARRIER();
+		e->seq++;
+	}
+
+	pub->m.hdr->polls++;
+
+	return 0;
+}
+
+/****************************************************************************/
+/** Destroy a telemetry publisher
+ *
+ *  The shared memory region is removed. Readers that mapped it keep
+ *  the last values. *pubHdlP will be set to NULL.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     pubHdlP	  \INOUT pointer to publisher handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_ShmPubCreate
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_ShmPubDestroy( void **pubHdlP )
+{
+	SHM_PUB		*pub = (SHM_PUB*)*pubHdlP;
+	u_int32		n;
+
+	if( !pub )
+		return 0;
+
+	if( pub->m.hdr ){
+		ShmUnmap( &pub->m );
+#if !defined(WINNT)
+		shm_unlink( pub->name );
+#endif
+	}
+
+	for( n=0; n<pub->num; n++ )
+		SMB2API_PrepFree( &pub->prep[n] );
+
+	free( pub->prep );
+	free( pub->name );
+	free( pub );
+	*pubHdlP = NULL;
+
+	return 0;
+}
+
+/****************************************************************************/
+/** Open a published shared memory region (read-only)
+ *
+ *---------------------------------------------------------------------------
+ *  \param     name		  \IN name of the shared memory region
+ *	\param     shmHdlP	  \OUT reader handle
+ *	\param     numP		  \OUT number of entries (may be NULL)
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_ShmRead, SMB2API_ShmClose
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_ShmOpen(
+	const char	*name,
+	void		**shmHdlP,
+	u_int32		*numP )
+{
+	SHM_MAP		*m;
+	int32		rv;
+
+	*shmHdlP = NULL;
+
+	if( !name )
+		return (SMB_ERR_PARAM);
+
+	if( !(m = (SHM_MAP*)calloc( 1, sizeof(SHM_MAP) )) )
+		return (SMB_ERR_NO_MEM);
+
+	if( (rv = ShmMap( name, 0, 0, m )) ){
+		free( m );
+		return rv;
+	}
+
+	/* initialized region of a compatible publisher? */
+	if( (m->hdr->magic != SHM_MAGIC) || (m->hdr->layout != SHM_LAYOUT) ||
+		(m->hdr->entSize != sizeof(SHM_ENT)) ||
+		(m->size < sizeof(SHM_HDR) + m->hdr->num * sizeof(SHM_ENT)) ){
+		ShmUnmap( m );
+		free( m );
+		return (SMB2API_ERR_SHM);
+	}
+	SHM_BARRIER();
+
+	if( numP )
+		*numP = m->hdr->num;
+
+	*shmHdlP = (void*)m;
+	return 0;
+}
+
+/****************************************************************************/
+/** Find entry of a register in a published region
+ *
+ *---------------------------------------------------------------------------
+ *  \param     shmHdl	  \IN reader handle
+ *	\param     addr		  \IN device address
+ *	\param     cmdAddr	  \IN device command or index value
+ *	\param     idxP		  \OUT index of the entry
+ *
+ *  \return    0 | error code (#SMB_ERR_PARAM if not published)
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_ShmFind(
+	void		*shmHdl,
+	u_int16		addr,
+	u_int8		cmdAddr,
+	u_int32		*idxP )
+{
+	SHM_MAP		*m = (SHM_MAP*)shmHdl;
+	u_int32		n;
+
+	if( !m || !idxP )
+		return (SMB_ERR_PARAM);
+
+	/* address/command are not changed after creation */
+	for( n=0; n<m->hdr->num; n++ ){
+		if( (m->ent[n].val.addr == addr) &&
+			(m->ent[n].val.cmdAddr == cmdAddr) ){
+			*idxP = n;
+			return 0;
+		}
+	}
+
+	return (SMB_ERR_PARAM);
+}
+
+/****************************************************************************/
+/** Read a published value
+ *
+ *  Lock free, without bus access. Returns #SMB_ERR_BUSY if the entry
+ *  could not be read consistently (publisher died while writing).
+ *
+ *---------------------------------------------------------------------------
+ *  \param     shmHdl	  \IN reader handle
+ *	\param     idx		  \IN index of the entry (see SMB2API_ShmFind)
+ *	\param     valP		  \OUT value (see valP->status)
+ *
+ *  \return    0 | error code
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_ShmRead(
+	void				*shmHdl,
+	u_int32				idx,
+	SMB2API_SHM_VALUE	*valP )
+{
+	SHM_MAP		*m = (SHM_MAP*)shmHdl;
+	SHM_ENT		*e;
+	u_int32		seq, retry;
+
+	if( !m || !valP || (idx >= m->hdr->num) )
+		return (SMB_ERR_PARAM);
+
+	e = &m->ent[idx];
+
+	for( retry=0; retry<SHM_RETRIES; retry++ ){
+		seq = e->seq;
+		SHM_BARRIER();
+
+		/* not written meanwhile? */
+		if( !(seq & 1) ){
+			memcpy( valP, (const void*)&e->val, sizeof(*valP) );
+			SHM_BARRIER();
+			if( e->seq == seq )
+				return 0;
+		}
+	}
+
+	return (SMB_ERR_BUSY);
+}
+
+/****************************************************************************/
+/** Get number of completed polls of a published region
+ *
+ *  A reader can detect a stalled publisher if the number does not
+ *  increase.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     shmHdl	  \IN reader handle
+ *	\param     pollsP	  \OUT completed polls of all entries
+ *
+ *  \return    0 | error code
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_ShmPolls( void *shmHdl, u_int32 *pollsP )
+{
+	SHM_MAP *m = (SHM_MAP*)shmHdl;
+
+	if( !m || !pollsP )
+		return (SMB_ERR_PARAM);
+
+	*pollsP = m->hdr->polls;
+	return 0;
+}
+
+/****************************************************************************/
+/** Close a published shared memory region
+ *
+ *  *shmHdlP will be set to NULL.
+ *
+ *---------------------------------------------------------------------------
+ *  \param     shmHdlP	  \INOUT pointer to reader handle
+ *
+ *  \return    0 | error code
+ *
+ *  \sa SMB2API_ShmOpen
+ *
+ ****************************************************************************/
+int32 __MAPILIB SMB2API_ShmClose( void **shmHdlP )
+{
+	SHM_MAP *m = (SHM_MAP*)*shmHdlP;
+
+	if( m ){
+		ShmUnmap( m );
+		free( m );
+		*shmHdlP = NULL;
+	}
+
+	return 0;
+}
+
+/*! @} */
+
+/* * * * * * * * * * * * * * * helper funtion * * * * * * * * * * * * * *
+ *
+ * Map shared memory region: create (read/write, size bytes) or open
+ * existing (read-only, size from the region)
+ */
+#if defined(WINNT)
+static int32 ShmMap( const char *name, u_int32 size, u_int32 create,
+					 SHM_MAP *m )
+{
+	MEMORY_BASIC_INFORMATION info;
+
+	if( create )
+		m->map = CreateFileMappingA( INVALID_HANDLE_VALUE, NULL,
+									 PAGE_READWRITE, 0, size, name );
+	else
+		m->map = OpenFileMappingA( FILE_MAP_READ, FALSE, name );
+
+	if( !m->map )
+		return (SMB2API_ERR_SHM);
+
+	m->hdr = (SHM_HDR*)MapViewOfFile( m->map,
+									  create ? FILE_MAP_WRITE : FILE_MAP_READ,
+									  0, 0, 0 );
+	if( !m->hdr ){
+		CloseHandle( m->map );
+		return (SMB2API_ERR_SHM);
+	}
+
+	if( !create ){
+		VirtualQuery( (void*)m->hdr, &info, sizeof(info) );
+		size = (u_int32)info.RegionSize;
+	}
+
+	m->size = size;
+	m->ent = (SHM_ENT*)(m->hdr + 1);
+	return 0;
+}
+
+static void ShmUnmap( SHM_MAP *m )
+{
+	UnmapViewOfFile( (void*)m->hdr );
+	CloseHandle( m->map );
+	m->hdr = NULL;
+}
+#else
+static int32 ShmMap( const char *name, u_int32 size, u_int32 create,
+					 SHM_MAP *m )
+{
+	struct stat st;
+	void *p;
+
+	if( create ){
+		/* remove region of a previous publisher */
+		shm_unlink( name );
+		m->fd = shm_open( name, O_RDWR | O_CREAT | O_EXCL, 0644 );
+		if( (m->fd >= 0) && ftruncate( m->fd, size ) ){
+			close( m->fd );
+			shm_unlink( name );
+			m->fd = -1;
+		}
+	}
+	else {
+		if( (m->fd = shm_open( name, O_RDONLY, 0 )) >= 0 ){
+			if( fstat( m->fd, &st ) ){
+				close( m->fd );
+				m->fd = -1;
+			}
+			else
+				size = (u_int32)st.st_size;
+		}
+	}
+
+	if( m->fd < 0 )
+		return (SMB2API_ERR_SHM);
+
+	if( size < sizeof(SHM_HDR) ||
+		(p = mmap( NULL, size, create ? PROT_READ | PROT_WRITE : PROT_READ,
+				   MAP_SHARED, m->fd, 0 )) == MAP_FAILED ){
+		close( m->fd );
+		if( create )
+			shm_unlink( name );
+		return (SMB2API_ERR_SHM);
+	}
+
+	m->size = size;
+	m->hdr = (SHM_HDR*)p;
+	m->ent = (SHM_ENT*)(m->hdr + 1);
+	return 0;
+}
+
+static void ShmUnmap( SHM_MAP *m )
+{
+	munmap( (void*)m->hdr, m->size );
+	close( m->fd );
+	m->hdr = NULL;
+}
+#endif
@@ -0,0 +1,84 @@
+/***********************  I n c l u d e  -  F i l e  ***********************/
+/*!
+ *        \file  smb2_shm.h
+ *
+ *       \brief  Shared memory telemetry publisher and reader
+ *
+ *               One process polls SMBus registers through the SMB2_API
+ *               and publishes the values in a shared memory region,
+ *               other processes read them without bus access.
+ *
+ *    \switches  -
+ *
+ *     Required: men_typs.h, mdis_err.h, smb2.h, smb2_api.h
+ */
+/*---------------------------------------------------------------------------
+ * (c) Copyright 2006 by MEN mikro elektronik GmbH, Nuernberg, Germany
+ ****************************************************************************/
+
+#ifndef _SMB2_SHM_H
+#define _SMB2_SHM_H
+
+#ifdef __cplusplus
+	extern "C" {
+#endif
+
+/*--------------------------------------------------------------------------+
+|  TYPEDEFS                                                                 |
++--------------------------------------------------------------------------*/
+/** Register to publish (see SMB2API_ShmPubCreate) */
+typedef struct
+{
+	u_int16		addr;			/**< device address */
+	u_int8		cmdAddr;		/**< device command or index value */
+	u_int8		size;			/**< read access size (SMB_ACC_XXX) */
+}SMB2API_SHM_ENTRY;
+
+/** Published value (see SMB2API_ShmRead) */
+typedef struct
+{
+	u_int16		addr;			/**< device address */
+	u_int8		cmdAddr;		/**< device command or index value */
+	u_int8		size;			/**< read access size (SMB_ACC_XXX) */
+	int32		status;			/**< result of last poll (0 or error code) */
+	u_int32		polls;			/**< polls of the entry */
+	u_int8		data[1 + SMB_BLOCK_MAX_BYTES];	/**< data of last successful
+									 poll (layout see SMB2API_Prepare) */
+}SMB2API_SHM_VALUE;
+
+/*--------------------------------------------------------------------------+
+|  PROTOTYPES                                                               |
++--------------------------------------------------------------------------*/
+/* publisher */
+extern int32 __MAPILIB SMB2API_ShmPubCreate(
+	const char				*name,
+	void					*smbHdl,
+	u_int32					flags,
+	const SMB2API_SHM_ENTRY	ent[],
+	u_int32					num,
+	void					**pubHdlP );
+extern int32 __MAPILIB SMB2API_ShmPubUpdate( void *pubHdl );
+extern int32 __MAPILIB SMB2API_ShmPubDestroy( void **pubHdlP );
+
+/* reader */
+extern int32 __MAPILIB SMB2API_ShmOpen(
+	const char	*name,
+	void		**shmHdlP,
+	u_int32		*numP );
+extern int32 __MAPILIB SMB2API_ShmFind(
+	void		*shmHdl,
+	u_int16		addr,
+	u_int8		cmdAddr,
+	u_int32		*idxP );
+extern int32 __MAPILIB SMB2API_ShmRead(
+	void				*shmHdl,
+	u_int32				idx,
+	SMB2API_SHM_VALUE	*valP );
+extern int32 __MAPILIB SMB2API_ShmPolls( void *shmHdl, u_int32 *pollsP );
+extern int32 __MAPILIB SMB2API_ShmClose( void **shmHdlP );
+
+#ifdef __cplusplus
+	}
+#endif
+
+#endif /* _SMB2_SHM_H */